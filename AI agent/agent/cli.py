@@ -34,6 +34,37 @@ def main() -> int:
         default=str(Path(__file__).resolve().parents[1] / "engine" / "build" / "engine_cli"),
         help="Path to engine_cli executable",
     )
+    parser.add_argument(
+        "--engine-mode",
+        choices=["spawn", "serve", "native"],
+        default="native",
+        help=(
+            "spawn: one engine_cli process per call; serve: reuse one `engine_cli serve` process; "
+            "native: call the in-process _engine_core module (falls back to serve if not built)"
+        ),
+    )
+    parser.add_argument(
+        "--engine-socket",
+        default=None,
+        help="Connect to a shared `engine_cli serve --socket PATH` instead of starting one",
+    )
+    parser.add_argument(
+        "--engine-format",
+        choices=["json", "msgpack", "cbor"],
+        default="json",
+        help="Output encoding requested from engine_cli in spawn mode (binary formats skip JSON escaping)",
+    )
+    parser.add_argument(
+        "--engine-transport",
+        choices=["inline", "shm"],
+        default="inline",
+        help="How read-file content comes back in spawn/serve mode (shm: read-only shared memory segment)",
+    )
+    parser.add_argument(
+        "--engine-watch",
+        action="store_true",
+        help="In serve mode, keep the workspace file tree live via inotify (`engine_cli serve --watch`)",
+    )
     parser.add_argument(
         "--logs",
         default=str(Path(".agent_logs").resolve()),
@@ -48,10 +79,20 @@ def main() -> int:
     logs_root.mkdir(parents=True, exist_ok=True)
 
     # EngineClient：封装对 C++ 引擎 CLI 的调用（subprocess + JSON 解析）
-    engine = EngineClient(engine_path=engine_path)
-
-    # run_workflow：执行固定的 pipeline（Plan → Retrieve → Patch → Run → Fix）
-    result = run_workflow(task=args.task, workspace=workspace, engine=engine, logs_root=logs_root)
+    # serve 模式下整个 workflow 只启动一次 engine_cli，结束时由 with 负责关闭
+    # 指定 --engine-socket 时连接共享引擎（多个 worker 共用一个进程）
+    engine_socket = Path(args.engine_socket).resolve() if args.engine_socket else None
+    with EngineClient(
+        engine_path=engine_path,
+        persistent=args.engine_mode in ("serve", "native"),
+        native=args.engine_mode == "native",
+        socket_path=engine_socket,
+        wire_format=args.engine_format,
+        transport=args.engine_transport,
+        watch_root=workspace if args.engine_watch else None,
+    ) as engine:
+        # run_workflow：执行固定的 pipeline（Plan → Retrieve → Patch → Run → Fix）
+        result = run_workflow(task=args.task, workspace=workspace, engine=engine, logs_root=logs_root)
     sys.stdout.write(json.dumps(result, ensure_ascii=False, indent=2) + "\n")
 
     # 退出码：0=成功；2=失败（便于脚本/CI 判断）
@@ -12,22 +12,420 @@ EngineClient 的职责：
 2) 解析 engine_cli 输出的 JSON（stdout）
 3) 把结果以 dict 返回给上层 workflow
 
+几种调用方式：
+- 默认：每次调用都启动一个 engine_cli 子进程（最简单，进程之间不共享任何状态）
+- persistent=True：启动一个常驻的 `engine_cli serve`，之后所有调用都复用它，
+  通过 stdin/stdout 按行收发 JSON（省掉每次 exec/动态链接/冷缓存的开销）
+- socket_path=...：连接一个已经在运行的 `engine_cli serve --socket PATH`，
+  多个 agent worker 可以共享同一个引擎进程（协议与 persistent 完全相同）
+- wire_format="msgpack" / "cbor"：子进程方式下让 engine_cli 输出二进制记录（见 agent/wire.py），
+  文件内容是原始字节、路径做了字典编码，省掉 JSON 的转义与解析；返回给上层的 dict 形状不变
+  （只是 read-file 的 content 先是 bytes，read_file 会再解码成 str）
+- transport="shm"：read-file 的内容不进响应，而是放进引擎创建的只读共享内存段，
+  这里只读地 mmap 过来（见 engine/src/shm.h）；对几 MB 的文件省掉转义、管道拷贝和一半的峰值内存
+- native=True：如果 engine_cli 旁边编译出了扩展模块 _engine_core（见 engine/src/py_engine.cpp），
+  就在进程内直接调用 C++ 引擎：read_file 直接拿到 bytes，list/search 直接拿到 Python 对象，
+  完全没有 JSON 编解码和管道拷贝；找不到模块时自动退回上面的子进程方式。
+
 注意：
 - 当前 demo 的协议非常轻量（只为了跑通链路）。
 - 真正项目里建议你把 JSON schema 固定下来，并对输入输出做更严格的校验。
 """
 
+import importlib.util
 import json
+import mmap
+import os
+import socket
 import subprocess
-from dataclasses import dataclass
+import tempfile
+from dataclasses import dataclass, field
+from functools import lru_cache
 from pathlib import Path
-from typing import Any, Dict
+from types import ModuleType
+from typing import Any, Dict, Iterator, List, Optional, TextIO
+
+from . import wire
+
+try:  # CPython 在 POSIX 上自带（multiprocessing.shared_memory 就是用它实现的）
+    import _posixshmem
+except ImportError:  # pragma: no cover - 非常规的 Python 发行版
+    _posixshmem = None
+
+
+@lru_cache(maxsize=None)
+def _load_native(engine_dir: Path) -> Optional[ModuleType]:
+    """
+    在 engine_cli 所在目录里找 _engine_core 扩展模块（CMake 把它和 engine_cli 输出到同一目录）。
+    找不到或加载失败都返回 None，由调用方退回子进程方式。
+    """
+    for candidate in sorted(engine_dir.glob("_engine_core*.so")) + sorted(engine_dir.glob("_engine_core*.pyd")):
+        spec = importlib.util.spec_from_file_location("_engine_core", candidate)
+        if spec is None or spec.loader is None:
+            continue
+        try:
+            module = importlib.util.module_from_spec(spec)
+            spec.loader.exec_module(module)
+        except ImportError:
+            continue
+        return module
+    return None
+
+
+def _map_shm_segment(seg: Dict[str, Any]) -> memoryview:
+    """
+    只读映射引擎交过来的共享内存段，映射好之后立刻 shm_unlink（段的所有权在客户端）。
+    返回的 memoryview 持有映射的引用，不再使用后映射随之释放。
+    """
+    name = seg["name"]
+    offset = int(seg.get("offset", 0))
+    length = int(seg["length"])
+    if _posixshmem is not None:
+        fd = _posixshmem.shm_open(name, os.O_RDONLY, mode=0o400)
+    else:
+        fd = os.open("/dev/shm" + name, os.O_RDONLY)
+    try:
+        if length == 0:
+            return memoryview(b"")
+        mapped = mmap.mmap(fd, offset + length, access=mmap.ACCESS_READ)
+        return memoryview(mapped)[offset : offset + length]
+    finally:
+        os.close(fd)
+        if _posixshmem is not None:
+            _posixshmem.shm_unlink(name)
+        else:
+            os.unlink("/dev/shm" + name)
+
+
+# 不带值的开关，和 engine_core.cpp 的 is_switch 一致；其余参数名后面总是跟一个值
+_SWITCHES = frozenset(
+    {
+        "--stream",
+        "--manifest",
+        "--with-size",
+        "--with-lines",
+        "--git-index",
+        "--modified",
+        "--untracked",
+        "--regex",
+        "--ignore-case",
+        "--smart-case",
+        "--word",
+        "--no-index",
+    }
+)
+
+
+def _argv_to_request(request_id: int, args: list[str]) -> Dict[str, Any]:
+    """
+    把命令行形式的参数转换成 serve 协议的一条请求：
+      ["read-file", "--path", "a.cpp"] -> {"id": 1, "cmd": "read-file", "args": {"path": "a.cpp"}}
+    _SWITCHES 里的开关转换成 true；其它参数名总是和下一个 token 配对，哪怕值以 -- 开头
+    （["search-text", "--query", "--help"] -> {"query": "--help"}）；
+    重复出现的参数（--include a --include b）转换成列表。
+    """
+    params: Dict[str, Any] = {}
+    i = 1
+    while i < len(args):
+        flag = args[i]
+        key = flag[2:] if flag.startswith("--") else flag
+        if flag in _SWITCHES:
+            params[key] = True
+            i += 1
+        elif i + 1 < len(args):
+            if key in params:
+                prev = params[key]
+                params[key] = [*prev, args[i + 1]] if isinstance(prev, list) else [prev, args[i + 1]]
+            else:
+                params[key] = args[i + 1]
+            i += 2
+        else:
+            i += 1  # 结尾缺值的参数名：引擎那边同样忽略
+    return {"id": request_id, "cmd": args[0], "args": params}
+
 
+def _deadline_args(deadline_ms: Optional[int]) -> list[str]:
+    # 截止时间到了引擎会提前停下，回复目前为止的结果并带上 "partial": True
+    return [] if deadline_ms is None else ["--deadline-ms", str(int(deadline_ms))]
 
-@dataclass(frozen=True)
+
+def _search_mode_args(ignore_case: bool, smart_case: bool, word: bool) -> list[str]:
+    # search_text / iter_search 的大小写、整词开关
+    flags = [("--ignore-case", ignore_case), ("--smart-case", smart_case), ("--word", word)]
+    return [flag for flag, on in flags if on]
+
+
+def _list_filter_args(filters: Dict[str, Any]) -> list[str]:
+    """
+    list_files / iter_files 的过滤和分页参数 -> 命令行参数：
+      include=["*.py"], max_depth=2, with_size=True -> ["--include", "*.py", "--max-depth", "2", "--with-size"]
+    列表/元组展开成重复的参数；布尔值是开关；None 表示不设。
+    """
+    args: list[str] = []
+    for key, value in filters.items():
+        if value is None or value is False:
+            continue
+        flag = "--" + key.replace("_", "-")
+        if value is True:
+            args.append(flag)
+        elif isinstance(value, (list, tuple)):
+            for item in value:
+                args += [flag, str(item)]
+        else:
+            args += [flag, str(value)]
+    return args
+
+
+def _is_final_record(record: Dict[str, Any]) -> bool:
+    """
+    多行输出（batch、--stream 等）的结束判定：
+    - {"op":...} 是 batch 中单个操作的结果，后面还有
+    - {"type":"file"} / {"type":"match"} 是流式输出的中间记录，后面还有
+    - {"type":"summary"} 是最后一行
+    - 其它不带 op/type 的行（例如参数错误）本身就是唯一的一行
+    """
+    return "op" not in record and record.get("type") in (None, "summary")
+
+
+@dataclass
 class EngineClient:
     # engine_path：engine_cli 可执行文件的绝对路径
     engine_path: Path
+    # persistent：是否复用一个常驻的 `engine_cli serve` 进程
+    persistent: bool = False
+    # socket_path：共享引擎的 Unix socket 路径（设置后优先于 persistent）
+    socket_path: Optional[Path] = None
+    # native：优先使用进程内扩展模块 _engine_core（不可用时退回子进程/serve）
+    native: bool = False
+    # wire_format：子进程方式下 engine_cli 的输出格式（json / msgpack / cbor）
+    wire_format: str = "json"
+    # transport：read-file 的内容怎么交回来（inline：在响应里；shm：共享内存段）
+    transport: str = "inline"
+    # priority：serve/socket 模式下请求的调度优先级（interactive / normal / background）；
+    # None 表示用引擎的默认值（read-file 是 interactive，其它是 normal）
+    priority: Optional[str] = None
+    # watch_root：启动 serve 子进程时带上 --watch，引擎用 inotify 维护这个目录的实时文件树，
+    # 之后对它的 list-files / search-text 不再遍历目录（只对自己启动的 serve 有效，socket 模式由启动方决定）
+    watch_root: Optional[Path] = None
+
+    _proc: Optional[subprocess.Popen] = field(default=None, init=False, repr=False)
+    _sock: Optional[socket.socket] = field(default=None, init=False, repr=False)
+    _sock_file: Optional[TextIO] = field(default=None, init=False, repr=False)
+    _next_id: int = field(default=0, init=False, repr=False)
+
+    def __enter__(self) -> "EngineClient":
+        return self
+
+    def __exit__(self, *exc: Any) -> None:
+        self.close()
+
+    def close(self) -> None:
+        """关闭常驻进程/socket 连接（一次性子进程模式下什么也不做）。"""
+        if self._sock is not None:
+            # 共享引擎由别人管理生命周期：这里只断开自己的连接
+            try:
+                if self._sock_file is not None:
+                    self._sock_file.close()
+                self._sock.close()
+            finally:
+                self._sock = None
+                self._sock_file = None
+        proc = self._proc
+        self._proc = None
+        if proc is None:
+            return
+        try:
+            if proc.stdin is not None:
+                proc.stdin.write(json.dumps({"id": 0, "cmd": "shutdown"}) + "\n")
+                proc.stdin.flush()
+                proc.stdin.close()
+            proc.wait(timeout=5)
+        except (OSError, subprocess.TimeoutExpired):
+            proc.kill()
+            proc.wait()
+
+    def _ensure_server(self) -> tuple[TextIO, TextIO]:
+        """返回 (writer, reader)：socket 模式下是同一个连接，否则是 serve 子进程的 stdin/stdout。"""
+        if self.socket_path is not None:
+            if self._sock is None:
+                sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                sock.connect(str(self.socket_path))
+                self._sock = sock
+                self._sock_file = sock.makefile("rw", encoding="utf-8", newline="\n")
+            assert self._sock_file is not None
+            return self._sock_file, self._sock_file
+        if self._proc is None or self._proc.poll() is not None:
+            cmd = [str(self.engine_path), "serve"]
+            if self.watch_root is not None:
+                cmd += ["--watch", str(self.watch_root)]
+            self._proc = subprocess.Popen(
+                cmd,
+                stdin=subprocess.PIPE,
+                stdout=subprocess.PIPE,
+                text=True,
+                encoding="utf-8",
+                bufsize=1,
+            )
+        assert self._proc.stdin is not None and self._proc.stdout is not None
+        return self._proc.stdin, self._proc.stdout
+
+    def _make_request(self, args: list[str]) -> Dict[str, Any]:
+        request = _argv_to_request(self._next_id, args)
+        if self.priority is not None:
+            request["args"].setdefault("priority", self.priority)
+        return request
+
+    def stats(self) -> Dict[str, Any]:
+        """
+        常驻引擎的调度统计：每个优先级的排队数、运行数、平均/最大等待时间。
+        只在 serve/socket 模式下有意义（一次性子进程没有可统计的队列）。
+        """
+        if not (self.persistent or self.socket_path is not None):
+            return {"ok": False, "error": "stats_requires_serve"}
+        return self._run_serve(["stats"])
+
+    def _run_serve(self, args: list[str]) -> Dict[str, Any]:
+        """
+        通过常驻 serve 进程（或共享 socket）执行一次调用：写一行请求，读一行带相同 id 的响应。
+        id 对不上的行是以前的请求留下的（比如 cancel 的回复），直接跳过。
+        进程意外退出时返回 engine_failed（下一次调用会自动重启进程）。
+        """
+        self._next_id += 1
+        request = self._make_request(args)
+        try:
+            writer, reader = self._ensure_server()
+            writer.write(json.dumps(request, ensure_ascii=False) + "\n")
+            writer.flush()
+            while True:
+                line = reader.readline()
+                if not line:
+                    return {"ok": False, "error": "engine_failed", "stderr": "serve exited", "args": args}
+                try:
+                    payload = json.loads(line)
+                except json.JSONDecodeError:
+                    return {"ok": False, "error": "engine_invalid_json", "stdout": line, "args": args}
+                if payload.pop("id", request["id"]) == request["id"]:
+                    return payload
+        except OSError as e:
+            return {"ok": False, "error": "engine_failed", "stderr": str(e), "args": args}
+
+    def _abandon_stream(self, request_id: int) -> None:
+        """
+        调用方没读完 serve 上的多行输出就停了（生成器被关闭）：请引擎取消这个请求，
+        再把它剩下的记录读到结束记录为止丢掉，连接上不留残余。读不下去时断开连接，下次调用重新建立。
+        """
+        self._next_id += 1
+        cancel = {"id": self._next_id, "cmd": "cancel", "args": {"id": request_id}}
+        try:
+            writer, reader = self._ensure_server()
+            writer.write(json.dumps(cancel) + "\n")
+            writer.flush()
+            while True:
+                line = reader.readline()
+                if not line:
+                    break
+                record = json.loads(line)
+                if record.pop("id", request_id) == request_id and _is_final_record(record):
+                    return
+        except (OSError, json.JSONDecodeError):
+            pass
+        self.close()
+
+    def _native_module(self) -> Optional[ModuleType]:
+        if not self.native:
+            return None
+        return _load_native(Path(self.engine_path).resolve().parent)
+
+    def _iter_records(self, args: list[str]) -> Iterator[Dict[str, Any]]:
+        """
+        执行一个会输出多行 JSON 的命令（batch、--stream 等），按到达顺序逐条产出记录。
+        子进程模式读到 EOF 为止；serve/socket 模式读到结束记录为止（见 _is_final_record），
+        只收 id 和这次请求一样的记录。生成器没消费完就被关闭时，serve 模式下会取消这个请求
+        并把剩下的记录读掉（_abandon_stream），不影响之后的调用。
+        """
+        mod = self._native_module()
+        if mod is not None:
+            # 进程内也是边执行边产出：call_iter 在后台线程里跑命令，生成器提前关闭时命令被取消
+            for record in mod.call_iter(args):
+                yield json.loads(record)
+            return
+        if self.persistent or self.socket_path is not None:
+            self._next_id += 1
+            request = self._make_request(args)
+            done = False  # 读到了结束记录，或者连接已经坏了：不需要再善后
+            try:
+                writer, reader = self._ensure_server()
+                writer.write(json.dumps(request, ensure_ascii=False) + "\n")
+                writer.flush()
+                while True:
+                    line = reader.readline()
+                    if not line:
+                        done = True
+                        yield {"ok": False, "error": "engine_failed", "stderr": "serve exited"}
+                        return
+                    record = json.loads(line)
+                    if record.pop("id", request["id"]) != request["id"]:
+                        continue
+                    done = _is_final_record(record)
+                    yield record
+                    if done:
+                        return
+            except (OSError, json.JSONDecodeError) as e:
+                done = True
+                yield {"ok": False, "error": "engine_failed", "stderr": str(e), "args": args}
+            finally:
+                if not done:
+                    self._abandon_stream(request["id"])
+            return
+
+        if self.wire_format != "json":
+            yield from self._iter_binary_records(args)
+            return
+
+        with subprocess.Popen(
+            [str(self.engine_path), *args],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            text=True,
+            encoding="utf-8",
+        ) as proc:
+            assert proc.stdout is not None
+            produced = False
+            for line in proc.stdout:
+                if not line.strip():
+                    continue
+                produced = True
+                try:
+                    yield json.loads(line)
+                except json.JSONDecodeError:
+                    yield {"ok": False, "error": "engine_invalid_json", "stdout": line}
+            if not produced:
+                yield {"ok": False, "error": "engine_failed", "args": args}
+
+    def _iter_binary_records(self, args: list[str]) -> Iterator[Dict[str, Any]]:
+        """子进程 + --format msgpack/cbor：边读边解码，并把字典编码的路径还原成 "path"。"""
+        expander = wire.PathExpander()
+        with subprocess.Popen(
+            [str(self.engine_path), *args, "--format", self.wire_format],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+        ) as proc:
+            assert proc.stdout is not None
+            produced = False
+            try:
+                for record in wire.iter_records(proc.stdout, self.wire_format):
+                    expanded = expander.expand(record)
+                    if expanded is not None:
+                        produced = True
+                        yield expanded
+            except wire.WireError as e:
+                yield {"ok": False, "error": "engine_invalid_output", "stderr": str(e), "args": args}
+                return
+            if not produced:
+                yield {"ok": False, "error": "engine_failed", "args": args}
+
+    def _run_records(self, args: list[str]) -> List[Dict[str, Any]]:
+        return list(self._iter_records(args))
 
     def _run(self, args: list[str]) -> Dict[str, Any]:
         """
@@ -38,6 +436,17 @@ class EngineClient:
         - 退出码非 0 时，可能仍然会输出 JSON（包含 ok=false 与 error 字段）
         - 如果 stdout 不是合法 JSON，则认为引擎异常（engine_invalid_json）
         """
+        mod = self._native_module()
+        if mod is not None:
+            text = mod.call(args)
+            try:
+                return json.loads(text)
+            except json.JSONDecodeError:
+                return {"ok": False, "error": "engine_invalid_json", "stdout": text, "args": args}
+        if self.persistent or self.socket_path is not None:
+            return self._run_serve(args)
+        if self.wire_format != "json":
+            return self._run_records(args)[0]
         proc = subprocess.run(
             [str(self.engine_path), *args],
             stdout=subprocess.PIPE,
@@ -61,18 +470,118 @@ class EngineClient:
             payload["error"] = payload.get("error", "engine_nonzero_exit")
         return payload
 
-    def list_files(self, root: Path) -> Dict[str, Any]:
-        # 列出 root 下的文件树（会过滤掉常见的大目录，如 .git/node_modules 等）
-        return self._run(["list-files", "--root", str(root)])
+    def list_files(self, root: Path, deadline_ms: Optional[int] = None, **filters: Any) -> Dict[str, Any]:
+        """
+        列出 root 下的文件树（遵循 .gitignore/.ignore，并默认跳过 .git/node_modules 等常见大目录）。
+        filters 在引擎里过滤和分页，只把需要的条目传回来：
+          include / exclude（glob 或 glob 列表）、ext、lang、max_depth、
+          min_size / max_size（字节）、modified_after / modified_before（Unix 秒）、
+          with_size / with_lines（files 里的元素变成 {"path","size","lines"}）、
+          limit / cursor（还有下一页时结果里有 "next_cursor"，原样传回 cursor）、
+          git_index（直接读 .git/index，不遍历）、modified / untracked（多出 "modified"/"deleted"/"untracked"）
+        不是 git 工作区顶层（或索引格式不支持）时 git_index 返回 error == "git_index_unavailable"，调用方去掉它重试即可。
+        """
+        args = _list_filter_args(filters)
+        mod = self._native_module()
+        if mod is not None and deadline_ms is None and not args:
+            return {"ok": True, "root": str(root), "files": mod.list_files(str(root))}
+        return self._run(["list-files", "--root", str(root), *args, *_deadline_args(deadline_ms)])
+
+    def list_changes(
+        self, root: Path, since: Optional[str] = None, deadline_ms: Optional[int] = None
+    ) -> Dict[str, Any]:
+        """
+        走 root/.agent_index/manifest 的增量刷新。
+        since 为 None：返回全量文件列表 + "generation" 令牌；
+        否则只返回从 since 以来的 added/modified/removed（reset=True 时 added 是全量，需要丢弃本地状态）。
+        """
+        args = ["list-files", "--root", str(root)]
+        args += ["--manifest"] if since is None else ["--since", since]
+        return self._run([*args, *_deadline_args(deadline_ms)])
+
+    def iter_files(self, root: Path, deadline_ms: Optional[int] = None, **filters: Any) -> Iterator[Dict[str, Any]]:
+        # 流式列文件：边遍历边产出 {"type":"file","path":...}，最后一条是 summary（filters 同 list_files）
+        return self._iter_records(
+            ["list-files", "--root", str(root), "--stream", *_list_filter_args(filters), *_deadline_args(deadline_ms)]
+        )
 
     def read_file(self, path: Path, max_bytes: int = 200_000) -> Dict[str, Any]:
         # 读取文件内容（max_bytes 用于控制上下文大小，避免一次读太大）
-        return self._run(["read-file", "--path", str(path), "--max-bytes", str(max_bytes)])
+        if self._native_module() is not None or self.transport == "shm":
+            try:
+                data = self.read_file_bytes(path, max_bytes)
+            except OSError:
+                return {"ok": False, "error": "read_failed", "path": str(path)}
+            return {
+                "ok": True,
+                "path": str(path),
+                "truncated": len(data) >= max_bytes,
+                "content": data.decode("utf-8", errors="replace"),
+            }
+        payload = self._run(["read-file", "--path", str(path), "--max-bytes", str(max_bytes)])
+        if isinstance(payload.get("content"), bytes):
+            payload["content"] = payload["content"].decode("utf-8", errors="replace")
+        return payload
+
+    def read_file_bytes(self, path: Path, max_bytes: int = 200_000) -> bytes:
+        """
+        读取文件原始字节（不经过 JSON）；失败抛 OSError。
+        native 模式下 C++ 直接把文件读进 bytes 对象；wire_format 为二进制格式时 content 本来就是 bytes；
+        否则退回 read-file 子命令再编码回 bytes。
+        需要零拷贝切片时可以再包一层 memoryview(...)。
+        """
+        mod = self._native_module()
+        if mod is not None:
+            return mod.read_file(str(path), max_bytes)
+        if self.transport == "shm":
+            return bytes(self.read_file_view(path, max_bytes))
+        payload = self._run(["read-file", "--path", str(path), "--max-bytes", str(max_bytes)])
+        if not payload.get("ok"):
+            raise OSError(f"read_file failed: {payload.get('error')}: {path}")
+        content = payload["content"]
+        return content if isinstance(content, bytes) else content.encode("utf-8")
+
+    def read_file_view(self, path: Path, max_bytes: int = 200_000) -> memoryview:
+        """
+        只读视图形式的文件内容；失败抛 OSError。
+        子进程/serve 方式下走 --transport shm：内容留在共享内存里，不经过响应和管道，
+        只有调用方真正切片/解码时才会拷贝。native 模式下就是 read_file 返回的 bytes 的视图。
+        """
+        mod = self._native_module()
+        if mod is not None:
+            return memoryview(mod.read_file(str(path), max_bytes))
+        payload = self._run(
+            ["read-file", "--path", str(path), "--max-bytes", str(max_bytes), "--transport", "shm"]
+        )
+        if not payload.get("ok") or "shm" not in payload:
+            raise OSError(f"read_file failed: {payload.get('error')}: {path}")
+        return _map_shm_segment(payload["shm"])
 
     def search_text(
-        self, root: Path, query: str, topk: int = 10, max_bytes: int = 200_000
+        self,
+        root: Path,
+        query: str,
+        topk: int = 10,
+        max_bytes: int = 200_000,
+        deadline_ms: Optional[int] = None,
+        regex: bool = False,
+        ignore_case: bool = False,
+        smart_case: bool = False,
+        word: bool = False,
     ) -> Dict[str, Any]:
-        # 简单的全文搜索（demo 版本：逐文件逐行 find；后续可替换成倒排索引/rg/tree-sitter）
+        # 全文搜索（逐文件逐行 find）；root 建过三元组索引（build_index）时只打开候选文件
+        # deadline_ms：超时后拿到的是目前为止的 top-k，结果里带 "partial": True
+        # regex=True：query 是正则（线性时间，不支持反向引用 / 环视），不合法时回 invalid_regex
+        # ignore_case / smart_case（没有大写字母时才忽略大小写）/ word（整词，同 grep -w）
+        mod = self._native_module()
+        if mod is not None and deadline_ms is None:
+            try:
+                results = mod.search_text(
+                    str(root), query, topk, max_bytes, regex, ignore_case, smart_case, word
+                )
+            except ValueError as e:
+                return {"ok": False, "error": "invalid_regex", "message": str(e)}
+            return {"ok": True, "query": query, "results": results}
         return self._run(
             [
                 "search-text",
@@ -84,9 +593,85 @@ class EngineClient:
                 str(topk),
                 "--max-bytes",
                 str(max_bytes),
+                *(["--regex"] if regex else []),
+                *_search_mode_args(ignore_case, smart_case, word),
+                *_deadline_args(deadline_ms),
             ]
         )
 
+    def search_text_multi(
+        self,
+        root: Path,
+        queries: List[str],
+        topk: int = 10,
+        max_bytes: int = 200_000,
+        deadline_ms: Optional[int] = None,
+        ignore_case: bool = False,
+        smart_case: bool = False,
+        word: bool = False,
+    ) -> Dict[str, Any]:
+        # 一次搜多个子串：每个文件只扫一遍，比逐个 search_text 快得多（query 越多越明显）
+        # 返回 {"ok": True, "queries": [{"query", "matches", "results"}, ...]}，顺序同 queries；
+        # 每个 query 的 results 和单独 search_text 它时一样。不支持 regex
+        mod = self._native_module()
+        if mod is not None and deadline_ms is None:
+            return {
+                "ok": True,
+                "queries": mod.search_text_multi(
+                    str(root), list(queries), topk, max_bytes, ignore_case, smart_case, word
+                ),
+            }
+        return self._run(
+            [
+                "search-text",
+                "--root",
+                str(root),
+                *[arg for q in queries for arg in ("--queries", q)],
+                "--topk",
+                str(topk),
+                "--max-bytes",
+                str(max_bytes),
+                *_search_mode_args(ignore_case, smart_case, word),
+                *_deadline_args(deadline_ms),
+            ]
+        )
+
+    def iter_search(
+        self,
+        root: Path,
+        query: str,
+        topk: int = 10,
+        max_bytes: int = 200_000,
+        deadline_ms: Optional[int] = None,
+        regex: bool = False,
+        ignore_case: bool = False,
+        smart_case: bool = False,
+        word: bool = False,
+    ) -> Iterator[Dict[str, Any]]:
+        # 流式搜索：每个命中一条 {"type":"match",...}，最后的 summary 里带按分数排好的 top-k
+        return self._iter_records(
+            [
+                "search-text",
+                "--root",
+                str(root),
+                "--query",
+                query,
+                "--topk",
+                str(topk),
+                "--max-bytes",
+                str(max_bytes),
+                "--stream",
+                *(["--regex"] if regex else []),
+                *_search_mode_args(ignore_case, smart_case, word),
+                *_deadline_args(deadline_ms),
+            ]
+        )
+
+    def build_index(self, root: Path, deadline_ms: Optional[int] = None) -> Dict[str, Any]:
+        # 建 / 增量刷新 root/.agent_index/trigrams，之后 search_text 只打开可能命中的文件。
+        # watch_root 启动的 serve 会自己在后台维护它，不用调用这个
+        return self._run(["index", "--root", str(root), *_deadline_args(deadline_ms)])
+
     def apply_edits(self, root: Path, edits_json_path: Path) -> Dict[str, Any]:
         # 应用“按行替换”的 edits.json，并自动做快照备份（root/.agent_snapshots/<id>/...）
         return self._run(
@@ -96,3 +681,31 @@ class EngineClient:
     def rollback(self, root: Path, snapshot_id: str) -> Dict[str, Any]:
         # 回滚到某次 apply_edits 之前的版本（把快照目录里的文件写回 root）
         return self._run(["rollback", "--root", str(root), "--snapshot-id", snapshot_id])
+
+    def batch(self, ops: List[Dict[str, Any]]) -> Dict[str, Any]:
+        """
+        一次调用执行多个操作（引擎内部并行执行只读操作），避免每个操作各起一个进程。
+
+        ops 的每一项与 serve 协议的请求格式相同：
+          {"id": "r1", "cmd": "read-file", "args": {"path": "...", "max-bytes": 1000}}
+        返回：{"ok": 批次本身是否成功, "results": {op_id: 该操作的结果}, "failed": 失败个数}
+        单个操作失败只体现在 results[op_id]["ok"] == False 上。
+        """
+        fd, tmp_path = tempfile.mkstemp(prefix="engine_batch_", suffix=".json")
+        try:
+            with os.fdopen(fd, "w", encoding="utf-8") as f:
+                json.dump({"requests": ops}, f, ensure_ascii=False)
+            records = self._run_records(["batch", "--requests-json", tmp_path])
+        finally:
+            os.unlink(tmp_path)
+
+        results: Dict[Any, Dict[str, Any]] = {}
+        summary: Dict[str, Any] = {}
+        for record in records:
+            if "op" in record:
+                results[record.pop("op")] = record
+            else:
+                summary = record
+        if not summary.get("ok"):
+            return {"ok": False, "error": summary.get("error", "batch_failed"), "detail": summary, "results": results}
+        return {"ok": True, "results": results, "failed": summary.get("failed", 0)}
@@ -0,0 +1,203 @@
+"""
+agent/wire.py：engine_cli 二进制输出（--format msgpack / cbor）的解码
+
+为什么自己写而不是 pip install msgpack / cbor2？
+- engine_cli 只用到两种格式里很小的一个子集（定长 map/array、字符串、字节串、整数、浮点、bool、null），
+  几十行就能解完，agent 不必为此多一个三方依赖。
+- 解码器按需从流里读字节，子进程的输出可以边到边解（流式命令不用等进程结束）。
+
+和 JSON 输出的差别（由 PathExpander 还原成 JSON 同样的形状）：
+- read-file 的 content 是原始 bytes（没有转义，也不保证是 UTF-8）
+- 路径是字典编码的："dirs" 是目录表，文件用 {"dir": 编号, "name": 文件名} 或 [编号, 文件名] 表示
+  （files 以及 list-files --since 的 added/modified/removed 都是后一种）；
+  流式输出里目录第一次出现时会先来一条 {"type": "dir", "index": N, "path": ...}
+- batch 里每个操作各有各的目录表（按记录里的 "op" 区分）
+"""
+
+import struct
+from typing import Any, BinaryIO, Dict, Iterator, List, Optional
+
+
+class WireError(ValueError):
+    pass
+
+
+def _read(stream: BinaryIO, n: int) -> bytes:
+    data = stream.read(n)
+    if len(data) != n:
+        raise WireError("truncated record")
+    return data
+
+
+def _uint(stream: BinaryIO, n: int) -> int:
+    return int.from_bytes(_read(stream, n), "big")
+
+
+def _text(data: bytes) -> str:
+    # snippet 来自任意文件内容，不保证是合法 UTF-8：和 JSON 路径一样用 replace 兜底
+    return data.decode("utf-8", errors="replace")
+
+
+def _msgpack_value(stream: BinaryIO, b: int) -> Any:
+    if b <= 0x7F:
+        return b
+    if b >= 0xE0:
+        return b - 0x100
+    if 0x80 <= b <= 0x8F:
+        return _msgpack_map(stream, b & 0x0F)
+    if 0x90 <= b <= 0x9F:
+        return [_msgpack_next(stream) for _ in range(b & 0x0F)]
+    if 0xA0 <= b <= 0xBF:
+        return _text(_read(stream, b & 0x1F))
+    if b == 0xC0:
+        return None
+    if b == 0xC2:
+        return False
+    if b == 0xC3:
+        return True
+    if b in (0xC4, 0xC5, 0xC6):
+        return _read(stream, _uint(stream, 1 << (b - 0xC4)))
+    if b == 0xCB:
+        return struct.unpack(">d", _read(stream, 8))[0]
+    if 0xCC <= b <= 0xCF:
+        return _uint(stream, 1 << (b - 0xCC))
+    if 0xD0 <= b <= 0xD3:
+        return int.from_bytes(_read(stream, 1 << (b - 0xD0)), "big", signed=True)
+    if b in (0xD9, 0xDA, 0xDB):
+        return _text(_read(stream, _uint(stream, 1 << (b - 0xD9))))
+    if b in (0xDC, 0xDD):
+        return [_msgpack_next(stream) for _ in range(_uint(stream, 2 if b == 0xDC else 4))]
+    if b in (0xDE, 0xDF):
+        return _msgpack_map(stream, _uint(stream, 2 if b == 0xDE else 4))
+    raise WireError(f"unsupported msgpack type 0x{b:02x}")
+
+
+def _msgpack_map(stream: BinaryIO, n: int) -> Dict[Any, Any]:
+    out: Dict[Any, Any] = {}
+    for _ in range(n):
+        key = _msgpack_next(stream)
+        out[key] = _msgpack_next(stream)
+    return out
+
+
+def _msgpack_next(stream: BinaryIO) -> Any:
+    return _msgpack_value(stream, _read(stream, 1)[0])
+
+
+def _cbor_next(stream: BinaryIO) -> Any:
+    return _cbor_value(stream, _read(stream, 1)[0])
+
+
+def _cbor_value(stream: BinaryIO, b: int) -> Any:
+    major, info = b >> 5, b & 0x1F
+    if major == 7:
+        if info == 20:
+            return False
+        if info == 21:
+            return True
+        if info in (22, 23):
+            return None
+        if info == 27:
+            return struct.unpack(">d", _read(stream, 8))[0]
+        raise WireError(f"unsupported cbor simple value {info}")
+    if info < 24:
+        n = info
+    elif info <= 27:
+        n = _uint(stream, 1 << (info - 24))
+    else:
+        raise WireError("indefinite-length cbor items are not supported")
+    if major == 0:
+        return n
+    if major == 1:
+        return -1 - n
+    if major == 2:
+        return _read(stream, n)
+    if major == 3:
+        return _text(_read(stream, n))
+    if major == 4:
+        return [_cbor_next(stream) for _ in range(n)]
+    if major == 5:
+        out: Dict[Any, Any] = {}
+        for _ in range(n):
+            key = _cbor_next(stream)
+            out[key] = _cbor_next(stream)
+        return out
+    raise WireError(f"unsupported cbor major type {major}")
+
+
+def iter_records(stream: BinaryIO, fmt: str) -> Iterator[Dict[str, Any]]:
+    """从二进制流里逐条解出记录，读到 EOF 为止。"""
+    while True:
+        head = stream.read(1)
+        if not head:
+            return
+        if fmt == "msgpack":
+            record = _msgpack_value(stream, head[0])
+        elif fmt == "cbor":
+            record = _cbor_value(stream, head[0])
+        else:
+            raise WireError(f"unknown wire format {fmt!r}")
+        if not isinstance(record, dict):
+            raise WireError("top-level record must be a map")
+        yield record
+
+
+def _join(dirs: List[str], index: int, name: str) -> str:
+    d = dirs[index] if 0 <= index < len(dirs) else ""
+    return f"{d}/{name}" if d else name
+
+
+class PathExpander:
+    """
+    把字典编码的路径还原成 JSON 输出里的 "path" 字段；一个实例对应一条命令的整个输出流
+    （流式输出的目录表是跨记录累积的）。
+    返回 None 表示这条记录只是目录表的一部分（type == "dir"），调用方直接跳过即可。
+    """
+
+    def __init__(self) -> None:
+        self._dirs: List[str] = []
+        self._per_op: Dict[Any, "PathExpander"] = {}
+
+    def expand(self, record: Dict[str, Any]) -> Optional[Dict[str, Any]]:
+        if "op" in record:
+            return self._per_op.setdefault(record["op"], PathExpander())._expand(record)
+        return self._expand(record)
+
+    def _expand(self, record: Dict[str, Any]) -> Optional[Dict[str, Any]]:
+        if record.get("type") == "dir":
+            index = record.get("index", len(self._dirs))
+            while len(self._dirs) <= index:
+                self._dirs.append("")
+            self._dirs[index] = record.get("path", "")
+            return None
+        dirs = record.pop("dirs", None)
+        if dirs is not None:
+            self._dirs = list(dirs)
+        self._expand_entry(record)
+        for key in ("files", "added", "modified", "removed", "deleted", "untracked"):
+            files = record.get(key)
+            if isinstance(files, list):
+                for i, f in enumerate(files):
+                    if isinstance(f, list) and len(f) == 2:
+                        files[i] = _join(self._dirs, f[0], f[1])
+                    elif isinstance(f, dict):
+                        self._expand_entry(f)  # 带 size/lines 的 {"dir","name",...}
+        self._expand_results(record)
+        queries = record.get("queries")  # search-text --queries：每个 query 一组 results，共用 dirs
+        if isinstance(queries, list):
+            for q in queries:
+                if isinstance(q, dict):
+                    self._expand_results(q)
+        return record
+
+    def _expand_results(self, record: Dict[str, Any]) -> None:
+        results = record.get("results")
+        if isinstance(results, list):
+            for r in results:
+                if isinstance(r, dict):
+                    self._expand_entry(r)
+
+    def _expand_entry(self, entry: Dict[str, Any]) -> None:
+        if "dir" in entry and "name" in entry:
+            name = entry.pop("name")
+            entry["path"] = _join(self._dirs, entry.pop("dir"), name)
@@ -25,6 +25,9 @@ from typing import Any, Dict, List
 
 from agent.engine_client import EngineClient
 
+# Retrieve 这一步的时间预算：超时后引擎返回目前为止的搜索结果（partial），workflow 照常往下走
+RETRIEVE_DEADLINE_MS = 2000
+
 
 def _run_cmd(cmd: List[str], cwd: Path, timeout_s: int = 30) -> Dict[str, Any]:
     """
@@ -131,14 +134,26 @@ def run_workflow(task: str, workspace: Path, engine: EngineClient, logs_root: Pa
         return {"ok": False, "run_id": run_id, "error": "unsupported_build_error", "build": build}
 
     # 4) Retrieve：示意性调用一下搜索接口（真实版本应该用“错误关键词/符号名”去检索）
-    retrieve = {"search": engine.search_text(root=workspace, query="std::", topk=5)}
+    # 5) 读取目标文件内容（demo 里固定是 main.cpp；真实版本应由检索/计划决定目标文件）
+    # 两步合并成一次 batch 调用：引擎在一个进程里并行执行，省掉一次进程启动
+    target_path = workspace / "main.cpp"
+    retrieved = engine.batch(
+        [
+            {
+                "id": "search",
+                "cmd": "search-text",
+                "args": {"root": str(workspace), "query": "std::", "topk": 5, "deadline-ms": RETRIEVE_DEADLINE_MS},
+            },
+            {"id": "target", "cmd": "read-file", "args": {"path": str(target_path)}},
+        ]
+    )
+    results = retrieved.get("results", {})
+    retrieve = {"search": results.get("search", retrieved)}
     (run_dir / "retrieve.json").write_text(
         json.dumps(retrieve, ensure_ascii=False, indent=2), encoding="utf-8"
     )
 
-    # 5) 读取目标文件内容（demo 里固定是 main.cpp；真实版本应由检索/计划决定目标文件）
-    target_path = workspace / "main.cpp"
-    file_payload = engine.read_file(target_path)
+    file_payload = results.get("target", retrieved)
     if not file_payload.get("ok"):
         return {"ok": False, "run_id": run_id, "error": "read_file_failed", "detail": file_payload}
 
@@ -0,0 +1,234 @@
+/*
+  engine/bench/scan_bench.cpp：search-text 扫描内核基准（split_lines + 逐行 find vs 整块缓冲区查找）
+
+  用法：scan_bench [--file PATH] [--query TEXT] [--regex PATTERN] [--mib N] [--runs R]
+                   [--ignore-case] [--word] [--multi N]
+  - 不给 --file 时生成 N MiB（默认 64）像源代码的文本：行长 0~120，query 偶尔出现
+  - 每种实现报告：命中行数、吞吐（R 次取最好）。命中数必须完全一样，不一样时退出码为 1
+  - 实现：lines（原来的 split_lines + std::string::find）、scalar、sse2、avx2（本机不支持的级别跳过）
+  - 给了 --regex 时比较正则：std::regex（逐行 regex_search）和 line_regex.h 的惰性 DFA（字面串预筛）
+  - --ignore-case / --word：lines 换成“每行转小写再 find / 逐个检查前后字节”，其余实现用 FindOptions
+    （--regex 时 std::regex 用 icase，--word 只对内核生效）
+  - --multi N：一次找 N 个标识符（query 加上 N-1 个随机的）。比较每个 needle 各扫一遍（avx2 SubstringFinder）
+    和 MultiFinder 一遍扫完（scalar、avx2），报告 (行, needle) 命中数
+
+  cmake -S engine -B engine/build -DENGINE_BUILD_BENCH=ON && cmake --build engine/build -j
+  engine/build/scan_bench --mib 256 --query "std::vector"
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "line_regex.h"
+#include "text_scan.h"
+
+namespace {
+
+std::string make_text(std::size_t bytes, const std::string& query) {
+  static const char* kWords[] = {"int",    "return", "const",  "auto",  "for",    "if",
+                                 "std::",  "size_t", "value",  "index", "buffer", "{",
+                                 "}",      "(",      ")",      ";",     "=",      "->"};
+  std::mt19937 rng(7);
+  std::string text;
+  text.reserve(bytes + 256);
+  while (text.size() < bytes) {
+    std::size_t len = rng() % 120;
+    std::size_t start = text.size();
+    text.append(rng() % 8, ' ');
+    while (text.size() - start < len) {
+      text += kWords[rng() % (sizeof(kWords) / sizeof(kWords[0]))];
+      text += ' ';
+    }
+    if (rng() % 500 == 0) text += query;
+    text += '\n';
+  }
+  return text;
+}
+
+std::vector<std::string> split_lines(const std::string& text) {
+  // 原来的写法：每行一个 std::string
+  std::vector<std::string> lines;
+  std::string line;
+  std::istringstream iss(text);
+  while (std::getline(iss, line)) lines.push_back(line);
+  if (!text.empty() && text.back() == '\n') lines.push_back("");
+  return lines;
+}
+
+bool is_word(char c) { return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_'; }
+
+std::size_t scan_split_lines(const std::string& text, std::string query,
+                             const engine::FindOptions& options) {
+  // 大小写不敏感的原始写法：每行复制一份转小写
+  auto lower = [](std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+  };
+  if (options.ignore_case) query = lower(query);
+  std::size_t hits = 0;
+  for (const auto& line : split_lines(text)) {
+    const std::string l = options.ignore_case ? lower(line) : line;
+    for (std::size_t p = l.find(query); p != std::string::npos; p = l.find(query, p + 1)) {
+      if (!options.whole_word || ((p == 0 || !is_word(l[p - 1])) &&
+                                  (p + query.size() == l.size() || !is_word(l[p + query.size()])))) {
+        hits++;
+        break;
+      }
+    }
+  }
+  return hits;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string file, query = "std::vector", pattern;
+  std::size_t mib = 64, multi = 0;
+  int runs = 3;
+  engine::FindOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--ignore-case") {
+      options.ignore_case = true;
+      continue;
+    }
+    if (k == "--word") {
+      options.whole_word = true;
+      continue;
+    }
+    if (i + 1 >= argc) break;
+    i++;
+    if (k == "--file") file = argv[i];
+    else if (k == "--query") query = argv[i];
+    else if (k == "--regex") pattern = argv[i];
+    else if (k == "--mib") mib = std::stoul(argv[i]);
+    else if (k == "--runs") runs = std::stoi(argv[i]);
+    else if (k == "--multi") multi = std::stoul(argv[i]);
+  }
+
+  std::string text;
+  if (!file.empty()) {
+    std::ifstream in(file, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+  } else {
+    text = make_text(mib << 20, query);
+  }
+  std::printf("%zu bytes, query \"%s\", cpu: %s\n", text.size(), query.c_str(),
+              engine::simd_level_name(engine::simd_level()));
+
+  auto bench = [&](const char* name, const std::function<std::size_t()>& run) {
+    double best = 1e30;
+    std::size_t hits = 0;
+    for (int r = 0; r < runs; r++) {
+      auto t0 = std::chrono::steady_clock::now();
+      hits = run();
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    std::printf("  %-8s %10zu hits  %8.1f ms  %7.2f GB/s\n", name, hits, best * 1000,
+                static_cast<double>(text.size()) / best / 1e9);
+    return hits;
+  };
+
+  int status = 0;
+  if (!pattern.empty()) {
+    std::string err;
+    engine::RegexOptions flags;
+    flags.ignore_case = options.ignore_case;
+    flags.whole_word = options.whole_word;
+    auto re = engine::LineRegex::compile(pattern, err, flags);
+    if (!re) {
+      std::printf("bad pattern: %s\n", err.c_str());
+      return 2;
+    }
+    std::printf("regex \"%s\", %zu required literal(s)\n", pattern.c_str(),
+                re->required_literals().size());
+    std::regex std_re(pattern, options.ignore_case ? std::regex::ECMAScript | std::regex::icase
+                                                   : std::regex::ECMAScript);
+    std::vector<std::string> lines = split_lines(text);
+    std::size_t expected = bench("std::regex", [&] {
+      std::size_t n = 0;
+      for (const auto& l : lines) n += std::regex_search(l, std_re);
+      return n;
+    });
+    engine::LineMatcher matcher(re);
+    std::size_t hits = bench("dfa", [&] {
+      std::size_t n = 0;
+      matcher.scan_lines(text.data(), text.size(), [&n](const engine::LineMatch&) {
+        n++;
+        return true;
+      });
+      return n;
+    });
+    if (hits != expected && !options.whole_word) status = 1;
+    if (status != 0) std::printf("hit counts differ!\n");
+    return status;
+  }
+
+  if (multi > 0) {
+    std::mt19937 rng(11);
+    std::vector<std::string> needles{query};
+    while (needles.size() < multi) {
+      std::string id = "m";
+      for (std::size_t len = 5 + rng() % 8; id.size() < len;) id += "abcdefghijklmnopqrstuvwxyz_"[rng() % 27];
+      needles.push_back(id);
+    }
+    std::vector<engine::FindOptions> opts(needles.size(), options);
+    std::printf("%zu needles\n", needles.size());
+    std::size_t expected = bench("each", [&] {
+      std::size_t n = 0;
+      for (std::size_t i = 0; i < needles.size(); i++) {
+        engine::SubstringFinder finder(needles[i], options);
+        engine::scan_lines(text.data(), text.size(), finder, [&n](const engine::LineMatch&) {
+          n++;
+          return true;
+        });
+      }
+      return n;
+    });
+    for (auto level : {engine::SimdLevel::Scalar, engine::SimdLevel::Avx2}) {
+      if (level > engine::simd_level()) continue;
+      engine::MultiFinder finder(needles, opts, level);
+      std::size_t hits = bench(engine::simd_level_name(level), [&] {
+        std::size_t n = 0;
+        engine::scan_lines(text.data(), text.size(), finder,
+                           [&n](const engine::LineMatch&, std::uint32_t) {
+                             n++;
+                             return true;
+                           });
+        return n;
+      });
+      if (hits != expected) status = 1;
+    }
+    if (status != 0) std::printf("hit counts differ!\n");
+    return status;
+  }
+
+  std::size_t expected = bench("lines", [&] { return scan_split_lines(text, query, options); });
+  for (auto level : {engine::SimdLevel::Scalar, engine::SimdLevel::Sse2, engine::SimdLevel::Avx2}) {
+    if (level > engine::simd_level()) continue;
+    engine::SubstringFinder finder(query, options, level);
+    std::size_t hits = bench(engine::simd_level_name(level), [&] {
+      std::size_t n = 0;
+      engine::scan_lines(text.data(), text.size(), finder, [&n](const engine::LineMatch&) {
+        n++;
+        return true;
+      });
+      return n;
+    });
+    if (hits != expected) status = 1;
+  }
+  if (status != 0) std::printf("hit counts differ!\n");
+  return status;
+}
@@ -0,0 +1,89 @@
+/*
+  engine/src/cancel.h：请求级的截止时间与协作式取消（header-only）
+
+  长操作（遍历 / 搜索）在文件边界和行循环里定期调用 stop_requested()，一旦为真就停下来，
+  把目前为止的结果标成 partial:true 返回，而不是让调用方只能杀进程、丢掉全部结果。
+  - 截止时间：--deadline-ms N（serve 模式下从收到请求时开始计时，排队时间也算在内）
+  - 取消：serve 模式下 {"cmd":"cancel","args":{"id":<要取消的请求 id>}}
+  - parent：batch 里每个操作的 token 挂在整个 batch 的 token 下面，取消 batch 会连带取消所有操作
+  - 检查点钩子：serve 的调度器在这里挂上“让出”回调，遍历在文件边界调用 checkpoint() 时
+    给更高优先级的请求插队的机会（见 scheduler.h）
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace engine {
+
+class CancelToken {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit CancelToken(const CancelToken* parent = nullptr) : parent_(parent) {}
+
+  CancelToken(const CancelToken&) = delete;
+  CancelToken& operator=(const CancelToken&) = delete;
+
+  void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  // 可以多次设置，取最早的那个
+  void set_deadline(Clock::time_point t) {
+    std::int64_t ns = t.time_since_epoch().count();
+    std::int64_t cur = deadline_.load(std::memory_order_relaxed);
+    while ((cur == 0 || ns < cur) &&
+           !deadline_.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  void set_deadline_after_ms(std::int64_t ms) {
+    set_deadline(Clock::now() + std::chrono::milliseconds(ms));
+  }
+
+  bool cancelled() const {
+    return cancelled_.load(std::memory_order_relaxed) || (parent_ && parent_->cancelled());
+  }
+
+  bool deadline_exceeded() const {
+    std::int64_t d = deadline_.load(std::memory_order_relaxed);
+    if (d != 0 && Clock::now().time_since_epoch().count() >= d) return true;
+    return parent_ && parent_->deadline_exceeded();
+  }
+
+  bool stop_requested() const { return cancelled() || deadline_exceeded(); }
+
+  // 停下来的原因，用作错误码："cancelled" / "deadline_exceeded"
+  const char* reason() const { return cancelled() ? "cancelled" : "deadline_exceeded"; }
+
+  // 长操作在文件边界上调用的钩子（先父后子）；在开始执行之前设置，之后只读
+  void set_checkpoint_hook(std::function<void()> hook) { hook_ = std::move(hook); }
+
+  void run_checkpoint_hooks() const {
+    if (parent_) parent_->run_checkpoint_hooks();
+    if (hook_) hook_();
+  }
+
+ private:
+  const CancelToken* parent_;
+  std::function<void()> hook_;
+  std::atomic<bool> cancelled_{false};
+  std::atomic<std::int64_t> deadline_{0};  // steady_clock 的纳秒数；0 表示没有截止时间
+};
+
+// nullptr 表示“不可取消”，省得每个调用点都判空
+inline bool should_stop(const CancelToken* token) {
+  return token != nullptr && token->stop_requested();
+}
+
+// 文件边界上的检查点：先给调度器让出的机会，再看要不要停
+inline bool checkpoint(const CancelToken* token) {
+  if (token == nullptr) return false;
+  token->run_checkpoint_hooks();
+  return token->stop_requested();
+}
+
+}  // namespace engine
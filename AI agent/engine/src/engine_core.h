@@ -0,0 +1,162 @@
+/*
+  engine/src/engine_core.h：引擎核心库（engine_core）的对外接口
+
+  engine_cli（命令行 / serve）和 Python 扩展模块 _engine_core 都链接这同一个库：
+  - 数据层接口（list_files / search_text / read_file_bytes ...）直接返回 C++ 数据结构，
+    给 Python 绑定用，省掉 JSON 编码/解码与管道拷贝；
+  - 命令层接口（run_command ...）把子命令的结果编码成记录（JSON / CBOR / MessagePack，
+    见 response.h），给 CLI / serve / batch 用。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cancel.h"
+#include "file_kind.h"
+#include "json.h"
+#include "path_table.h"
+#include "response.h"
+
+namespace engine {
+
+namespace fs = std::filesystem;  // C++17 文件系统库
+
+// ---- 数据层 ----
+
+// 把路径转换为 POSIX 风格（斜杠分隔）
+std::string to_posix_path(const fs::path& p);
+
+// 以二进制读取文件，并截断到 max_bytes（用于控制上下文大小）
+bool read_file_bytes(const fs::path& path, std::size_t max_bytes, std::string& out);
+
+// is_likely_text（“是否像文本”的判断）在 file_kind.h 里
+
+// 遍历 root 下所有未被忽略的普通文件（并行枚举，按相对路径排序后依次回调）；rel 是 POSIX 风格的相对路径，
+// id 是它在这次枚举的路径表里的编号。
+// 枚举时每个目录、回调时每个文件之前检查 cancel；因取消/超时提前结束时返回 false。
+using FileVisitor =
+    std::function<void(const fs::path& abs, const std::string& rel, FileId id)>;
+bool walk_files(const fs::path& root, const FileVisitor& visit,
+                const CancelToken* cancel = nullptr);
+
+// 列出 root 下所有未被忽略的普通文件（按相对路径排序的路径表）
+PathTable list_files(const fs::path& root);
+
+struct SearchHit {
+  FileId file = 0;  // 在 SearchResult::paths 里的编号，输出时才拼成路径
+  int line = 0;     // 1-based
+  int score = 0;
+  std::string snippet;
+  std::size_t seq = 0;  // 发现顺序（按路径、行号数第几个命中），和线程数无关
+};
+
+struct SearchResult {
+  std::vector<SearchHit> hits;  // 按分数排好序的 top-k
+  std::size_t total_matches = 0;  // 流式时是全部命中数；非流式时 top-k 确定后会提前结束，只数到那里
+  bool partial = false;  // 因取消/超时提前结束：hits 是目前为止的 top-k
+  PathTable paths;       // 这次搜索枚举到的文件
+  std::string error;     // 非空时根本没有搜索：--regex 的模式不合法，这里是原因
+
+  std::string path(const SearchHit& hit) const { return paths.path(hit.file); }
+};
+
+struct SearchOptions {
+  std::size_t threads = 0;   // 0：按 CPU 数；给了也不会超过 CPU 数（最多 16）
+  bool regex = false;        // query 是正则（line_regex.h），行里有匹配就算命中
+  bool ignore_case = false;  // ASCII 大小写不敏感
+  bool smart_case = false;   // query 里没有大写字母时大小写不敏感，有就敏感
+  bool whole_word = false;   // 命中前后都不能紧挨着单词字符 [0-9A-Za-z_]（同 grep -w）
+};
+
+// 逐文件逐行搜索（默认是子串）；on_match 非空时每发现一个命中就回调一次（流式输出用），path 是命中文件的相对路径。
+// 多个线程并行扫不同的文件；同分的命中按路径、行号排序，
+// on_match 也按文件顺序回调（一次只有一个线程在回调），所以输出和单线程时完全一样。
+using MatchVisitor = std::function<void(const SearchHit&, const std::string& path)>;
+SearchResult search_text(const fs::path& root, const std::string& query, int topk,
+                         std::size_t max_bytes, const MatchVisitor& on_match = nullptr,
+                         const CancelToken* cancel = nullptr, const SearchOptions& options = {});
+
+// search_text_multi 的结果：hits[i] / total_matches[i] 对应 queries[i]。命中的 seq 不填
+struct MultiSearchResult {
+  std::vector<std::vector<SearchHit>> hits;  // 每个 query 按分数排好序的 top-k
+  std::vector<std::size_t> total_matches;    // 每个 query 的命中行数
+  bool partial = false;                      // 因取消/超时提前结束
+  PathTable paths;
+
+  std::string path(const SearchHit& hit) const { return paths.path(hit.file); }
+};
+
+// 一次搜多个 query（子串；大小写 / 整词同 options，--smart-case 对每个 query 单独判断，不支持 regex）：
+// 每个文件只读、只扫一遍，每个 query 的 top-k 和单独用 search_text 搜它时一样
+MultiSearchResult search_text_multi(const fs::path& root, const std::vector<std::string>& queries,
+                                    int topk, std::size_t max_bytes,
+                                    const CancelToken* cancel = nullptr,
+                                    const SearchOptions& options = {});
+
+// ---- 命令层 ----
+
+// 命令行参数（去掉 argv[0]），形如 {"list-files", "--root", "."}。
+// serve 模式下，JSON 请求里的 args 对象也会被还原成同样的形式，保证两条路径共用同一套解析。
+using Args = std::vector<std::string>;
+
+// 不带值的开关（--stream、--regex ...）。其余参数名都带一个值：解析时值总是和参数名配对，
+// 哪怕值本身以 -- 开头（search-text --query --stream 搜的是字符串 "--stream"）
+bool is_switch(std::string_view key);
+
+// 下面几个都从子命令后面开始按 (参数名, 值) 配对着找，不会把某个参数的值当成参数名
+std::optional<std::string> arg_value(const Args& args, const std::string& key);
+
+// 可以重复、也可以逗号分隔的参数：--ext cpp,h --ext py -> {"cpp","h","py"}
+std::vector<std::string> arg_values(const Args& args, const std::string& key);
+
+// 可以重复、但不按逗号拆开的参数（值里本来就可能有逗号）：--queries a,b --queries c -> {"a,b","c"}
+std::vector<std::string> arg_list(const Args& args, const std::string& key);
+
+// 给没给这个开关（或参数名）
+bool has_flag(const Args& args, const std::string& key);
+
+// --threads N（serve、batch、search-text）：1..kMaxThreads 的十进制整数。
+// 别的值（x、0、-1、几十万）返回 nullopt，调用方回 invalid_threads，而不是起线程起到崩溃
+constexpr std::size_t kMaxThreads = 256;
+std::optional<std::size_t> parse_threads(const std::string& text);
+
+// 按子命令分发；返回 nullopt 表示未知子命令（由调用方决定是打印 usage 还是回一个错误）。
+// 输出按 --format（json/cbor/msgpack）编码，每条记录编码完整后交给 sink，tags 插在每条记录开头。
+// 所有子命令都接受 --deadline-ms N；cancel 是调用方持有的取消令牌（serve 的 cancel 请求、batch），
+// 这次调用的截止时间挂在它下面。
+std::optional<int> run_command(const Args& args, const RecordSink& sink,
+                               const RecordTags& tags = {},
+                               const std::function<void()>& flush = nullptr,
+                               const CancelToken* cancel = nullptr);
+
+// 同上，直接写到一个 ostream（CLI 用）
+std::optional<int> run_command(const Args& args, std::ostream& out);
+
+// serve / batch 里执行单个子命令的统一入口：加工作区锁，并把异常和未知命令都变成错误记录。
+int run_command_guarded(const Args& args, const RecordSink& sink, const RecordTags& tags = {},
+                        const std::function<void()>& flush = nullptr,
+                        const CancelToken* cancel = nullptr);
+
+// run_command 认识的子命令（serve / shutdown / cancel 这些会话级命令不算）
+bool is_known_command(const std::string& cmd);
+
+// apply-edits / rollback 这类会修改工作区的命令
+bool is_mutating_command(const std::string& cmd);
+
+// 原样回显请求 id：字符串和数字原样保留，其它情况一律 null。
+JsonValue request_id_value(const JsonValue* id);
+
+// {"cmd":"read-file","args":{"path":"a.cpp","max-bytes":100}}
+//   -> {"read-file", "--path", "a.cpp", "--max-bytes", "100"}
+bool request_to_args(const JsonValue& req, Args& args, std::string& err);
+
+}  // namespace engine
@@ -0,0 +1,105 @@
+/*
+  engine/src/file_kind.cpp：file_kind.h 的实现
+*/
+
+#include "file_kind.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <unordered_set>
+
+namespace engine {
+
+namespace {
+
+// 确定是二进制格式的扩展名（小写）。拿不准的（.bin、.dat、.svg 之类）不放进来，交给内容判断
+const std::unordered_set<std::string_view>& binary_extensions() {
+  static const std::unordered_set<std::string_view> exts = {
+      // 目标文件 / 库 / 可执行文件 / 字节码
+      "o", "obj", "a", "lib", "so", "dylib", "dll", "exe", "pdb", "ilk", "gch", "pch", "class",
+      "jar", "war", "pyc", "pyo", "pyd", "wasm",
+      // 压缩包 / 安装包
+      "zip", "gz", "tgz", "bz2", "xz", "zst", "lz4", "7z", "rar", "tar", "dmg", "iso", "deb",
+      "rpm", "apk", "whl",
+      // 图片 / 字体 / 音视频
+      "png", "jpg", "jpeg", "gif", "bmp", "ico", "icns", "webp", "tif", "tiff", "psd", "ttf",
+      "otf", "woff", "woff2", "eot", "mp3", "mp4", "m4a", "wav", "flac", "ogg", "avi", "mov",
+      "mkv", "webm",
+      // 文档 / 数据
+      "pdf", "doc", "docx", "xls", "xlsx", "ppt", "pptx", "sqlite", "sqlite3", "db", "npy", "npz",
+      "pkl", "pt", "onnx",
+  };
+  return exts;
+}
+
+// 认识的魔数（都不含 NUL，所以可以直接用字符串字面量）
+constexpr std::string_view kMagics[] = {
+    "\x7f" "ELF",
+    "\xfe\xed\xfa\xce", "\xfe\xed\xfa\xcf", "\xce\xfa\xed\xfe", "\xcf\xfa\xed\xfe",  // Mach-O
+    "\xca\xfe\xba\xbe",  // Mach-O fat / Java class
+    "!<arch>\n",         // ar（.a 静态库）
+    "PK\x03\x04",        // zip / jar / docx
+    "\x1f\x8b",          // gzip
+    "\x28\xb5\x2f\xfd",  // zstd
+    "\xfd" "7zXZ",       // xz
+    "7z\xbc\xaf\x27\x1c",
+    "Rar!\x1a\x07",
+    "\x89PNG\r\n\x1a\n",
+    "\xff\xd8\xff",  // JPEG
+    "GIF87a", "GIF89a",
+    "%PDF-",
+    "SQLite format 3",
+    "wOFF", "wOF2",
+};
+
+bool has_magic(const char* data, std::size_t size) {
+  for (std::string_view m : kMagics) {
+    if (size >= m.size() && std::memcmp(data, m.data(), m.size()) == 0) return true;
+  }
+  // PE（Windows 可执行文件 / DLL）："MZ" 开头，0x3c 处的偏移指向 "PE\0\0"。只有 "MZ" 的文本文件不算
+  if (size >= 64 && data[0] == 'M' && data[1] == 'Z') {
+    std::uint32_t pe = 0;
+    std::memcpy(&pe, data + 0x3c, 4);  // 小端
+    if (pe <= size - 4 && std::memcmp(data + pe, "PE\0\0", 4) == 0) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+FileKind kind_from_name(std::string_view name) {
+  std::size_t dot = name.rfind('.');
+  if (dot == std::string_view::npos || dot == 0 || dot + 1 == name.size()) {
+    return FileKind::Unknown;
+  }
+  std::string_view ext = name.substr(dot + 1);
+  if (ext.size() > 8) return FileKind::Unknown;
+  char lower[8];
+  for (std::size_t i = 0; i < ext.size(); i++) {
+    lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(ext[i])));
+  }
+  return binary_extensions().count(std::string_view(lower, ext.size())) != 0 ? FileKind::Binary
+                                                                              : FileKind::Unknown;
+}
+
+FileKind kind_from_content(const char* data, std::size_t size) {
+  size = std::min(size, kKindProbeBytes);
+  if (has_magic(data, size)) return FileKind::Binary;
+  return is_likely_text(data, size) ? FileKind::Text : FileKind::Binary;
+}
+
+bool is_likely_text(const char* data, std::size_t size) {
+  std::size_t sample = std::min(size, kKindProbeBytes);
+  if (sample == 0) return true;
+  std::size_t suspicious = 0;
+  for (std::size_t i = 0; i < sample; i++) {
+    unsigned char c = static_cast<unsigned char>(data[i]);
+    if (c == 0) return false;
+    if (c < 0x09) suspicious++;
+    if (c >= 0x0E && c < 0x20) suspicious++;
+  }
+  return suspicious * 100 / sample < 5;
+}
+
+}  // namespace engine
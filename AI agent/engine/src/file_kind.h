@@ -0,0 +1,43 @@
+/*
+  engine/src/file_kind.h：文本 / 二进制判断（扩展名表 + 开头一小块的魔数和字符统计）
+
+  search-text 原来对每个文件都先读满 max_bytes 再判断是不是文本，可执行文件、.o、压缩包
+  读进来就扔掉。现在分三层，越前面越便宜：
+  1. 扩展名：确定是二进制格式的（.o / .so / .png / .zip ...）直接跳过，一次系统调用都不用；
+  2. manifest 里记下的结果（manifest.h，按 inode + size + mtime 校验）：已知是二进制的只 stat 一下；
+  3. 开头 kKindProbeBytes 字节：认识的魔数（ELF、Mach-O、PE、ar、zip、gzip、PNG ...）或者
+     有 NUL / 控制字符太多就是二进制，只有文本才继续往后读。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace engine {
+
+enum class FileKind : std::uint8_t {
+  Unknown = 0,  // 还没判断过（manifest 里旧记录、读失败）
+  Text = 1,
+  Binary = 2,
+};
+
+// 判断内容时看开头多少字节
+constexpr std::size_t kKindProbeBytes = 4096;
+
+// 只看文件名：扩展名确定是二进制格式时返回 Binary，否则 Unknown（扩展名不能证明是文本）
+FileKind kind_from_name(std::string_view name);
+
+// 只看内容开头（调用方给多少看多少，最多 kKindProbeBytes）：魔数或字符统计
+FileKind kind_from_content(const char* data, std::size_t size);
+
+// 很粗糙的“是否像文本”的判断：避免把二进制文件（如 .dSYM/可执行文件）当成文本处理。
+// 只看前 kKindProbeBytes 字节：有 NUL 或者控制字符超过 5% 就不是文本（空内容算文本）
+bool is_likely_text(const char* data, std::size_t size);
+inline bool is_likely_text(const std::string& bytes) {
+  return is_likely_text(bytes.data(), bytes.size());
+}
+
+}  // namespace engine
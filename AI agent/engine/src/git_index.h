@@ -0,0 +1,59 @@
+/*
+  engine/src/git_index.h：直接读 .git/index 列出 git 跟踪的文件（list-files --git-index）
+
+  git 工作区里，.git/index 已经按路径排好序列出了每个被跟踪的文件，还带着上次 git 看到它时的
+  stat 信息（mtime / ctime / inode / size / mode）。所以不用遍历目录树：
+  - 只列文件：读一个文件、解析一遍，每个文件零次系统调用；
+  - check_stat：每个文件一次 lstat（不 open、不读内容），和索引里的 stat 缓存对比，
+    对不上的标记为 modified，已经不存在的放进 deleted（和 git status 的第一步一样）；
+  - 未跟踪的文件：由调用方传入一次遍历的结果（遵循 .gitignore），不在索引里的合并进来，标记为 untracked。
+
+  不调用 git 可执行文件。支持索引版本 2/3/4（v4 的路径前缀压缩）、SHA-1 和 SHA-256 仓库、
+  .git 是 "gitdir: ..." 文件的 worktree / submodule。
+  split index（link 扩展）和 sparse index（目录条目）不支持，返回错误由调用方退回普通遍历。
+
+  和 git 的差别：
+  - 索引写入时 mtime 还没过去的文件（"racily clean"）git 会再比一次内容；这里不算哈希，直接当作 modified；
+  - 有冲突（多个 stage）的文件当作 modified；
+  - skip-worktree（稀疏检出时不在工作区里的文件）不列出；assume-unchanged 的文件不 stat，当作未修改；
+  - submodule（gitlink 条目）不列出。
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "cancel.h"
+#include "path_table.h"
+
+namespace engine {
+
+enum class GitFileState : std::uint8_t {
+  Clean,      // 跟踪的文件，stat 和索引一致（或者没有检查）
+  Modified,   // 跟踪的文件，stat 对不上
+  Untracked,  // 不在索引里，来自调用方传入的遍历结果
+};
+
+struct GitIndexOptions {
+  bool check_stat = false;               // 逐个 lstat，找出 modified / deleted
+  const PathTable* worktree = nullptr;   // 非空时把其中不在索引里的文件作为 untracked 合并进来
+};
+
+struct GitListing {
+  PathTable files;                  // 按路径排序：跟踪的文件（去掉 deleted）+ untracked
+  std::vector<GitFileState> state;  // 和 files 一一对应
+  PathTable deleted;                // 索引里有、工作区里没有的文件（只在 check_stat 时有）
+  std::size_t tracked = 0;          // 索引里的文件数（去重、去掉 gitlink / skip-worktree 之后）
+  bool complete = true;             // check_stat 被取消/超时打断时为 false（之后的文件当作未修改）
+};
+
+// root 必须是工作区的顶层目录（root/.git 存在）。失败时返回 false，err 是原因：
+// not_a_git_worktree / index_unreadable / index_corrupt / unsupported_version /
+// split_index / sparse_index
+bool list_git_files(const std::filesystem::path& root, const GitIndexOptions& options,
+                    const CancelToken* cancel, GitListing& out, std::string& err);
+
+}  // namespace engine
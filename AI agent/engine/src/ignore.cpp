@@ -0,0 +1,260 @@
+/*
+  engine/src/ignore.cpp：ignore.h 的实现
+*/
+
+#include "ignore.h"
+
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace engine {
+
+namespace {
+
+bool has_glob_meta(std::string_view s) {
+  return s.find_first_of("*?[\\") != std::string_view::npos;
+}
+
+bool read_text(const std::string& path, std::string& out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return true;
+}
+
+// [...] 字符类：pi 指向 '['；成功时 pi 移到 ']' 之后。没有闭合的 ']' 时返回 false（'[' 按普通字符处理）
+bool match_class(std::string_view p, std::size_t& pi, char c, bool& matched) {
+  std::size_t i = pi + 1;
+  bool negate = false;
+  if (i < p.size() && (p[i] == '!' || p[i] == '^')) {
+    negate = true;
+    i++;
+  }
+  bool hit = false;
+  bool first = true;
+  while (i < p.size() && (first || p[i] != ']')) {
+    first = false;
+    char lo = p[i];
+    if (lo == '\\' && i + 1 < p.size()) lo = p[++i];
+    char hi = lo;
+    if (i + 2 < p.size() && p[i + 1] == '-' && p[i + 2] != ']') {
+      hi = p[i + 2];
+      if (hi == '\\' && i + 3 < p.size()) hi = p[++i + 2];
+      i += 2;
+    }
+    if (lo <= c && c <= hi) hit = true;
+    i++;
+  }
+  if (i >= p.size()) return false;
+  pi = i + 1;
+  matched = hit != negate;
+  return true;
+}
+
+bool glob_at(std::string_view p, std::size_t pi, std::string_view s, std::size_t si) {
+  while (pi < p.size()) {
+    char c = p[pi];
+    if (c == '*') {
+      bool segment_start = pi == 0 || p[pi - 1] == '/';
+      if (segment_start && pi + 1 < p.size() && p[pi + 1] == '*') {
+        std::size_t after = pi + 2;
+        if (after == p.size()) return true;  // "a/**"：目录下的一切
+        if (p[after] == '/') {
+          // "**/"：匹配零个或多个目录
+          if (glob_at(p, after + 1, s, si)) return true;
+          for (std::size_t k = si; k < s.size(); k++) {
+            if (s[k] == '/' && glob_at(p, after + 1, s, k + 1)) return true;
+          }
+          return false;
+        }
+      }
+      // 普通的 *（以及不成段的 **）：匹配零个或多个非 "/" 字符
+      while (pi < p.size() && p[pi] == '*') pi++;
+      if (pi == p.size()) return s.find('/', si) == std::string_view::npos;
+      for (std::size_t k = si;; k++) {
+        if (glob_at(p, pi, s, k)) return true;
+        if (k == s.size() || s[k] == '/') return false;
+      }
+    }
+    if (si == s.size()) return false;
+    if (c == '?') {
+      if (s[si] == '/') return false;
+      pi++;
+      si++;
+      continue;
+    }
+    if (c == '[') {
+      bool matched = false;
+      std::size_t next = pi;
+      if (s[si] != '/' && match_class(p, next, s[si], matched)) {
+        if (!matched) return false;
+        pi = next;
+        si++;
+        continue;
+      }
+      if (s[si] == '/' && match_class(p, next, 'x', matched)) return false;
+    }
+    if (c == '\\' && pi + 1 < p.size()) c = p[++pi];
+    if (s[si] != c) return false;
+    pi++;
+    si++;
+  }
+  return si == s.size();
+}
+
+}  // namespace
+
+bool glob_match(std::string_view pattern, std::string_view text) {
+  return glob_at(pattern, 0, text, 0);
+}
+
+void IgnoreRules::add(std::string_view text) {
+  std::size_t start = 0;
+  while (start <= text.size()) {
+    std::size_t end = text.find('\n', start);
+    if (end == std::string_view::npos) end = text.size();
+    add_line(std::string(text.substr(start, end - start)));
+    start = end + 1;
+  }
+}
+
+void IgnoreRules::add_line(std::string line) {
+  if (!line.empty() && line.back() == '\r') line.pop_back();
+  if (line.empty() || line[0] == '#') return;
+  // 行尾空格忽略，除非用反斜杠转义
+  while (!line.empty() && line.back() == ' ' &&
+         !(line.size() >= 2 && line[line.size() - 2] == '\\')) {
+    line.pop_back();
+  }
+  Rule rule;
+  if (line[0] == '!') {
+    rule.negate = true;
+    line.erase(0, 1);
+  }
+  if (!line.empty() && line.back() == '/') {
+    rule.dir_only = true;
+    line.pop_back();
+  }
+  if (line.find('/') != std::string::npos) {
+    rule.anchored = true;
+    if (line[0] == '/') line.erase(0, 1);
+  }
+  if (line.empty()) return;
+  // "**/name" 等价于不锚定的 "name"，走文件名哈希表
+  if (rule.anchored && line.compare(0, 3, "**/") == 0 &&
+      line.find('/', 3) == std::string::npos && !has_glob_meta(line.substr(3))) {
+    rule.anchored = false;
+    line.erase(0, 3);
+  }
+  rule.pattern = std::move(line);
+
+  auto index = static_cast<std::uint32_t>(rules_.size());
+  const std::string& pat = rule.pattern;
+  if (!has_glob_meta(pat)) {
+    slot(rule.anchored ? by_path_ : by_name_, pat).push_back(index);
+  } else if (!rule.anchored && pat.size() > 2 && pat.compare(0, 2, "*.") == 0 &&
+             pat.find('.', 2) == std::string::npos && !has_glob_meta(pat.substr(2))) {
+    slot(by_ext_, std::string_view(pat).substr(2)).push_back(index);
+  } else {
+    globs_.push_back(index);
+  }
+  rules_.push_back(std::move(rule));
+}
+
+std::vector<std::uint32_t>& IgnoreRules::slot(Index& index, std::string_view key) {
+  auto it = index.find(key);
+  if (it != index.end()) return it->second;
+  keys_.emplace_back(key);
+  return index[keys_.back()];
+}
+
+void IgnoreRules::pick(const std::vector<std::uint32_t>& indices, bool is_dir,
+                       std::int64_t& best) const {
+  for (auto it = indices.rbegin(); it != indices.rend(); ++it) {
+    if (static_cast<std::int64_t>(*it) <= best) return;
+    if (!rules_[*it].dir_only || is_dir) {
+      best = *it;
+      return;
+    }
+  }
+}
+
+IgnoreMatch IgnoreRules::match(std::string_view rel, std::string_view name, bool is_dir) const {
+  if (rules_.empty()) return IgnoreMatch::None;
+  std::int64_t best = -1;  // 命中的规则里编号最大的那条（同一文件里后面的规则优先）
+  if (!by_name_.empty()) {
+    auto it = by_name_.find(name);
+    if (it != by_name_.end()) pick(it->second, is_dir, best);
+  }
+  if (!by_ext_.empty()) {
+    std::size_t dot = name.rfind('.');
+    if (dot != std::string_view::npos) {
+      auto it = by_ext_.find(name.substr(dot + 1));
+      if (it != by_ext_.end()) pick(it->second, is_dir, best);
+    }
+  }
+  if (!by_path_.empty()) {
+    auto it = by_path_.find(rel);
+    if (it != by_path_.end()) pick(it->second, is_dir, best);
+  }
+  for (auto it = globs_.rbegin(); it != globs_.rend(); ++it) {
+    if (static_cast<std::int64_t>(*it) <= best) break;
+    const Rule& rule = rules_[*it];
+    if (rule.dir_only && !is_dir) continue;
+    if (glob_match(rule.pattern, rule.anchored ? rel : name)) {
+      best = *it;
+      break;
+    }
+  }
+  if (best < 0) return IgnoreMatch::None;
+  return rules_[static_cast<std::size_t>(best)].negate ? IgnoreMatch::Whitelist
+                                                        : IgnoreMatch::Ignore;
+}
+
+std::shared_ptr<const IgnoreNode> default_ignore_node() {
+  static const std::shared_ptr<const IgnoreNode> node = [] {
+    auto n = std::make_shared<IgnoreNode>();
+    n->rules.add("build\nnode_modules\ndist\n__pycache__\n.venv\n.idea\n.vscode\n*.dSYM\n");
+    return n;
+  }();
+  return node;
+}
+
+std::shared_ptr<const IgnoreNode> load_ignore_node(std::shared_ptr<const IgnoreNode> parent,
+                                                   const std::string& abs_dir,
+                                                   const std::string& rel_dir, bool is_root) {
+  std::string base = abs_dir;
+  if (!base.empty() && base.back() != '/') base += '/';
+  IgnoreRules rules;
+  std::string text;
+  // 按优先级从低到高：.git/info/exclude（只在根目录）< .gitignore < .ignore
+  if (is_root && read_text(base + ".git/info/exclude", text)) rules.add(text);
+  if (read_text(base + ".gitignore", text)) rules.add(text);
+  if (read_text(base + ".ignore", text)) rules.add(text);
+  if (rules.empty()) return parent;
+  auto node = std::make_shared<IgnoreNode>();
+  node->parent = std::move(parent);
+  node->dir = rel_dir;
+  node->rules = std::move(rules);
+  return node;
+}
+
+bool is_ignored(const IgnoreNode* node, std::string_view rel, std::string_view name,
+                bool is_dir) {
+  for (; node != nullptr; node = node->parent.get()) {
+    std::string_view sub = rel;
+    if (!node->dir.empty()) {
+      if (rel.size() <= node->dir.size() || rel.compare(0, node->dir.size(), node->dir) != 0 ||
+          rel[node->dir.size()] != '/') {
+        continue;
+      }
+      sub = rel.substr(node->dir.size() + 1);
+    }
+    IgnoreMatch m = node->rules.match(sub, name, is_dir);
+    if (m != IgnoreMatch::None) return m == IgnoreMatch::Ignore;
+  }
+  return false;
+}
+
+}  // namespace engine
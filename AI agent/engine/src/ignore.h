@@ -0,0 +1,98 @@
+/*
+  engine/src/ignore.h：.gitignore / .ignore 规则（遍历时用来剪枝）
+
+  原来只认识写死的 8 个目录名 + .dSYM，其余的生成物、vendor 目录、数据目录都会被遍历和读取。
+  现在按 git 的语义支持：
+  - 每一层目录里的 .gitignore 和 .ignore（同一目录里 .ignore 优先级更高，和 ripgrep 一致），
+    根目录额外读 .git/info/exclude（优先级最低）
+  - 通配符 * ? [a-z] [!x]、跨目录的 "**"（放在模式开头、结尾或两个 "/" 之间）、反斜杠转义
+  - "!" 取反（重新包含）、结尾 "/" 只匹配目录、开头或中间有 "/" 时相对于规则文件所在目录锚定
+  - 越深的规则文件优先；同一个文件里后面的规则优先
+  原来那几个目录名作为内置规则放在最底层，仓库自己的 .gitignore 可以用 "!build/" 之类把它们加回来；
+  .git 目录本身始终跳过。
+
+  每个规则文件只在遍历到它所在目录时编译一次：
+  - 不含通配符的文件名（"node_modules"）放进哈希表，按名字查
+  - "*.ext" 形式的规则按扩展名放进哈希表
+  - 不含通配符的锚定路径（"/out"、"docs/gen"）按相对路径查
+  - 剩下的才逐条做通配符匹配
+  目录一旦被忽略就不会进入（遍历器在 push 子目录之前判断），所以被忽略的大目录几乎零开销。
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+enum class IgnoreMatch { None, Ignore, Whitelist };
+
+class IgnoreRules {
+  // 一个目录的全部规则（可能来自多个文件，按优先级从低到高依次 add）
+ public:
+  IgnoreRules() = default;
+  // 索引的键指向自己的 keys_：只能移动
+  IgnoreRules(const IgnoreRules&) = delete;
+  IgnoreRules& operator=(const IgnoreRules&) = delete;
+  IgnoreRules(IgnoreRules&&) = default;
+  IgnoreRules& operator=(IgnoreRules&&) = default;
+
+  // 按 .gitignore 的语法解析 text 并追加到规则末尾（优先级比已有规则高）
+  void add(std::string_view text);
+  bool empty() const { return rules_.empty(); }
+
+  // rel：相对于规则所在目录的路径；name：最后一段文件名
+  IgnoreMatch match(std::string_view rel, std::string_view name, bool is_dir) const;
+
+ private:
+  struct Rule {
+    std::string pattern;  // 去掉 "!"、开头和结尾的 "/" 之后的通配符模式
+    bool negate = false;
+    bool dir_only = false;
+    bool anchored = false;  // 匹配相对路径；否则只匹配文件名
+  };
+
+  // 键是指向 keys_ 的 string_view：match 直接拿调用方的 string_view 查，不用每次拼一个 std::string
+  using Index = std::unordered_map<std::string_view, std::vector<std::uint32_t>>;
+
+  void add_line(std::string line);
+  std::vector<std::uint32_t>& slot(Index& index, std::string_view key);
+  // 在 indices（升序）里找最后一条对当前条目生效的规则，结果比 best 大时更新 best
+  void pick(const std::vector<std::uint32_t>& indices, bool is_dir, std::int64_t& best) const;
+
+  std::vector<Rule> rules_;
+  std::deque<std::string> keys_;  // deque：追加时已有元素不搬家，移动整个对象时也原样接管
+  Index by_name_;
+  Index by_ext_;
+  Index by_path_;
+  std::vector<std::uint32_t> globs_;
+};
+
+struct IgnoreNode {
+  // 从当前目录一直连到根的规则链；子目录没有自己的规则文件时直接共享父节点
+  std::shared_ptr<const IgnoreNode> parent;
+  std::string dir;  // 规则所在目录（相对 root，根目录为空串）
+  IgnoreRules rules;
+};
+
+// 内置的最底层规则（原来写死的那几个目录名 + *.dSYM）
+std::shared_ptr<const IgnoreNode> default_ignore_node();
+
+// 读取 abs_dir 下的规则文件（is_root 时还有 .git/info/exclude）；没有任何规则时原样返回 parent
+std::shared_ptr<const IgnoreNode> load_ignore_node(std::shared_ptr<const IgnoreNode> parent,
+                                                   const std::string& abs_dir,
+                                                   const std::string& rel_dir, bool is_root);
+
+// rel 是相对 root 的路径，name 是它的最后一段；从最深的规则文件往上找第一条命中的规则
+bool is_ignored(const IgnoreNode* node, std::string_view rel, std::string_view name, bool is_dir);
+
+// gitignore 风格的通配符匹配（* ? 不跨 "/"，** 可以跨目录）
+bool glob_match(std::string_view pattern, std::string_view text);
+
+}  // namespace engine
@@ -0,0 +1,281 @@
+/*
+  engine/src/json.cpp：json.h 的实现
+*/
+
+#include "json.h"
+
+#include <cstdio>
+
+namespace engine {
+
+void json_escape_to(std::string& out, std::string_view s) {
+  for (unsigned char c : s) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (c < 0x20) { // 大小 32 以下的控制字符，用 \u00XX 表示
+          char buf[7]; // \uXXXX + NUL
+          std::snprintf(buf, sizeof(buf), "\\u%04X", static_cast<unsigned int>(c)); // %04X是四位十六进制，输出到buf里
+          out += buf;
+        } else {
+          out.push_back(static_cast<char>(c)); // 普通字符直接添加
+        }
+    }
+  }
+}
+
+std::string json_escape(const std::string& s) {
+  std::string out;
+  out.reserve(s.size() + 16);
+  json_escape_to(out, s);
+  return out;
+}
+
+namespace {
+
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string& text) : s_(text) {}
+
+  bool parse(JsonValue& out, std::string& err) {
+    if (!parse_value(out, 0)) {
+      err = err_;
+      return false;
+    }
+    skip_ws();
+    if (pos_ != s_.size()) {
+      err = "trailing_characters";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  static constexpr int kMaxDepth = 64;
+
+  void skip_ws() {
+    while (pos_ < s_.size() && (s_[pos_] == ' ' || s_[pos_] == '\t' ||
+                                s_[pos_] == '\n' || s_[pos_] == '\r'))
+      pos_++;
+  }
+
+  bool fail(const char* e) {
+    err_ = e;
+    return false;
+  }
+
+  bool consume_literal(const char* lit) {
+    std::size_t n = std::char_traits<char>::length(lit);
+    if (s_.compare(pos_, n, lit) != 0) return fail("invalid_literal");
+    pos_ += n;
+    return true;
+  }
+
+  bool parse_value(JsonValue& v, int depth) {
+    if (depth > kMaxDepth) return fail("too_deep");
+    skip_ws();
+    if (pos_ >= s_.size()) return fail("unexpected_end");
+    char c = s_[pos_];
+    if (c == '{') return parse_object(v, depth);
+    if (c == '[') return parse_array(v, depth);
+    if (c == '"') {
+      v.type = JsonValue::Type::String;
+      return parse_string(v.text);
+    }
+    if (c == 't') {
+      v.type = JsonValue::Type::Bool;
+      v.boolean = true;
+      return consume_literal("true");
+    }
+    if (c == 'f') {
+      v.type = JsonValue::Type::Bool;
+      v.boolean = false;
+      return consume_literal("false");
+    }
+    if (c == 'n') {
+      v.type = JsonValue::Type::Null;
+      return consume_literal("null");
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+      std::size_t start = pos_;
+      pos_++;
+      while (pos_ < s_.size()) {
+        char d = s_[pos_];
+        if ((d >= '0' && d <= '9') || d == '.' || d == 'e' || d == 'E' || d == '+' ||
+            d == '-') {
+          pos_++;
+        } else {
+          break;
+        }
+      }
+      v.type = JsonValue::Type::Number;
+      v.text = s_.substr(start, pos_ - start);
+      return true;
+    }
+    return fail("unexpected_character");
+  }
+
+  bool parse_object(JsonValue& v, int depth) {
+    v.type = JsonValue::Type::Object;
+    pos_++;  // '{'
+    skip_ws();
+    if (pos_ < s_.size() && s_[pos_] == '}') {
+      pos_++;
+      return true;
+    }
+    while (true) {
+      skip_ws();
+      if (pos_ >= s_.size() || s_[pos_] != '"') return fail("expected_key");
+      std::string key;
+      if (!parse_string(key)) return false;
+      skip_ws();
+      if (pos_ >= s_.size() || s_[pos_] != ':') return fail("expected_colon");
+      pos_++;
+      JsonValue member;
+      if (!parse_value(member, depth + 1)) return false;
+      v.members.emplace_back(std::move(key), std::move(member));
+      skip_ws();
+      if (pos_ >= s_.size()) return fail("unexpected_end");
+      if (s_[pos_] == ',') {
+        pos_++;
+        continue;
+      }
+      if (s_[pos_] == '}') {
+        pos_++;
+        return true;
+      }
+      return fail("expected_comma_or_brace");
+    }
+  }
+
+  bool parse_array(JsonValue& v, int depth) {
+    v.type = JsonValue::Type::Array;
+    pos_++;  // '['
+    skip_ws();
+    if (pos_ < s_.size() && s_[pos_] == ']') {
+      pos_++;
+      return true;
+    }
+    while (true) {
+      JsonValue item;
+      if (!parse_value(item, depth + 1)) return false;
+      v.items.push_back(std::move(item));
+      skip_ws();
+      if (pos_ >= s_.size()) return fail("unexpected_end");
+      if (s_[pos_] == ',') {
+        pos_++;
+        continue;
+      }
+      if (s_[pos_] == ']') {
+        pos_++;
+        return true;
+      }
+      return fail("expected_comma_or_bracket");
+    }
+  }
+
+  static void append_utf8(std::string& out, unsigned int cp) {
+    if (cp <= 0x7F) {
+      out.push_back(static_cast<char>(cp));
+    } else if (cp <= 0x7FF) {
+      out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp <= 0xFFFF) {
+      out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+      out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  bool parse_hex4(unsigned int& code) {
+    if (pos_ + 4 > s_.size()) return fail("invalid_unicode_escape");
+    code = 0;
+    for (int k = 0; k < 4; k++) {
+      char h = s_[pos_ + k];
+      code <<= 4;
+      if (h >= '0' && h <= '9')
+        code |= static_cast<unsigned int>(h - '0');
+      else if (h >= 'a' && h <= 'f')
+        code |= static_cast<unsigned int>(10 + h - 'a');
+      else if (h >= 'A' && h <= 'F')
+        code |= static_cast<unsigned int>(10 + h - 'A');
+      else
+        return fail("invalid_unicode_escape");
+    }
+    pos_ += 4;
+    return true;
+  }
+
+  bool parse_string(std::string& out) {
+    pos_++;  // '"'
+    out.clear();
+    while (pos_ < s_.size()) {
+      char c = s_[pos_++];
+      if (c == '"') return true;
+      if (c != '\\') {
+        out.push_back(c);
+        continue;
+      }
+      if (pos_ >= s_.size()) break;
+      char n = s_[pos_++];
+      switch (n) {
+        case 'n': out.push_back('\n'); break;
+        case 't': out.push_back('\t'); break;
+        case 'r': out.push_back('\r'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case '/': out.push_back('/'); break;
+        case '"': out.push_back('"'); break;
+        case '\\': out.push_back('\\'); break;
+        case 'u': {
+          unsigned int code = 0;
+          if (!parse_hex4(code)) return false;
+          // UTF-16 代理对：😀 这种要拼成一个码点
+          if (code >= 0xD800 && code <= 0xDBFF && pos_ + 6 <= s_.size() &&
+              s_[pos_] == '\\' && s_[pos_ + 1] == 'u') {
+            pos_ += 2;
+            unsigned int low = 0;
+            if (!parse_hex4(low)) return false;
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          }
+          append_utf8(out, code);
+          break;
+        }
+        default:
+          return fail("unsupported_escape");
+      }
+    }
+    return fail("unterminated_string");
+  }
+
+  const std::string& s_;
+  std::size_t pos_ = 0;
+  std::string err_;
+};
+
+}  // namespace
+
+bool parse_json(const std::string& text, JsonValue& out, std::string& err) {
+  return JsonParser(text).parse(out, err);
+}
+
+}  // namespace engine
@@ -0,0 +1,46 @@
+/*
+  engine/src/json.h：engine 内部用到的最小 JSON 工具
+
+  - json_escape：把任意字节串放进 JSON 字符串字段（输出侧，所有子命令都在用）
+  - JsonValue / parse_json：解析 serve 请求与 batch 请求文件（输入侧）
+
+  刻意不引入第三方 JSON 库：协议很小，自己写几百行就够了，也方便答辩时讲清楚。
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace engine {
+
+// 把任意字符串安全地放进 JSON 字符串字段里（最小实现，只处理常见转义）
+std::string json_escape(const std::string& s);
+
+// 同上，但直接追加到 out 末尾（省一次临时字符串，输出大块内容时用）
+void json_escape_to(std::string& out, std::string_view s);
+
+struct JsonValue {
+  // 最小 JSON DOM：给 serve / batch 协议解析请求用。
+  // number 保留原始文本（raw），这样 "topk":5 还原成命令行参数时仍然是 "5"。
+  enum class Type { Null, Bool, Number, String, Array, Object };
+  Type type = Type::Null;
+  bool boolean = false;
+  std::string text;  // String：反转义后的内容；Number：原始文本
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  const JsonValue* get(const std::string& key) const {
+    for (const auto& kv : members) {
+      if (kv.first == key) return &kv.second;
+    }
+    return nullptr;
+  }
+};
+
+// 解析一段完整的 JSON 文本；失败时 err 是一个简短的错误码（如 "unexpected_end"）。
+bool parse_json(const std::string& text, JsonValue& out, std::string& err);
+
+}  // namespace engine
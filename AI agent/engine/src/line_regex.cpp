@@ -0,0 +1,1112 @@
+/*
+  engine/src/line_regex.cpp：line_regex.h 的实现
+
+  模式先解析成语法树（Node），再从语法树编出 NFA 指令（RegexCompiler），字面串和最短长度也在语法树上算。
+  字符类统一先表示成码点区间，再按 UTF-8 编码拆成“每个字节一个范围”的序列（和 RE2 一样），
+  所以 NFA / DFA 只处理字节，[一-龥] 这样的非 ASCII 范围也能用。
+*/
+
+#include "line_regex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace engine {
+
+namespace {
+
+constexpr int kMaxRepeat = 1000;        // {m,n} 的上限（同 RE2）
+constexpr std::size_t kMaxInsts = 200000;  // 展开后的 NFA 指令数上限
+constexpr int kMaxDepth = 500;          // 括号嵌套深度上限（解析是递归的）
+constexpr std::size_t kMaxLiteral = 256;
+constexpr std::size_t kInfiniteLength = 1u << 20;
+constexpr std::uint32_t kMaxCodepoint = 0x10FFFF;
+
+using Ranges = std::vector<std::pair<std::uint32_t, std::uint32_t>>;  // 闭区间
+
+// 和 LineRegex::AssertKind 的取值一一对应
+enum AssertCode : int { kLineStart, kLineEnd, kWordBoundary, kNotWordBoundary };
+
+struct Node {
+  enum Kind : std::uint8_t { Empty, Bytes, Concat, Alternate, Repeat, Assert };
+  Kind kind = Empty;
+  std::bitset<256> bytes;      // Bytes：一个字节，取值在这个集合里
+  std::vector<Node> children;  // Concat / Alternate；Repeat 只有一个
+  int min = 0;
+  int max = -1;  // Repeat：-1 表示不限
+  int assert_kind = 0;
+};
+
+bool is_word_byte(unsigned c) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+void normalize(Ranges& r) {
+  std::sort(r.begin(), r.end());
+  Ranges out;
+  for (auto [lo, hi] : r) {
+    if (!out.empty() && lo <= out.back().second + 1) {
+      out.back().second = std::max(out.back().second, hi);
+    } else {
+      out.emplace_back(lo, hi);
+    }
+  }
+  r.swap(out);
+}
+
+// 加上区间里 ASCII 字母的另一种大小写（(?i)）
+void fold_ranges(Ranges& r) {
+  Ranges extra;
+  for (auto [lo, hi] : r) {
+    for (std::uint32_t base : {std::uint32_t{'A'}, std::uint32_t{'a'}}) {
+      std::uint32_t a = std::max(lo, base), b = std::min(hi, base + 25);
+      if (a <= b) extra.emplace_back(a ^ 0x20, b ^ 0x20);
+    }
+  }
+  r.insert(r.end(), extra.begin(), extra.end());
+  normalize(r);
+}
+
+Ranges complement(const Ranges& r) {
+  Ranges out;
+  std::uint32_t next = 0;
+  for (auto [lo, hi] : r) {
+    if (lo > next) out.emplace_back(next, lo - 1);
+    next = hi + 1;
+  }
+  if (next <= kMaxCodepoint) out.emplace_back(next, kMaxCodepoint);
+  return out;
+}
+
+// \d \w \s 及其大写（取反）形式，ASCII 语义
+Ranges perl_class(char e) {
+  Ranges r;
+  switch (e | 0x20) {
+    case 'd':
+      r = {{'0', '9'}};
+      break;
+    case 'w':
+      r = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}};
+      break;
+    default:  // 's'
+      r = {{'\t', '\r'}, {' ', ' '}};
+      break;
+  }
+  return (e >= 'A' && e <= 'Z') ? complement(r) : r;
+}
+
+bool posix_class(std::string_view name, Ranges& r) {
+  static const std::pair<const char*, Ranges> kClasses[] = {
+      {"alnum", {{'0', '9'}, {'A', 'Z'}, {'a', 'z'}}},
+      {"alpha", {{'A', 'Z'}, {'a', 'z'}}},
+      {"ascii", {{0, 0x7F}}},
+      {"blank", {{'\t', '\t'}, {' ', ' '}}},
+      {"cntrl", {{0, 0x1F}, {0x7F, 0x7F}}},
+      {"digit", {{'0', '9'}}},
+      {"graph", {{'!', '~'}}},
+      {"lower", {{'a', 'z'}}},
+      {"print", {{' ', '~'}}},
+      {"punct", {{'!', '/'}, {':', '@'}, {'[', '`'}, {'{', '~'}}},
+      {"space", {{'\t', '\r'}, {' ', ' '}}},
+      {"upper", {{'A', 'Z'}}},
+      {"word", {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}}},
+      {"xdigit", {{'0', '9'}, {'A', 'F'}, {'a', 'f'}}},
+  };
+  for (const auto& [n, ranges] : kClasses) {
+    if (name == n) {
+      r.insert(r.end(), ranges.begin(), ranges.end());
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string encode_utf8(std::uint32_t cp) {
+  std::string out;
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+  return out;
+}
+
+// s[pos] 开始的 UTF-8 序列的长度；不是合法序列返回 0
+std::size_t utf8_length(std::string_view s, std::size_t pos, std::uint32_t& cp) {
+  auto b = [&](std::size_t i) { return static_cast<unsigned char>(s[pos + i]); };
+  unsigned c = b(0);
+  std::size_t n = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : (c >> 3) == 30 ? 4 : 0;
+  if (n == 0 || pos + n > s.size()) return 0;
+  cp = n == 1 ? c : n == 2 ? (c & 0x1F) : n == 3 ? (c & 0x0F) : (c & 0x07);
+  for (std::size_t i = 1; i < n; i++) {
+    if ((b(i) & 0xC0) != 0x80) return 0;
+    cp = (cp << 6) | (b(i) & 0x3F);
+  }
+  static const std::uint32_t kMin[] = {0, 0, 0x80, 0x800, 0x10000};
+  if (cp < kMin[n] || cp > kMaxCodepoint || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+  return n;
+}
+
+Node bytes_node(unsigned lo, unsigned hi) {
+  Node n;
+  n.kind = Node::Bytes;
+  for (unsigned c = lo; c <= hi; c++) n.bytes.set(c);
+  return n;
+}
+
+Node literal_node(std::string_view bytes) {
+  if (bytes.size() == 1) return bytes_node(static_cast<unsigned char>(bytes[0]), static_cast<unsigned char>(bytes[0]));
+  Node n;
+  n.kind = Node::Concat;
+  for (char c : bytes) n.children.push_back(literal_node(std::string_view(&c, 1)));
+  return n;
+}
+
+// 码点区间 -> 若干个 UTF-8 字节范围序列：先按编码长度切开，再切到每个续字节都是完整的 0x80~0xBF
+// 或者前面的字节都相同为止，这时每个位置的字节各自是一个范围
+Node class_node(const Ranges& ranges) {
+  Node ascii = bytes_node(1, 0);  // 空集合
+  Node alt;
+  alt.kind = Node::Alternate;
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> stack;
+  for (auto [lo, hi] : ranges) {
+    // 代理区不是合法的 UTF-8
+    if (lo <= 0xDFFF && hi >= 0xD800) {
+      if (hi > 0xDFFF) stack.emplace_back(0xE000, hi);
+      if (lo < 0xD800) stack.emplace_back(lo, 0xD7FF);
+    } else {
+      stack.emplace_back(lo, hi);
+    }
+  }
+  while (!stack.empty()) {
+    auto [lo, hi] = stack.back();
+    stack.pop_back();
+    bool split = false;
+    for (std::uint32_t b : {0x7Fu, 0x7FFu, 0xFFFFu}) {
+      if (lo <= b && b < hi) {
+        stack.emplace_back(lo, b);
+        stack.emplace_back(b + 1, hi);
+        split = true;
+        break;
+      }
+    }
+    if (split) continue;
+    if (hi < 0x80) {
+      for (std::uint32_t c = lo; c <= hi; c++) ascii.bytes.set(c);
+      continue;
+    }
+    for (int i = 1; i < 4 && !split; i++) {
+      std::uint32_t m = (1u << (6 * i)) - 1;
+      if ((lo & ~m) == (hi & ~m)) continue;
+      if ((lo & m) != 0) {
+        stack.emplace_back(lo, lo | m);
+        stack.emplace_back((lo | m) + 1, hi);
+        split = true;
+      } else if ((hi & m) != m) {
+        stack.emplace_back(lo, (hi & ~m) - 1);
+        stack.emplace_back(hi & ~m, hi);
+        split = true;
+      }
+    }
+    if (split) continue;
+    std::string a = encode_utf8(lo), b = encode_utf8(hi);
+    Node seq;
+    seq.kind = Node::Concat;
+    for (std::size_t i = 0; i < a.size(); i++) {
+      seq.children.push_back(bytes_node(static_cast<unsigned char>(a[i]), static_cast<unsigned char>(b[i])));
+    }
+    alt.children.push_back(std::move(seq));
+  }
+  if (alt.children.empty()) return ascii;
+  if (ascii.bytes.any()) alt.children.push_back(std::move(ascii));
+  if (alt.children.size() == 1) return std::move(alt.children[0]);
+  return alt;
+}
+
+class Parser {
+ public:
+  // fold：整个模式大小写不敏感（相当于开头写了 (?i)）
+  Parser(std::string_view pattern, bool fold) : p_(pattern), fold_(fold) {}
+
+  bool parse(Node& out, std::string& err) {
+    bool ok = parse_alternate(out, 0);
+    if (ok && pos_ < p_.size()) ok = fail("unmatched )");
+    if (!ok) err = err_;
+    return ok;
+  }
+
+  // 模式里有没有写出来的 ASCII 大写字母（字面字符、字符类里的字符；\W \S 这类转义不算）。smart-case 用
+  bool saw_upper() const { return saw_upper_; }
+
+ private:
+  bool fail(const std::string& message) {
+    if (err_.empty()) err_ = message + " at offset " + std::to_string(pos_);
+    return false;
+  }
+  bool at_end() const { return pos_ >= p_.size(); }
+  bool eat(char c) {
+    if (at_end() || p_[pos_] != c) return false;
+    pos_++;
+    return true;
+  }
+
+  // 一个字面字符；(?i) 时 ASCII 字母同时匹配大小写
+  Node literal(std::string_view bytes) {
+    Node n = literal_node(bytes);
+    auto c = static_cast<unsigned char>(bytes[0]);
+    if (bytes.size() == 1 && static_cast<unsigned>((c | 0x20) - 'a') < 26u) {
+      if (c <= 'Z') saw_upper_ = true;
+      if (fold_) n.bytes.set(c ^ 0x20);
+    }
+    return n;
+  }
+
+  // (?flags) / (?flags:...) 里的 flags：i 是大小写不敏感，-i 关掉；m / s 照收（逐行匹配，
+  // ^ $ 本来就是行首行尾，. 也碰不到换行）。不是这个格式时不动 pos_，返回 false
+  bool parse_flags() {
+    std::size_t begin = pos_;
+    bool negate = false, fold = fold_;
+    for (; !at_end(); pos_++) {
+      char c = p_[pos_];
+      if (c == '-' && !negate) {
+        negate = true;
+      } else if (c == 'i') {
+        fold = !negate;
+      } else if (c != 'm' && c != 's') {
+        break;
+      }
+    }
+    if (pos_ == begin || at_end() || (p_[pos_] != ')' && p_[pos_] != ':')) {
+      pos_ = begin;
+      return false;
+    }
+    fold_ = fold;
+    return true;
+  }
+
+  bool parse_alternate(Node& out, int depth) {
+    if (depth > kMaxDepth) return fail("nesting too deep");
+    if (!parse_concat(out, depth)) return false;
+    if (at_end() || p_[pos_] != '|') return true;
+    Node alt;
+    alt.kind = Node::Alternate;
+    alt.children.push_back(std::move(out));
+    while (eat('|')) {
+      Node next;
+      if (!parse_concat(next, depth)) return false;
+      alt.children.push_back(std::move(next));
+    }
+    out = std::move(alt);
+    return true;
+  }
+
+  bool parse_concat(Node& out, int depth) {
+    Node seq;
+    seq.kind = Node::Concat;
+    while (!at_end() && p_[pos_] != '|' && p_[pos_] != ')') {
+      Node atom;
+      if (!parse_atom(atom, depth) || !parse_quantifier(atom)) return false;
+      seq.children.push_back(std::move(atom));
+    }
+    if (seq.children.empty()) {
+      out = Node();
+    } else if (seq.children.size() == 1) {
+      out = std::move(seq.children[0]);
+    } else {
+      out = std::move(seq);
+    }
+    return true;
+  }
+
+  // {m} {m,} {m,n}；不是这个格式时不动 pos_，返回 false（'{' 当普通字符）
+  bool parse_counts(int& min, int& max) {
+    std::size_t p = pos_ + 1;
+    auto number = [&](int& v) {
+      std::size_t begin = p;
+      long long n = 0;
+      while (p < p_.size() && p_[p] >= '0' && p_[p] <= '9') {
+        n = std::min<long long>(n * 10 + (p_[p] - '0'), kMaxRepeat + 1);
+        p++;
+      }
+      v = static_cast<int>(n);
+      return p > begin;
+    };
+    if (!number(min)) return false;
+    max = min;
+    if (p < p_.size() && p_[p] == ',') {
+      p++;
+      if (!number(max)) max = -1;
+    }
+    if (p >= p_.size() || p_[p] != '}') return false;
+    pos_ = p + 1;
+    return true;
+  }
+
+  bool parse_quantifier(Node& atom) {
+    if (at_end()) return true;
+    int min = 0, max = -1;
+    char c = p_[pos_];
+    if (c == '*') {
+      pos_++;
+    } else if (c == '+') {
+      min = 1;
+      pos_++;
+    } else if (c == '?') {
+      max = 1;
+      pos_++;
+    } else if (c != '{' || !parse_counts(min, max)) {
+      return true;
+    }
+    if (min > kMaxRepeat || max > kMaxRepeat) return fail("repeat count too large (max 1000)");
+    if (max >= 0 && min > max) return fail("invalid repeat count");
+    eat('?');  // 懒惰：只问有没有匹配，结果一样
+    if (!at_end() && (p_[pos_] == '*' || p_[pos_] == '+' || p_[pos_] == '?' ||
+                      (p_[pos_] == '{' && pos_ + 1 < p_.size() && p_[pos_ + 1] >= '0' &&
+                       p_[pos_ + 1] <= '9'))) {
+      return fail("nested repetition operator");
+    }
+    Node rep;
+    rep.kind = Node::Repeat;
+    rep.min = min;
+    rep.max = max;
+    rep.children.push_back(std::move(atom));
+    atom = std::move(rep);
+    return true;
+  }
+
+  bool parse_group(Node& out, int depth) {
+    pos_++;  // '('
+    const bool fold = fold_;  // 组里的 (?i) 只管到组结束
+    if (eat('?')) {
+      if (eat(':')) {
+      } else if (p_.substr(pos_, 2) == "P<" ||
+                 (pos_ + 1 < p_.size() && p_[pos_] == '<' && p_[pos_ + 1] != '=' && p_[pos_ + 1] != '!')) {
+        pos_ += p_[pos_] == 'P' ? 2 : 1;
+        std::size_t begin = pos_;
+        while (!at_end() && is_word_byte(static_cast<unsigned char>(p_[pos_]))) pos_++;
+        if (pos_ == begin || !eat('>')) return fail("invalid group name");
+      } else if (!at_end() && (p_[pos_] == '=' || p_[pos_] == '!' || p_[pos_] == '<')) {
+        return fail("lookaround assertions are not supported");
+      } else if (parse_flags()) {
+        if (eat(')')) return true;  // (?i)：对所在的组剩下的部分生效，本身什么都不匹配
+        pos_++;                     // ':'
+      } else {
+        return fail("unsupported group syntax");
+      }
+    }
+    if (!parse_alternate(out, depth + 1)) return false;
+    if (!eat(')')) return fail("missing )");
+    fold_ = fold;
+    return true;
+  }
+
+  // 反斜杠后面表示单个码点的转义（pos_ 已经越过 e）
+  bool escaped_codepoint(char e, std::uint32_t& cp) {
+    auto hex = [](char h) -> int {
+      if (h >= '0' && h <= '9') return h - '0';
+      if ((h | 0x20) >= 'a' && (h | 0x20) <= 'f') return (h | 0x20) - 'a' + 10;
+      return -1;
+    };
+    switch (e) {
+      case 'n': cp = '\n'; return true;
+      case 't': cp = '\t'; return true;
+      case 'r': cp = '\r'; return true;
+      case 'f': cp = '\f'; return true;
+      case 'v': cp = '\v'; return true;
+      case 'a': cp = '\a'; return true;
+      case 'e': cp = 0x1B; return true;
+      case '0': cp = 0; return true;
+      case 'x': {
+        cp = 0;
+        if (eat('{')) {
+          std::size_t digits = 0;
+          while (!at_end() && hex(p_[pos_]) >= 0 && cp <= kMaxCodepoint) {
+            cp = cp * 16 + static_cast<std::uint32_t>(hex(p_[pos_++]));
+            digits++;
+          }
+          if (digits == 0 || cp > kMaxCodepoint || !eat('}')) return fail("invalid \\x{...} escape");
+          return true;
+        }
+        for (int i = 0; i < 2; i++) {
+          if (at_end() || hex(p_[pos_]) < 0) return fail("invalid \\x escape");
+          cp = cp * 16 + static_cast<std::uint32_t>(hex(p_[pos_++]));
+        }
+        return true;
+      }
+      default:
+        break;
+    }
+    auto u = static_cast<unsigned char>(e);
+    if (e >= '1' && e <= '9') return fail("backreferences are not supported");
+    if (u >= 0x80) {
+      pos_--;
+      std::size_t n = utf8_length(p_, pos_, cp);
+      if (n == 0) return fail("invalid UTF-8");
+      pos_ += n;
+      return true;
+    }
+    if (is_word_byte(u)) return fail(std::string("unknown escape \\") + e);
+    cp = u;  // 标点、空格：转义后就是它本身
+    return true;
+  }
+
+  // 字符类里的一个字符（可能是转义），pos_ 越过它
+  bool class_codepoint(std::uint32_t& cp) {
+    if (eat('\\')) {
+      if (at_end()) return fail("trailing backslash");
+      char e = p_[pos_++];
+      if (e == 'b') {
+        cp = '\b';
+        return true;
+      }
+      return escaped_codepoint(e, cp);
+    }
+    std::size_t n = utf8_length(p_, pos_, cp);
+    if (n == 0) return fail("invalid UTF-8");
+    pos_ += n;
+    return true;
+  }
+
+  bool parse_class(Node& out) {
+    pos_++;  // '['
+    bool negate = eat('^');
+    Ranges ranges;
+    for (bool first = true;; first = false) {
+      if (at_end()) return fail("missing ]");
+      char c = p_[pos_];
+      if (c == ']' && !first) {
+        pos_++;
+        break;
+      }
+      if (c == '[' && p_.substr(pos_, 2) == "[:") {
+        std::size_t close = p_.find(":]", pos_ + 2);
+        if (close != std::string_view::npos) {
+          std::string_view name = p_.substr(pos_ + 2, close - pos_ - 2);
+          bool negated = !name.empty() && name[0] == '^';
+          if (negated) name.remove_prefix(1);
+          Ranges r;
+          if (!posix_class(name, r)) return fail("unknown POSIX class");
+          normalize(r);
+          if (negated) r = complement(r);
+          ranges.insert(ranges.end(), r.begin(), r.end());
+          pos_ = close + 2;
+          continue;
+        }
+      }
+      if (c == '\\' && pos_ + 1 < p_.size() && p_[pos_ + 1] != '\0' &&
+          std::strchr("dDwWsS", p_[pos_ + 1]) != nullptr) {
+        Ranges r = perl_class(p_[pos_ + 1]);
+        ranges.insert(ranges.end(), r.begin(), r.end());
+        pos_ += 2;
+        continue;
+      }
+      std::uint32_t lo = 0, hi = 0;
+      if (!class_codepoint(lo)) return false;
+      hi = lo;
+      if (pos_ + 1 < p_.size() && p_[pos_] == '-' && p_[pos_ + 1] != ']') {
+        pos_++;
+        if (!class_codepoint(hi)) return false;
+        if (hi < lo) return fail("invalid character class range");
+      }
+      if (lo <= 'Z' && hi >= 'A') saw_upper_ = true;
+      ranges.emplace_back(lo, hi);
+    }
+    normalize(ranges);
+    if (fold_) fold_ranges(ranges);  // 先折叠再取反：(?i)[^a] 既不匹配 a 也不匹配 A
+    out = class_node(negate ? complement(ranges) : ranges);
+    return true;
+  }
+
+  bool parse_atom(Node& out, int depth) {
+    char c = p_[pos_];
+    switch (c) {
+      case '(':
+        return parse_group(out, depth);
+      case '[':
+        return parse_class(out);
+      case '*':
+      case '+':
+      case '?':
+        return fail("missing argument to repetition operator");
+      case '.':
+        pos_++;
+        out = class_node({{0, kMaxCodepoint}});
+        return true;
+      case '^':
+      case '$':
+        pos_++;
+        out.kind = Node::Assert;
+        out.assert_kind = c == '^' ? kLineStart : kLineEnd;
+        return true;
+      case '\\': {
+        pos_++;
+        if (at_end()) return fail("trailing backslash");
+        char e = p_[pos_++];
+        switch (e) {
+          case 'b':
+          case 'B':
+          case 'A':
+          case 'z':
+          case 'Z':
+            out.kind = Node::Assert;
+            out.assert_kind = e == 'b'   ? kWordBoundary
+                              : e == 'B' ? kNotWordBoundary
+                              : e == 'A' ? kLineStart
+                                         : kLineEnd;
+            return true;
+          case 'd':
+          case 'D':
+          case 'w':
+          case 'W':
+          case 's':
+          case 'S': {
+            Ranges r = perl_class(e);
+            normalize(r);
+            out = class_node(r);
+            return true;
+          }
+          case 'p':
+          case 'P':
+            return fail("unicode classes are not supported");
+          default:
+            break;
+        }
+        std::uint32_t cp = 0;
+        if (!escaped_codepoint(e, cp)) return false;
+        out = literal(encode_utf8(cp));
+        return true;
+      }
+      default:
+        break;
+    }
+    // 普通字符：整个 UTF-8 序列是一个原子（后面的量词作用于整个字符）；不合法的字节按单字节处理
+    std::uint32_t cp = 0;
+    std::size_t n = std::max<std::size_t>(utf8_length(p_, pos_, cp), 1);
+    out = literal(p_.substr(pos_, n));
+    pos_ += n;
+    return true;
+  }
+
+  std::string_view p_;
+  std::size_t pos_ = 0;
+  std::string err_;
+  bool fold_ = false;
+  bool saw_upper_ = false;
+};
+
+// 每个匹配都必须包含的字面串。exact：这个节点只能匹配 str 这一个串。
+// 大小写成对的字节（(?i) 的字母）按小写算，并把 folded 置上：这时字面串要按大小写不敏感去找
+struct Literals {
+  bool exact = false;
+  std::string str;
+  std::vector<std::string> required;
+};
+
+Literals literals_of(const Node& n, bool& folded) {
+  Literals out;
+  switch (n.kind) {
+    case Node::Empty:
+    case Node::Assert:
+      out.exact = true;  // 零宽：不打断前后的字面串
+      break;
+    case Node::Bytes:
+      if (n.bytes.count() == 1) {
+        out.exact = true;
+        for (unsigned c = 0; c < 256; c++) {
+          if (n.bytes.test(c)) out.str = std::string(1, static_cast<char>(c));
+        }
+      } else if (n.bytes.count() == 2) {
+        for (unsigned c = 'a'; c <= 'z' && !out.exact; c++) {
+          out.exact = n.bytes.test(c) && n.bytes.test(c ^ 0x20);
+          if (out.exact) out.str = std::string(1, static_cast<char>(c));
+        }
+        folded = folded || out.exact;
+      }
+      break;
+    case Node::Concat: {
+      out.exact = true;
+      std::string run;
+      auto flush = [&] {
+        if (!run.empty()) out.required.push_back(std::move(run));
+        run.clear();
+      };
+      for (const Node& child : n.children) {
+        Literals c = literals_of(child, folded);
+        if (c.exact && run.size() + c.str.size() <= kMaxLiteral) {
+          run += c.str;
+          continue;
+        }
+        out.exact = false;
+        flush();
+        if (c.exact) {
+          run = std::move(c.str);
+        } else {
+          for (auto& s : c.required) out.required.push_back(std::move(s));
+        }
+      }
+      if (out.exact) {
+        out.str = std::move(run);
+      } else {
+        flush();
+      }
+      break;
+    }
+    case Node::Alternate: {
+      // 各分支只能匹配同一个串时才有字面串（比如 (?:a|a)）；一般情况下不提取
+      Literals first = literals_of(n.children[0], folded);
+      out.exact = first.exact;
+      for (std::size_t i = 1; i < n.children.size() && out.exact; i++) {
+        Literals c = literals_of(n.children[i], folded);
+        out.exact = c.exact && c.str == first.str;
+      }
+      if (out.exact) out.str = std::move(first.str);
+      break;
+    }
+    case Node::Repeat: {
+      if (n.min == 0) break;
+      Literals c = literals_of(n.children[0], folded);
+      if (c.exact && n.min == n.max && c.str.size() * static_cast<std::size_t>(n.min) <= kMaxLiteral) {
+        out.exact = true;
+        for (int i = 0; i < n.min; i++) out.str += c.str;
+      } else if (c.exact) {
+        if (!c.str.empty()) out.required.push_back(std::move(c.str));
+      } else {
+        out.required = std::move(c.required);
+      }
+      break;
+    }
+  }
+  return out;
+}
+
+std::size_t min_length_of(const Node& n) {
+  switch (n.kind) {
+    case Node::Empty:
+    case Node::Assert:
+      return 0;
+    case Node::Bytes:
+      return 1;
+    case Node::Concat: {
+      std::size_t total = 0;
+      for (const Node& c : n.children) total = std::min(total + min_length_of(c), kInfiniteLength);
+      return total;
+    }
+    case Node::Alternate: {
+      std::size_t best = kInfiniteLength;
+      for (const Node& c : n.children) best = std::min(best, min_length_of(c));
+      return best;
+    }
+    case Node::Repeat:
+      return std::min(min_length_of(n.children[0]) * static_cast<std::size_t>(n.min), kInfiniteLength);
+  }
+  return 0;
+}
+
+}  // namespace
+
+// 语法树 -> Thompson NFA。片段的出口（holes）是还没填的 out / out1：编号 * 2 + (0: out, 1: out1)
+class RegexCompiler {
+ public:
+  explicit RegexCompiler(LineRegex& re) : re_(re) {}
+
+  bool compile(const Node& root) {
+    Frag f = fragment(root);
+    std::uint32_t match = emit(LineRegex::Op::Match);
+    patch(f.holes, match);
+    re_.start_ = f.start;
+    return !too_big_;
+  }
+
+ private:
+  using Op = LineRegex::Op;
+  using AssertKind = LineRegex::AssertKind;
+  static_assert(static_cast<int>(AssertKind::LineStart) == kLineStart &&
+                static_cast<int>(AssertKind::LineEnd) == kLineEnd &&
+                static_cast<int>(AssertKind::WordBoundary) == kWordBoundary &&
+                static_cast<int>(AssertKind::NotWordBoundary) == kNotWordBoundary);
+
+  struct Frag {
+    std::uint32_t start = 0;
+    std::vector<std::uint32_t> holes;
+  };
+
+  std::uint32_t emit(Op op) {
+    if (re_.prog_.size() >= kMaxInsts) too_big_ = true;
+    LineRegex::Inst inst;
+    inst.op = op;
+    re_.prog_.push_back(inst);
+    return static_cast<std::uint32_t>(re_.prog_.size() - 1);
+  }
+
+  void patch(const std::vector<std::uint32_t>& holes, std::uint32_t target) {
+    for (std::uint32_t h : holes) {
+      LineRegex::Inst& inst = re_.prog_[h >> 1];
+      ((h & 1) != 0 ? inst.out1 : inst.out) = target;
+    }
+  }
+
+  Frag single(Op op) {
+    std::uint32_t i = emit(op);
+    return Frag{i, {i * 2}};
+  }
+
+  // 把 next 接在 acc 后面（acc 为空时直接换成 next）
+  void append(std::optional<Frag>& acc, Frag next) {
+    if (!acc) {
+      acc = std::move(next);
+      return;
+    }
+    patch(acc->holes, next.start);
+    acc->holes = std::move(next.holes);
+  }
+
+  Frag fragment(const Node& n) {
+    if (too_big_) return single(Op::Nop);
+    switch (n.kind) {
+      case Node::Empty:
+        return single(Op::Nop);
+      case Node::Bytes: {
+        Frag f = single(Op::Byte);
+        re_.prog_[f.start].set = static_cast<std::uint32_t>(re_.sets_.size());
+        re_.sets_.push_back(n.bytes);
+        return f;
+      }
+      case Node::Assert: {
+        Frag f = single(Op::Assert);
+        auto kind = static_cast<AssertKind>(n.assert_kind);
+        re_.prog_[f.start].assert_kind = kind;
+        if (kind == AssertKind::WordBoundary || kind == AssertKind::NotWordBoundary) {
+          re_.uses_word_ = true;
+        }
+        return f;
+      }
+      case Node::Concat: {
+        std::optional<Frag> acc;
+        for (const Node& c : n.children) append(acc, fragment(c));
+        return acc ? std::move(*acc) : single(Op::Nop);
+      }
+      case Node::Alternate: {
+        Frag acc = fragment(n.children.back());
+        for (std::size_t i = n.children.size() - 1; i-- > 0;) {
+          Frag f = fragment(n.children[i]);
+          std::uint32_t s = emit(Op::Split);
+          re_.prog_[s].out = f.start;
+          re_.prog_[s].out1 = acc.start;
+          f.holes.insert(f.holes.end(), acc.holes.begin(), acc.holes.end());
+          acc = Frag{s, std::move(f.holes)};
+        }
+        return acc;
+      }
+      case Node::Repeat:
+        return repeat(n);
+    }
+    return single(Op::Nop);
+  }
+
+  Frag repeat(const Node& n) {
+    const Node& child = n.children[0];
+    std::optional<Frag> acc;
+    int mandatory = n.max < 0 ? std::max(n.min - 1, 0) : n.min;
+    for (int i = 0; i < mandatory && !too_big_; i++) append(acc, fragment(child));
+    if (n.max < 0) {
+      // x* 或者 x+（min>=1 时最后一份必选的 x 带回边）
+      std::uint32_t s = emit(Op::Split);
+      Frag body = fragment(child);
+      re_.prog_[s].out = body.start;
+      patch(body.holes, s);
+      if (n.min == 0) {
+        append(acc, Frag{s, {s * 2 + 1}});
+      } else {
+        append(acc, Frag{body.start, {s * 2 + 1}});
+      }
+      return std::move(*acc);
+    }
+    // x{m,n}：m 份必选，后面 n-m 份可选的嵌套成 (x(x(x)?)?)?
+    std::vector<std::uint32_t> exits;
+    for (int i = n.min; i < n.max && !too_big_; i++) {
+      std::uint32_t s = emit(Op::Split);
+      Frag body = fragment(child);
+      re_.prog_[s].out = body.start;
+      exits.push_back(s * 2 + 1);
+      append(acc, Frag{s, std::move(body.holes)});
+    }
+    if (!acc) return single(Op::Nop);  // x{0}
+    acc->holes.insert(acc->holes.end(), exits.begin(), exits.end());
+    return std::move(*acc);
+  }
+
+  LineRegex& re_;
+  bool too_big_ = false;
+};
+
+std::shared_ptr<const LineRegex> LineRegex::compile(std::string_view pattern, std::string& err,
+                                                    const RegexOptions& options) {
+  Node root;
+  Parser parser(pattern, options.ignore_case);
+  if (!parser.parse(root, err)) return nullptr;
+  if (options.smart_case && !options.ignore_case && !parser.saw_upper()) {
+    Parser folded(pattern, true);  // 语法第一遍已经检查过了
+    root = Node();
+    folded.parse(root, err);
+  }
+  if (options.whole_word) {
+    // (?:^|[^0-9A-Za-z_]) (?:pattern) (?:$|[^0-9A-Za-z_])：和 SubstringFinder 的整词一样，
+    // 不管模式两头是不是单词字符
+    auto edge = [](int assert_kind) {
+      Node at;
+      at.kind = Node::Assert;
+      at.assert_kind = assert_kind;
+      Node other = bytes_node(0, 255);
+      for (unsigned c = 0; c < 256; c++) {
+        if (is_word_byte(c)) other.bytes.reset(c);
+      }
+      Node alt;
+      alt.kind = Node::Alternate;
+      alt.children.push_back(std::move(at));
+      alt.children.push_back(std::move(other));
+      return alt;
+    };
+    Node seq;
+    seq.kind = Node::Concat;
+    seq.children.push_back(edge(kLineStart));
+    seq.children.push_back(std::move(root));
+    seq.children.push_back(edge(kLineEnd));
+    root = std::move(seq);
+  }
+
+  std::shared_ptr<LineRegex> re(new LineRegex());
+  re->pattern_ = std::string(pattern);
+  if (!RegexCompiler(*re).compile(root)) {
+    err = "pattern too large";
+    return nullptr;
+  }
+
+  // 从起点出发、不经过 ^ 能不能走到字节或终态：走不到就是整个模式都锚在行首
+  std::vector<char> seen(re->prog_.size(), 0);
+  std::vector<std::uint32_t> stack{re->start_};
+  re->anchored_ = true;
+  while (!stack.empty() && re->anchored_) {
+    std::uint32_t i = stack.back();
+    stack.pop_back();
+    if (seen[i]) continue;
+    seen[i] = 1;
+    const Inst& inst = re->prog_[i];
+    switch (inst.op) {
+      case Op::Byte:
+      case Op::Match:
+        re->anchored_ = false;
+        break;
+      case Op::Split:
+        stack.push_back(inst.out1);
+        stack.push_back(inst.out);
+        break;
+      case Op::Assert:
+        if (inst.assert_kind != AssertKind::LineStart) stack.push_back(inst.out);
+        break;
+      case Op::Nop:
+        stack.push_back(inst.out);
+        break;
+    }
+  }
+
+  bool folded = false;
+  Literals lits = literals_of(root, folded);
+  if (lits.exact) lits.required = {std::move(lits.str)};
+  for (auto& s : lits.required) {
+    if (folded) {
+      for (char& c : s) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + 32);
+      }
+    }
+    if (!s.empty() &&
+        std::find(re->literals_.begin(), re->literals_.end(), s) == re->literals_.end()) {
+      re->literals_.push_back(std::move(s));
+    }
+  }
+  re->min_length_ = min_length_of(root);
+  if (!re->literals_.empty()) {
+    const std::string& longest = *std::max_element(
+        re->literals_.begin(), re->literals_.end(),
+        [](const std::string& a, const std::string& b) { return a.size() < b.size(); });
+    FindOptions find;
+    find.ignore_case = folded;
+    re->prefilter_.emplace(longest, find);
+  }
+  return re;
+}
+
+LineMatcher::LineMatcher(std::shared_ptr<const LineRegex> re)
+    : re_(std::move(re)), marks_(re_->prog_.size(), 0) {}
+
+std::int32_t LineMatcher::intern(std::vector<std::uint32_t>& insts, std::uint8_t flags) {
+  key_.assign(1, static_cast<char>(flags));
+  key_.append(reinterpret_cast<const char*>(insts.data()), insts.size() * sizeof(std::uint32_t));
+  auto it = index_.find(key_);
+  if (it != index_.end()) return it->second;
+  auto id = static_cast<std::int32_t>(states_.size());
+  states_.emplace_back();
+  State& st = states_.back();
+  st.insts = insts;
+  st.flags = flags;
+  std::fill(std::begin(st.next), std::end(st.next), kUnknown);
+  index_.emplace(key_, id);
+  return id;
+}
+
+std::int32_t LineMatcher::start_state() {
+  if (start_ == kUnknown) {
+    seeds_.clear();
+    start_ = intern(seeds_, kAtLineStart);
+  }
+  return start_;
+}
+
+std::int32_t LineMatcher::transition(std::int32_t s, int c) {
+  using Op = LineRegex::Op;
+  using AssertKind = LineRegex::AssertKind;
+  const auto& prog = re_->prog_;
+  const std::uint8_t flags = states_[s].flags;
+  const bool at_start = (flags & kAtLineStart) != 0;
+  const bool prev_word = (flags & kPrevWord) != 0;
+  const bool next_word = c != kEndOfLine && is_word_byte(static_cast<unsigned>(c));
+
+  // 上一步走到的指令 + 起点（不锚定：每个位置都可以开始一个匹配），按当前位置的上下文展开 ε 边
+  if (++generation_ == 0) {
+    std::fill(marks_.begin(), marks_.end(), 0);
+    generation_ = 1;
+  }
+  stack_ = states_[s].insts;
+  stack_.push_back(re_->start_);
+  targets_.clear();
+  bool matched = false;
+  while (!stack_.empty()) {
+    std::uint32_t i = stack_.back();
+    stack_.pop_back();
+    if (marks_[i] == generation_) continue;
+    marks_[i] = generation_;
+    const LineRegex::Inst& inst = prog[i];
+    switch (inst.op) {
+      case Op::Byte:
+        if (c != kEndOfLine && re_->sets_[inst.set].test(static_cast<std::size_t>(c))) {
+          targets_.push_back(inst.out);
+        }
+        break;
+      case Op::Match:
+        matched = true;
+        break;
+      case Op::Nop:
+        stack_.push_back(inst.out);
+        break;
+      case Op::Split:
+        stack_.push_back(inst.out1);
+        stack_.push_back(inst.out);
+        break;
+      case Op::Assert: {
+        bool ok = false;
+        switch (inst.assert_kind) {
+          case AssertKind::LineStart:
+            ok = at_start;
+            break;
+          case AssertKind::LineEnd:
+            ok = c == kEndOfLine;
+            break;
+          case AssertKind::WordBoundary:
+            ok = prev_word != next_word;
+            break;
+          case AssertKind::NotWordBoundary:
+            // 两边都不是单词字符，但不能落在一个多字节 UTF-8 字符的中间
+            ok = prev_word == next_word && (c == kEndOfLine || (c & 0xC0) != 0x80);
+            break;
+        }
+        if (ok) stack_.push_back(inst.out);
+        break;
+      }
+    }
+    if (matched) break;
+  }
+
+  std::int32_t next;
+  if (matched) {
+    next = kMatch;
+  } else if (c == kEndOfLine) {
+    next = 0;  // 行尾只关心是不是 kMatch
+  } else if (targets_.empty() && re_->anchored_) {
+    next = kDead;
+  } else {
+    std::sort(targets_.begin(), targets_.end());
+    targets_.erase(std::unique(targets_.begin(), targets_.end()), targets_.end());
+    auto next_flags = static_cast<std::uint8_t>(re_->uses_word_ && next_word ? kPrevWord : 0);
+    if (states_.size() >= kMaxStates) {
+      // 缓存满了：整个清空（s 也一起作废），调用方只会用返回的新编号
+      states_.clear();
+      index_.clear();
+      start_ = kUnknown;
+      return intern(targets_, next_flags);
+    }
+    next = intern(targets_, next_flags);
+  }
+  states_[s].next[c] = next;
+  return next;
+}
+
+bool LineMatcher::matches(const char* line, std::size_t size) {
+  std::int32_t s = start_state();
+  const auto* p = reinterpret_cast<const unsigned char*>(line);
+  for (std::size_t i = 0; i < size; i++) {
+    std::int32_t t = states_[static_cast<std::size_t>(s)].next[p[i]];
+    if (t < 0) {
+      if (t == kUnknown) t = transition(s, p[i]);
+      if (t == kMatch) return true;
+      if (t == kDead) return false;
+    }
+    s = t;
+  }
+  std::int32_t t = states_[static_cast<std::size_t>(s)].next[kEndOfLine];
+  if (t == kUnknown) t = transition(s, kEndOfLine);
+  return t == kMatch;
+}
+
+bool LineMatcher::scan_lines(const char* data, std::size_t size,
+                             const std::function<bool(const LineMatch&)>& visit) {
+  // 有字面串时只看含最长字面串的行（SIMD 查找 + 按需数行号，同 text_scan.cpp）；没有就逐行跑 DFA
+  if (size == 0) return true;
+  const SubstringFinder* finder = re_->prefilter_ ? &*re_->prefilter_ : nullptr;
+  const SimdLevel level = simd_level();
+  std::size_t cursor = 0;  // 总是某一行的行首；它之前的行都处理完了
+  std::size_t line = 1;    // cursor 所在的行号
+  while (true) {
+    std::size_t begin = cursor, pos = cursor;
+    if (finder != nullptr) {
+      pos = finder->find(data, size, cursor);
+      if (pos == std::string_view::npos) return true;
+      begin = pos;
+      while (begin > cursor && data[begin - 1] != '\n') begin--;
+      line += count_newlines(data + cursor, begin - cursor, level);
+    }
+    const void* nl = std::memchr(data + pos, '\n', size - pos);
+    std::size_t end = nl != nullptr ? static_cast<std::size_t>(static_cast<const char*>(nl) - data)
+                                    : size;
+    if (matches(data + begin, end - begin)) {
+      LineMatch m;
+      m.line = line;
+      m.text = std::string_view(data + begin, end - begin);
+      if (!visit(m)) return false;
+    }
+    if (end == size) return true;
+    cursor = end + 1;
+    line++;
+  }
+}
+
+}  // namespace engine
@@ -0,0 +1,127 @@
+/*
+  engine/src/line_regex.h：search-text --regex 用的正则引擎（逐行判断，线性时间）
+
+  树里原来只有 std::regex：回溯实现，慢，而且 (a*)*b 这类模式会指数爆炸。这里自己实现：
+  - 语法是 RE2 / PCRE 的常用子集，按 UTF-8 处理：字面字符和转义（\n \t \x41 \x{4e2d} \. ...）、
+    . 、[...] 字符类（范围、取反、\d \w \s、[:alpha:] 等）、(...) (?:...) (?P<name>...) (?<name>...)、
+    |、* + ? {m} {m,} {m,n}（后面的 ? 懒惰标记照收，不影响“有没有匹配”）、^ $（行首 / 行尾）、
+    \A \z、\b \B（单词字符是 ASCII 的 [0-9A-Za-z_]，\B 不会落在多字节字符中间）、
+    (?i) (?-i) (?i:...)（只折叠 ASCII 字母）。反向引用、环视这类没法线性匹配的语法直接报错
+  - RegexOptions：整个模式大小写不敏感 / smart-case / 整词，对应 search-text 的
+    --ignore-case / --smart-case / --word。大小写折叠在编译时展开成字节集合，匹配时没有额外开销
+  - 编译成 Thompson NFA；匹配时按需把 NFA 状态集合构造成 DFA 状态（惰性 DFA），之后每个字节一次查表。
+    DFA 状态缓存超过上限就整个清空重来：最坏退化到逐字节做 NFA 模拟，仍然是线性的，不会回溯
+  - 只回答“这一行里有没有匹配”：不记捕获组，第一次到达终态就停
+  - 从模式里提取“任何匹配都必须包含的字面串”（required_literals）。search-text 先用 SubstringFinder
+    找其中最长的一个，只有含它的行才跑 DFA；三元组索引（trigram_index.h）用全部字面串排除文件。
+    例如 '(\w+)' is not a member of 'std' 的字面串是 "'" 和 "' is not a member of 'std'"
+
+  LineRegex 编译好以后只读，可以在线程间共享；DFA 缓存在 LineMatcher 里，每个线程一个。
+*/
+
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "text_scan.h"
+
+namespace engine {
+
+struct RegexOptions {
+  bool ignore_case = false;  // 同开头写 (?i)
+  bool smart_case = false;   // 模式里没写大写字母时大小写不敏感（\W \S 这类转义不算大写）
+  bool whole_word = false;   // 匹配前后都不能紧挨着单词字符（同 grep -w）
+};
+
+class LineRegex {
+ public:
+  // 模式不合法（或者展开后太大）时返回 nullptr，err 是原因（带出错的字节位置）
+  static std::shared_ptr<const LineRegex> compile(std::string_view pattern, std::string& err,
+                                                  const RegexOptions& options = {});
+
+  const std::string& pattern() const { return pattern_; }
+  // 每个匹配都包含的字面串（可能为空：比如 \w+）。有 (?i) 的部分时已转成小写，预筛按大小写不敏感找
+  const std::vector<std::string>& required_literals() const { return literals_; }
+  // 最短的匹配有多少字节（search-text 用它估计能拿到的最高分）
+  std::size_t min_length() const { return min_length_; }
+
+ private:
+  friend class LineMatcher;
+  friend class RegexCompiler;
+
+  enum class Op : std::uint8_t { Byte, Split, Nop, Assert, Match };
+  enum class AssertKind : std::uint8_t { LineStart, LineEnd, WordBoundary, NotWordBoundary };
+  struct Inst {
+    Op op = Op::Nop;
+    AssertKind assert_kind = AssertKind::LineStart;  // Assert
+    std::uint32_t out = 0;
+    std::uint32_t out1 = 0;  // Split 的第二个分支
+    std::uint32_t set = 0;   // Byte：在 sets_ 里的编号
+  };
+
+  LineRegex() = default;
+
+  std::string pattern_;
+  std::vector<Inst> prog_;
+  std::vector<std::bitset<256>> sets_;
+  std::uint32_t start_ = 0;
+  bool uses_word_ = false;  // 有 \b / \B：DFA 状态要记前一个字节是不是单词字符
+  bool anchored_ = false;   // 每条路径都以 ^ 开头：行中间断掉以后就不可能再匹配
+  std::vector<std::string> literals_;
+  std::size_t min_length_ = 0;
+  std::optional<SubstringFinder> prefilter_;  // 最长的字面串
+};
+
+class LineMatcher {
+ public:
+  explicit LineMatcher(std::shared_ptr<const LineRegex> re);
+
+  // line 里（不含 '\n'）有没有匹配
+  bool matches(const char* line, std::size_t size);
+
+  // 同 text_scan.h 的 scan_lines：按顺序回调 data 里每个有匹配的行，visit 返回 false 时停下
+  bool scan_lines(const char* data, std::size_t size,
+                  const std::function<bool(const LineMatch&)>& visit);
+
+ private:
+  static constexpr std::int32_t kUnknown = -1;
+  static constexpr std::int32_t kMatch = -2;
+  static constexpr std::int32_t kDead = -3;
+  static constexpr std::size_t kMaxStates = 2048;  // 每个状态 1 KiB 多一点的转移表
+  static constexpr int kEndOfLine = 256;
+
+  struct State {
+    std::vector<std::uint32_t> insts;  // 上一个字节走到的 NFA 指令（还没展开 ε 边）
+    std::uint8_t flags = 0;            // kAtLineStart | kPrevWord
+    std::int32_t next[257];            // 按字节转移；[256] 是行尾：kMatch 或其它
+  };
+  static constexpr std::uint8_t kAtLineStart = 1;
+  static constexpr std::uint8_t kPrevWord = 2;
+
+  std::int32_t start_state();
+  std::int32_t transition(std::int32_t s, int c);
+  std::int32_t intern(std::vector<std::uint32_t>& insts, std::uint8_t flags);
+
+  std::shared_ptr<const LineRegex> re_;
+  std::vector<State> states_;
+  std::unordered_map<std::string, std::int32_t> index_;
+  std::int32_t start_ = kUnknown;
+  // 展开 ε 边用的临时空间
+  std::vector<std::uint32_t> stack_;
+  std::vector<std::uint32_t> marks_;
+  std::uint32_t generation_ = 0;
+  std::vector<std::uint32_t> seeds_;
+  std::vector<std::uint32_t> targets_;
+  std::string key_;
+};
+
+}  // namespace engine
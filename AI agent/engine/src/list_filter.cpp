@@ -0,0 +1,175 @@
+/*
+  engine/src/list_filter.cpp：list_filter.h 的实现
+*/
+
+#include "list_filter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+#include "ignore.h"
+
+namespace engine {
+
+namespace {
+
+struct Language {
+  const char* name;
+  const char* exts;   // 逗号分隔
+  const char* names;  // 逗号分隔的特殊文件名
+};
+
+constexpr Language kLanguages[] = {
+    {"c", "c,h", ""},
+    {"cpp", "cc,cpp,cxx,c++,hh,hpp,hxx,h++,h,ipp,inl,tpp", ""},
+    {"python", "py,pyi,pyx", ""},
+    {"java", "java", ""},
+    {"kotlin", "kt,kts", ""},
+    {"go", "go", ""},
+    {"rust", "rs", ""},
+    {"javascript", "js,jsx,mjs,cjs", ""},
+    {"typescript", "ts,tsx,mts,cts", ""},
+    {"shell", "sh,bash,zsh", ""},
+    {"cmake", "cmake", "CMakeLists.txt"},
+    {"make", "mk,mak", "Makefile,makefile,GNUmakefile"},
+    {"markdown", "md,markdown", ""},
+    {"json", "json", ""},
+    {"yaml", "yml,yaml", ""},
+    {"toml", "toml", ""},
+};
+
+template <typename F>
+void for_each_item(std::string_view list, F&& f) {
+  std::size_t start = 0;
+  while (start < list.size()) {
+    std::size_t end = list.find(',', start);
+    if (end == std::string_view::npos) end = list.size();
+    if (end > start) f(list.substr(start, end - start));
+    start = end + 1;
+  }
+}
+
+std::string lower(std::string_view s) {
+  std::string out(s);
+  for (auto& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return out;
+}
+
+bool starts_with(std::string_view s, std::string_view prefix) {
+  return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+}  // namespace
+
+ListFilter::Pattern ListFilter::compile(std::string pattern) {
+  Pattern p;
+  if (!pattern.empty() && pattern[0] == '/') pattern.erase(0, 1);
+  p.has_slash = pattern.find('/') != std::string::npos;
+  if (p.has_slash) {
+    std::size_t meta = pattern.find_first_of("*?[\\");
+    std::string_view literal = std::string_view(pattern).substr(0, meta);
+    std::size_t slash = literal.rfind('/');
+    if (slash != std::string_view::npos) p.base = std::string(literal.substr(0, slash));
+  }
+  p.glob = std::move(pattern);
+  return p;
+}
+
+bool ListFilter::matches(const Pattern& p, std::string_view rel, std::string_view name) {
+  return glob_match(p.glob, p.has_slash ? rel : name);
+}
+
+void ListFilter::add_include(std::string pattern) {
+  if (!pattern.empty()) include_.push_back(compile(std::move(pattern)));
+}
+
+void ListFilter::add_exclude(std::string pattern) {
+  if (!pattern.empty()) exclude_.push_back(compile(std::move(pattern)));
+}
+
+void ListFilter::add_extension(std::string_view ext) {
+  if (!ext.empty() && ext[0] == '.') ext.remove_prefix(1);
+  if (!ext.empty()) exts_.insert(lower(ext));
+}
+
+bool ListFilter::add_language(std::string_view lang) {
+  std::string key = lower(lang);
+  for (const auto& l : kLanguages) {
+    if (key != l.name) continue;
+    for_each_item(l.exts, [this](std::string_view e) { exts_.emplace(e); });
+    for_each_item(l.names, [this](std::string_view n) { names_.emplace(n); });
+    return true;
+  }
+  return false;
+}
+
+std::string ListFilter::language_names() {
+  std::string out;
+  for (const auto& l : kLanguages) {
+    if (!out.empty()) out += ",";
+    out += l.name;
+  }
+  return out;
+}
+
+bool ListFilter::empty() const {
+  return include_.empty() && exclude_.empty() && exts_.empty() && names_.empty() &&
+         max_depth_ <= 0 && after_.empty();
+}
+
+bool ListFilter::enter_dir(std::string_view rel) const {
+  std::string_view name = rel.substr(rel.rfind('/') + 1);  // 没有 "/" 时 npos + 1 == 0
+  if (max_depth_ > 0 &&
+      std::count(rel.begin(), rel.end(), '/') + 1 >= max_depth_) {
+    return false;  // 目录里的文件深度至少是目录深度 + 1
+  }
+  if (!after_.empty()) {
+    // 子树里的路径都以 rel + "/" 开头：这个前缀比游标小、游标又不在子树里，整棵子树都在游标之前
+    std::string prefix = std::string(rel) + "/";
+    if (!starts_with(after_, prefix) && prefix < after_) return false;
+  }
+  for (const auto& p : exclude_) {
+    if (matches(p, rel, name)) return false;
+    // "gen/**" 之类：目录本身不匹配，但下面的东西全部排除
+    std::string_view g = p.glob;
+    if (g.size() > 3 && g.compare(g.size() - 3, 3, "/**") == 0 &&
+        glob_match(g.substr(0, g.size() - 3), p.has_slash ? rel : name)) {
+      return false;
+    }
+  }
+  if (include_.empty()) return true;
+  for (const auto& p : include_) {
+    // 没有固定前缀的模式（"*.cpp"、"**/test_*.py"）可能在任何目录下命中
+    if (p.base.empty()) return true;
+    // rel 在前缀之内，或者是通往前缀的祖先目录
+    if (rel == p.base || starts_with(rel, p.base + "/") ||
+        starts_with(p.base, std::string(rel) + "/")) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ListFilter::keep_file(std::string_view rel, std::string_view name) const {
+  if (max_depth_ > 0 && std::count(rel.begin(), rel.end(), '/') + 1 > max_depth_) return false;
+  if (!after_.empty() && rel <= after_) return false;
+  if (!exts_.empty() || !names_.empty()) {
+    bool hit = names_.count(std::string(name)) != 0;
+    std::size_t dot = name.rfind('.');
+    if (!hit && dot != std::string_view::npos && dot + 1 < name.size()) {
+      hit = exts_.count(lower(name.substr(dot + 1))) != 0;
+    }
+    if (!hit) return false;
+  }
+  for (const auto& p : exclude_) {
+    if (matches(p, rel, name)) return false;
+  }
+  if (include_.empty()) return true;
+  for (const auto& p : include_) {
+    if (matches(p, rel, name)) return true;
+  }
+  return false;
+}
+
+}  // namespace engine
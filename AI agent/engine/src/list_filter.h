@@ -0,0 +1,64 @@
+/*
+  engine/src/list_filter.h：list-files 的路径过滤（在遍历时生效）
+
+  原来 list-files 总是返回全部文件名，agent 再在 Python 里挑；大仓库里大部分数据白传了。
+  这里的条件只看路径，所以可以直接交给遍历器（WalkOptions::enter_dir / keep_file）：
+  - --include / --exclude GLOB：gitignore 风格的通配符（* 不跨 "/"，** 可以跨目录）；
+    不含 "/" 的模式只匹配文件名，含 "/" 的匹配相对路径。
+    exclude 命中的目录整棵剪掉；include 的模式有固定的目录前缀（如 "src/engine/" 开头的模式）时，
+    前缀之外的目录也不会进入。
+  - --ext cpp,h / --lang cpp,python：按扩展名（不区分大小写）或语言（扩展名 + 特殊文件名，如 CMakeLists.txt）
+  - --max-depth N：根目录下的文件深度是 1，只列深度 <= N 的文件，更深的目录不进入
+  - --cursor：分页游标（上一页最后一个路径），只要路径更大的文件；整棵子树都排在游标之前的目录直接跳过
+  大小 / mtime 这类要 stat 的条件在 engine_core.cpp 里对遍历结果逐个判断。
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace engine {
+
+class ListFilter {
+ public:
+  void add_include(std::string pattern);
+  void add_exclude(std::string pattern);
+  void add_extension(std::string_view ext);  // 带不带 "." 都行
+  // 语言名（cpp / python / ...）展开成扩展名和特殊文件名；不认识的语言返回 false
+  bool add_language(std::string_view lang);
+  void set_max_depth(int depth) { max_depth_ = depth; }
+  void set_after(std::string path) { after_ = std::move(path); }
+
+  // 没有任何条件：遍历器不用挂回调
+  bool empty() const;
+
+  // rel 是目录的相对路径（非根目录）
+  bool enter_dir(std::string_view rel) const;
+  // rel 是文件的相对路径，name 是最后一段
+  bool keep_file(std::string_view rel, std::string_view name) const;
+
+  // --lang 认识的语言名（usage / 错误信息用）
+  static std::string language_names();
+
+ private:
+  struct Pattern {
+    std::string glob;  // 去掉开头 "/" 之后的模式
+    bool has_slash = false;
+    std::string base;  // 第一个通配符之前的固定目录前缀（没有 "/" 或以 ** 开头时为空）
+  };
+
+  static Pattern compile(std::string pattern);
+  static bool matches(const Pattern& p, std::string_view rel, std::string_view name);
+
+  std::vector<Pattern> include_;
+  std::vector<Pattern> exclude_;
+  std::unordered_set<std::string> exts_;   // 小写，不带 "."
+  std::unordered_set<std::string> names_;  // --lang 带来的特殊文件名
+  int max_depth_ = 0;                      // 0 表示不限
+  std::string after_;
+};
+
+}  // namespace engine
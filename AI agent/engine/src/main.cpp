@@ -1,607 +1,584 @@
 /*
-  engine/src/main.cpp：C++ 核心引擎（demo 版，CLI + JSON 通信）
+  engine/src/main.cpp：engine_cli 可执行文件的入口（CLI + serve）
 
-  这个文件实现了一个最小的本地“引擎”程序 engine_cli，用来给 Python agent 调用：
-  - list-files：列出文件树（过滤常见大目录）
-  - read-file：读取文件内容（限制最大字节数，避免上下文爆炸）
-  - search-text：全文搜索（demo 版：逐文件逐行 find；后续可换索引/rg/tree-sitter）
-  - apply-edits：应用“按行替换”的编辑指令，并生成快照（snapshot）
-  - rollback：把快照内容写回去，实现回滚
+  这个程序是给 Python agent 调用的本地“引擎”，子命令的实现都在 engine_core 库里
+  （engine_core.h / engine_core.cpp），这里只负责：
+  - 命令行入口：把 argv 交给 engine::run_command_guarded 分发
+  - serve：常驻进程，按行读取 JSON 请求并分发给各个子命令（省掉每次调用的进程启动开销）；
+    加 --socket 时监听 Unix domain socket，多个客户端共享同一个线程池
 
   设计动机（答辩友好）：
   - Python 负责“编排/工作流/LLM”，C++ 负责“本地高性能/工程能力”
   - 两者用 CLI 子进程 + JSON 通信：最稳、最容易调试、跨平台也清晰
+  - 对性能敏感的调用方还可以直接 import Python 扩展模块 _engine_core（见 py_engine.cpp），
+    它和这里链接的是同一个 engine_core 库
 */
 
 #include <algorithm>
-#include <chrono>
-#include <cstdio>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
 #include <cstddef>
-#include <filesystem>
-#include <fstream>
+#include <cstring>
 #include <iostream>
-#include <optional>
-#include <regex>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
-#include <vector>
 
-namespace fs = std::filesystem; // C++17 文件系统库
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "engine_core.h"
+#include "json.h"
+#include "list_filter.h"
+#include "scheduler.h"
+#include "trigram_index.h"
+#include "watcher.h"
+
+using engine::Args;
+using engine::CancelToken;
+using engine::JsonValue;
+using engine::RecordSink;
+using engine::RecordTags;
+using engine::ResponseWriter;
+using engine::Priority;
+using engine::Scheduler;
+using engine::WireFormat;
+using engine::arg_value;
+using engine::json_escape;
+using engine::parse_json;
+using engine::request_id_value;
+using engine::request_to_args;
+using engine::run_command_guarded;
 
 static void print_usage(const char* argv0) { // 打印用法说明
   std::cerr  //
       << "Usage:\n"
-      << "  " << argv0 << " list-files --root PATH\n"
-      << "  " << argv0 << " read-file --path PATH [--max-bytes N]\n"
+      << "  " << argv0 << " list-files --root PATH [--stream | --manifest | --since TOKEN]\n"
+      << "      [--include GLOB] [--exclude GLOB] [--ext EXT] [--lang LANG] [--max-depth N]\n"
+      << "      [--min-size N] [--max-size N] [--modified-after T] [--modified-before T]\n"
+      << "      [--with-size] [--with-lines] [--limit N] [--cursor PATH]\n"
+      << "      [--git-index] [--modified] [--untracked]\n"
+      << "  " << argv0 << " read-file --path PATH [--max-bytes N] [--transport inline|shm]\n"
       << "  " << argv0
-      << " search-text --root PATH --query TEXT [--topk K] [--max-bytes N]\n"
+      << " search-text --root PATH --query TEXT [--topk K] [--max-bytes N] [--stream]\n"
+      << "      [--threads N] [--regex] [--ignore-case | --smart-case] [--word]\n"
+      << "  " << argv0 << " search-text --root PATH --queries TEXT [--queries TEXT]... [--topk K]\n"
+      << "      [--max-bytes N] [--threads N] [--ignore-case | --smart-case] [--word]\n"
+      << "  " << argv0 << " index --root PATH [--max-file-bytes N]\n"
       << "  " << argv0 << " apply-edits --root PATH --edits-json PATH\n"
       << "  " << argv0 << " rollback --root PATH --snapshot-id ID\n"
+      << "  " << argv0 << " batch --requests-json PATH [--threads N]\n"
+      << "  " << argv0 << " serve [--socket PATH] [--threads N] [--watch ROOT]... [--no-index]\n"
       << "\n"
-      << "All commands output JSON on stdout.\n";
+      << "Every command except serve also accepts --format json|cbor|msgpack (default json)\n"
+      << "and --deadline-ms N (list-files / search-text then stop early and reply with what\n"
+      << "they have plus \"partial\":true).\n"
+      << "json prints one JSON object per line; cbor/msgpack print self-delimiting binary\n"
+      << "records with raw file bytes and dictionary-encoded paths (\"dirs\" + dir/name).\n"
+      << "In serve, put \"format\" in a request's args to pick the encoding of its reply.\n"
+      << "read-file --transport shm puts the content in a read-only POSIX shared memory segment\n"
+      << "and replies {\"shm\":{\"name\",\"offset\",\"length\"}}; the caller maps it and shm_unlinks it.\n"
+      << "--stream emits NDJSON records as they are found, then a {\"type\":\"summary\"} line.\n"
+      << "search-text scans files on N threads (default, and at most: one per CPU, up to 16);\n"
+      << "results and --stream order are the same at any thread count (ties go by path, then\n"
+      << "line).\n"
+      << "search-text --regex treats the query as a regular expression (RE2-style syntax, no\n"
+      << "backreferences or lookaround) matched per line in linear time; a bad pattern replies\n"
+      << "{\"error\":\"invalid_regex\",\"message\"}.\n"
+      << "search-text --ignore-case folds ASCII case; --smart-case does so only when the query\n"
+      << "has no uppercase letter; --word requires no [0-9A-Za-z_] right before or after a match.\n"
+      << "search-text --queries (repeatable) searches several substrings in one pass over each\n"
+      << "file and replies {\"queries\":[{\"query\",\"matches\",\"results\"}, ...]}, one entry per\n"
+      << "query with the same top-k as searching it alone (--smart-case is decided per query;\n"
+      << "not combinable with --regex or --stream).\n"
+      << "list-files --manifest refreshes ROOT/.agent_index/manifest incrementally and adds a\n"
+      << "\"generation\" token; --since TOKEN replies only {added, modified, removed} since then\n"
+      << "(\"reset\":true means the token is too old or unknown and added lists every file).\n"
+      << "list-files filters run inside the walk: --include/--exclude/--ext/--lang may repeat\n"
+      << "or take comma lists (languages: " << engine::ListFilter::language_names() << "),\n"
+      << "sizes are bytes and times are Unix seconds. --with-size/--with-lines turn each file\n"
+      << "into {\"path\",\"size\",\"lines\"}; --limit N pages the sorted list and adds\n"
+      << "\"next_cursor\" when more remain (pass it back as --cursor).\n"
+      << "--git-index lists tracked files straight from ROOT/.git/index without walking;\n"
+      << "--modified lstat()s each one against the index's stat cache and adds \"modified\" and\n"
+      << "\"deleted\"; --untracked also walks the tree and merges in \"untracked\" files.\n"
+      << "serve reads one JSON request per line on stdin, e.g.\n"
+      << "  {\"id\":1,\"cmd\":\"read-file\",\"args\":{\"path\":\"a.cpp\"}}\n"
+      << "and answers each with one JSON line carrying the same id\n"
+      << "(requests may be pipelined; responses come back in completion order).\n"
+      << "{\"cmd\":\"cancel\",\"args\":{\"id\":X}} cancels in-flight request X on the same session.\n"
+      << "Requests may set \"priority\": interactive|normal|background (read-file defaults to\n"
+      << "interactive); {\"cmd\":\"stats\"} reports queue depth and wait time per class.\n"
+      << "serve --watch ROOT keeps ROOT's file tree live via inotify; list-files/search-text\n"
+      << "on that root then skip the directory walk.\n"
+      << "index builds ROOT/.agent_index/trigrams (incrementally: only new or changed files are\n"
+      << "read); search-text then opens only files whose indexed text contains every trigram of\n"
+      << "the query, and still reads files changed since. serve --watch keeps each watched\n"
+      << "root's index rebuilt in the background unless --no-index is given.\n";
 }
 
-static std::string json_escape(const std::string& s) {
-  // 把任意字符串安全地放进 JSON 字符串字段里（最小实现，只处理常见转义）
-  std::string out;
-  out.reserve(s.size() + 16);
-  for (unsigned char c : s) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        if (c < 0x20) { // 大小 32 以下的控制字符，用 \u00XX 表示
-          char buf[7]; // \uXXXX + NUL
-          std::snprintf(buf, sizeof(buf), "\\u%04X", static_cast<unsigned int>(c)); // %04X是四位十六进制，输出到buf里
-          out += buf;
-        } else {
-          out.push_back(static_cast<char>(c)); // 普通字符直接添加
-        }
+// ---------------------------------------------------------------------------
+// serve：常驻进程模式（stdin/stdout 或 Unix domain socket 上的按行 JSON 请求）
+//
+// 为什么需要它？
+// - 每次 list/read/search 都 fork 一个 engine_cli，要付出 exec、动态链接、冷缓存的代价；
+//   大仓库上这部分开销甚至比搜索本身还大。
+// - 常驻之后，一次 workflow 里的所有调用都复用同一个进程，后续的缓存/索引也能一直保持“热”的。
+//
+// 协议（每行一个 JSON 对象，响应同样每行一个 JSON 对象）：
+//   请求：{"id":1,"cmd":"search-text","args":{"root":".","query":"std::","topk":5}}
+//   响应：{"id":1,"ok":true,"query":"std::","results":[...]}
+// - args 的 key 就是命令行参数去掉前缀 "--"；true 表示不带值的开关，false/null 会被忽略。
+// - 响应就是对应子命令原本的 JSON 输出，只是在最前面插入了请求的 id。
+// - {"cmd":"shutdown"} 结束当前会话（stdin 模式下进程退出）；stdin/连接关闭（EOF）同样会结束。
+//
+// 并发模型：
+// - 所有请求都投递到一个固定大小的线程池执行；同一个连接可以连续发多条请求而不必等响应
+//   （pipelining），响应按完成顺序写回，客户端靠 id 对应。
+// - --socket PATH 时监听 Unix domain socket，可以同时服务多个 agent worker；所有连接共享
+//   同一个进程里的线程池与状态。
+// - apply-edits / rollback 会改工作区文件，持有独占锁；其它请求持有共享锁，
+//   保证读/搜索不会看到写了一半的文件。
+// - 请求可以带 "priority":"interactive"|"normal"|"background"（默认 read-file 是 interactive，
+//   其它是 normal）。线程总是先取高优先级的队列；低优先级的遍历在文件边界上会给排队的
+//   高优先级只读请求插队（见 scheduler.h）。{"cmd":"stats"} 返回每个优先级的队列长度与等待时间。
+// ---------------------------------------------------------------------------
+
+struct ServeState {
+  // 整个 serve 进程共享的状态：所有连接共用同一个调度器（按优先级取任务的线程池），
+  // 以及 --watch 指定的工作区的实时文件树（watcher.h）。
+  explicit ServeState(std::size_t threads) : scheduler(threads) {}
+  ~ServeState() {
+    for (const auto& w : watchers) engine::unregister_watcher(w->root());
+  }
+  std::vector<std::shared_ptr<engine::Watcher>> watchers;
+  // 和 watchers 一一对应（--no-index 时为空）：在后台维护这些工作区的三元组索引（trigram_index.h）
+  std::vector<std::unique_ptr<engine::IndexKeeper>> indexers;
+  Scheduler scheduler;
+};
+
+class FdLineReader {
+  // 从文件描述符按行读取（stdin 和 socket 共用）；不依赖 iostream，方便和 poll/close 配合。
+ public:
+  explicit FdLineReader(int fd) : fd_(fd) {}
+
+  bool next(std::string& line) {
+    while (true) {
+      std::size_t nl = buf_.find('\n', scan_from_);
+      if (nl != std::string::npos) {
+        line.assign(buf_, 0, nl);
+        buf_.erase(0, nl + 1);
+        scan_from_ = 0;
+        return true;
+      }
+      scan_from_ = buf_.size();
+      char chunk[65536];
+      ssize_t n = ::read(fd_, chunk, sizeof(chunk));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        // EOF：最后一行没有换行也照样交出去
+        if (buf_.empty()) return false;
+        line.swap(buf_);
+        buf_.clear();
+        scan_from_ = 0;
+        return true;
+      }
+      buf_.append(chunk, static_cast<std::size_t>(n));
     }
   }
-  return out;
-}
 
-static std::string to_posix_path(const fs::path& p) { // 把路径转换为 POSIX 风格（斜杠分隔）
-  return p.generic_string();
-}
+ private:
+  int fd_;
+  std::string buf_;
+  std::size_t scan_from_ = 0;
+};
 
-static bool read_file_bytes(const fs::path& path, std::size_t max_bytes,
-                            std::string& out) {
-  // 以二进制读取文件，并截断到 max_bytes（用于控制上下文大小）
-  std::ifstream in(path, std::ios::binary);
-  if (!in) return false;
-  out.clear();
-  out.reserve(std::min<std::size_t>(max_bytes, 1 << 20));
-  char buf[8192];
-  std::size_t total = 0;
-  while (in && total < max_bytes) {
-    std::size_t want = std::min<std::size_t>(sizeof(buf), max_bytes - total);
-    in.read(buf, static_cast<std::streamsize>(want));
-    std::streamsize got = in.gcount();
-    if (got <= 0) break;
-    out.append(buf, static_cast<std::size_t>(got));
-    total += static_cast<std::size_t>(got);
+static bool write_all(int fd, const char* data, std::size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    len -= static_cast<std::size_t>(n);
   }
   return true;
 }
 
-static std::vector<std::string> split_lines(const std::string& text) { // 按行拆分文本
-  std::vector<std::string> lines;
-  std::string line;
-  std::istringstream iss(text); // 按行读取
-  while (std::getline(iss, line)) 
-      lines.push_back(line);
-  if (!text.empty() && text.back() == '\n') 
-      lines.push_back("");
-  return lines;
-}
+struct ServeSession {
+  // 一个会话 = 一个输入 fd + 一个输出 fd（stdin/stdout，或者同一个 socket）。
+  ServeSession(int in, int out) : in_fd(in), out_fd(out) {}
 
-static std::string join_lines(const std::vector<std::string>& lines) { // 按行合并文本
-  std::ostringstream oss;
-  for (std::size_t i = 0; i < lines.size(); i++) {
-    oss << lines[i];
-    if (i + 1 < lines.size()) oss << "\n";
+  void write_line(const std::string& line) {
+    std::lock_guard<std::mutex> lk(write_mu);
+    if (broken) return;  // 对端已经断开：剩下的响应直接丢弃
+    if (!write_all(out_fd, line.data(), line.size())) broken = true;
   }
-  return oss.str();
-}
 
-static std::unordered_set<std::string> default_ignored_dirs() {
-  // 遍历/检索时要跳过的大目录（避免浪费时间 & 避免把大量无关内容喂给模型）
-  return {".git", "build", "node_modules", "dist", "__pycache__", ".venv",
-          ".idea", ".vscode"};
-}
-
-static bool should_ignore(const fs::path& path) {
-  // path 是 root 下的相对路径；只要任意一段目录命中忽略规则，就跳过。
-  auto ignored = default_ignored_dirs();
-  for (const auto& part : path) {
-    std::string name = part.string();
-    if (ignored.count(name) != 0) return true;
-    if (name.size() >= 5 && name.rfind(".dSYM") == name.size() - 5) return true;
+  void begin_request() {
+    std::lock_guard<std::mutex> lk(inflight_mu);
+    inflight++;
   }
-  return false;
-}
 
-static bool is_likely_text(const std::string& bytes) {
-  // 很粗糙的“是否像文本”的判断：避免把二进制文件（如 .dSYM/可执行文件）塞进 JSON 输出。
-  std::size_t sample = std::min<std::size_t>(bytes.size(), 4096);
-  if (sample == 0) return true;
-  std::size_t suspicious = 0;
-  for (std::size_t i = 0; i < sample; i++) {
-    unsigned char c = static_cast<unsigned char>(bytes[i]);
-    if (c == 0) return false;
-    if (c < 0x09) suspicious++;
-    if (c >= 0x0E && c < 0x20) suspicious++;
+  void end_request() {
+    std::lock_guard<std::mutex> lk(inflight_mu);
+    if (--inflight == 0) inflight_cv.notify_all();
   }
-  return suspicious * 100 / sample < 5;
-}
 
-static int cmd_list_files(const fs::path& root) {
-  std::vector<std::string> files;
-  std::error_code ec;
-  for (auto it = fs::recursive_directory_iterator(root, ec);
-       it != fs::recursive_directory_iterator(); it.increment(ec)) {
-    if (ec) break;
-    const auto& entry = *it;
-    fs::path rel = fs::relative(entry.path(), root, ec);
-    if (ec) continue;
-    if (should_ignore(rel)) {
-      if (entry.is_directory(ec)) it.disable_recursion_pending();
-      continue;
-    }
-    if (!entry.is_regular_file(ec)) continue;
-    files.push_back(to_posix_path(rel));
+  void wait_idle() {
+    std::unique_lock<std::mutex> lk(inflight_mu);
+    inflight_cv.wait(lk, [this] { return inflight == 0; });
   }
-  std::sort(files.begin(), files.end());
 
-  std::cout << "{\"ok\":true,\"root\":\"" << json_escape(to_posix_path(root))
-            << "\",\"files\":[";
-  for (std::size_t i = 0; i < files.size(); i++) {
-    if (i) std::cout << ",";
-    std::cout << "\"" << json_escape(files[i]) << "\"";
+  // 在飞请求的取消令牌，按请求 id 索引（id 由客户端决定，可能重复，所以用 multimap）。
+  // 只在本会话内查找：不同连接的 id 互不相干。
+  std::shared_ptr<CancelToken> track(const std::string& key) {
+    auto token = std::make_shared<CancelToken>();
+    std::lock_guard<std::mutex> lk(cancel_mu);
+    running.emplace(key, token);
+    return token;
   }
-  std::cout << "]}\n";
-  return 0;
-}
 
-static int cmd_read_file(const fs::path& path, std::size_t max_bytes) {
-  std::string bytes;
-  if (!read_file_bytes(path, max_bytes, bytes)) {
-    std::cout << "{\"ok\":false,\"error\":\"read_failed\",\"path\":\""
-              << json_escape(to_posix_path(path)) << "\"}\n";
-    return 2;
-  }
-  std::cout << "{\"ok\":true,\"path\":\"" << json_escape(to_posix_path(path))
-            << "\",\"truncated\":" << (bytes.size() >= max_bytes ? "true" : "false")
-            << ",\"content\":\"" << json_escape(bytes) << "\"}\n";
-  return 0;
-}
-
-static int cmd_search_text(const fs::path& root, const std::string& query,
-                           int topk, std::size_t max_bytes) {
-  struct Match {
-    std::string path;
-    int line = 0;
-    std::string snippet;
-  };
-
-  std::vector<std::pair<int, Match>> scored;
-  std::error_code ec;
-  for (auto it = fs::recursive_directory_iterator(root, ec);
-       it != fs::recursive_directory_iterator(); it.increment(ec)) {
-    if (ec) break;
-    const auto& entry = *it;
-    fs::path rel = fs::relative(entry.path(), root, ec);
-    if (ec) continue;
-    if (should_ignore(rel)) {
-      if (entry.is_directory(ec)) it.disable_recursion_pending();
-      continue;
-    }
-    if (!entry.is_regular_file(ec)) continue;
-
-    std::string bytes;
-    if (!read_file_bytes(entry.path(), max_bytes, bytes)) continue;
-    if (!is_likely_text(bytes)) continue;
-    auto lines = split_lines(bytes);
-    for (std::size_t i = 0; i < lines.size(); i++) {
-      if (lines[i].find(query) == std::string::npos) continue;
-      int score = 1000;
-      score -= static_cast<int>(std::min<std::size_t>(lines[i].size(), 200));
-      Match m;
-      m.path = to_posix_path(rel);
-      m.line = static_cast<int>(i + 1);
-      m.snippet = lines[i];
-      scored.push_back({score, std::move(m)});
+  void untrack(const std::string& key, const std::shared_ptr<CancelToken>& token) {
+    std::lock_guard<std::mutex> lk(cancel_mu);
+    auto range = running.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == token) {
+        running.erase(it);
+        return;
+      }
     }
   }
 
-  std::sort(scored.begin(), scored.end(),
-            [](const auto& a, const auto& b) { return a.first > b.first; });
-  if (topk < 1) topk = 1;
-  if (static_cast<int>(scored.size()) > topk) scored.resize(topk);
-
-  std::cout << "{\"ok\":true,\"query\":\"" << json_escape(query)
-            << "\",\"results\":[";
-  for (std::size_t i = 0; i < scored.size(); i++) {
-    if (i) std::cout << ",";
-    const auto& r = scored[i].second;
-    std::cout << "{\"path\":\"" << json_escape(r.path) << "\",\"line\":"
-              << r.line << ",\"snippet\":\"" << json_escape(r.snippet) << "\"}";
+  std::size_t cancel(const std::string& key) {
+    std::lock_guard<std::mutex> lk(cancel_mu);
+    auto range = running.equal_range(key);
+    std::size_t n = 0;
+    for (auto it = range.first; it != range.second; ++it, ++n) it->second->cancel();
+    return n;
   }
-  std::cout << "]}\n";
-  return 0;
-}
 
-static std::optional<std::string> read_text_file_all(const fs::path& path) {
-  std::ifstream in(path, std::ios::binary);
-  if (!in) return std::nullopt;
-  std::ostringstream oss;
-  oss << in.rdbuf();
-  return oss.str();
+  int in_fd;
+  int out_fd;
+  std::mutex write_mu;
+  bool broken = false;
+  std::mutex inflight_mu;
+  std::condition_variable inflight_cv;
+  int inflight = 0;
+  std::mutex cancel_mu;
+  std::unordered_multimap<std::string, std::shared_ptr<CancelToken>> running;
+};
+
+static std::string request_key(const JsonValue& id) {
+  // 取消时按 id 匹配：字符串 "1" 和数字 1 是两个不同的 id
+  if (id.type == JsonValue::Type::String) return "s:" + id.text;
+  if (id.type == JsonValue::Type::Number) return "n:" + id.text;
+  return std::string();
 }
 
-static bool write_text_file_all(const fs::path& path, const std::string& content,
-                                std::string& err) {
-  std::ofstream out(path, std::ios::binary | std::ios::trunc);
-  if (!out) {
-    err = "write_failed";
-    return false;
+static void write_watch_stats(ResponseWriter& w, const ServeState& state) {
+  // "watch":[{"root":...,"files":N,"dirs":N,"generation":N,"events":N,...}, ...]
+  // 有后台索引时每项再加 "index":{"ready","builds","last_build_ms","files","trigrams"}
+  w.key("watch");
+  w.begin_array(state.watchers.size());
+  for (std::size_t i = 0; i < state.watchers.size(); i++) {
+    const auto& watcher = state.watchers[i];
+    auto s = watcher->stats();
+    bool indexed = i < state.indexers.size();
+    w.begin_map(indexed ? 11 : 10);
+    w.field("root", watcher->root());
+    w.field("files", s.files);
+    w.field("dirs", s.dirs);
+    w.field("generation", static_cast<std::int64_t>(s.generation));
+    w.field("events", static_cast<std::int64_t>(s.events));
+    w.field("batches", static_cast<std::int64_t>(s.batches));
+    w.field("rescans", static_cast<std::int64_t>(s.rescans));
+    w.field("overflows", static_cast<std::int64_t>(s.overflows));
+    w.field("watch_errors", static_cast<std::int64_t>(s.watch_errors));
+    w.field("unwatched", s.unwatched);
+    if (indexed) {
+      auto is = state.indexers[i]->stats();
+      w.key("index");
+      w.begin_map(5);
+      w.field("ready", is.ready);
+      w.field("builds", static_cast<std::int64_t>(is.builds));
+      w.field("last_build_ms", static_cast<std::int64_t>(is.last_build_ms));
+      w.field("files", is.files);
+      w.field("trigrams", is.trigrams);
+      w.end_map();
+    }
+    w.end_map();
   }
-  out << content;
-  if (!out.good()) {
-    err = "write_failed";
-    return false;
+  w.end_array();
+}
+
+static void write_scheduler_stats(ResponseWriter& w, const ServeState& state) {
+  // {"ok":true,"threads":N,"classes":{"interactive":{...},"normal":{...},"background":{...}}}
+  // 有 --watch 时再加一个 "watch" 数组
+  const Scheduler& scheduler = state.scheduler;
+  auto stats = scheduler.stats();
+  w.begin_map(state.watchers.empty() ? 3 : 4);
+  w.field("ok", true);
+  w.field("threads", scheduler.size());
+  w.key("classes");
+  w.begin_map(engine::kPriorityClasses);
+  for (std::size_t c = 0; c < engine::kPriorityClasses; c++) {
+    const auto& s = stats[c];
+    w.key(engine::priority_name(static_cast<Priority>(c)));
+    w.begin_map(6);
+    w.field("queued", s.queued);
+    w.field("running", s.running);
+    w.field("completed", s.completed);
+    w.field("preempted", s.preempted);
+    double avg = s.started ? s.wait_ms_total / static_cast<double>(s.started) : 0.0;
+    w.key("wait_ms_avg");
+    w.real(std::round(avg * 1000) / 1000);  // 精确到微秒就够了
+    w.key("wait_ms_max");
+    w.real(std::round(s.wait_ms_max * 1000) / 1000);
+    w.end_map();
   }
-  return true;
+  w.end_map();
+  if (!state.watchers.empty()) write_watch_stats(w, state);
+  w.end_map();
 }
 
-struct Edit {
-  std::string path;
-  int start_line = 0;  // 1-based inclusive
-  int end_line = 0;    // 1-based inclusive
-  std::string replacement;
-};
+static void serve_session(ServeSession& session, ServeState& state) {
+  // 读取循环只负责解析请求并投递到线程池，不等待执行结果，所以同一连接上可以有多个请求在飞。
+  RecordSink sink = [&session](const std::string& record) { session.write_line(record); };
+  FdLineReader reader(session.in_fd);
+  std::string line;
+  while (reader.next(line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+    JsonValue req;
+    std::string err;
+    if (!parse_json(line, req, err) || req.type != JsonValue::Type::Object) {
+      if (err.empty()) err = "request_must_be_object";
+      ResponseWriter w(WireFormat::Json, sink, {{"id", JsonValue{}}});
+      engine::write_error(w, "invalid_request_json", "detail", err);
+      continue;
+    }
 
-static std::optional<std::vector<Edit>> parse_edits_json(const std::string& text,
-                                                        std::string& err) {
-  // Minimal parser for:
-  // {"edits":[{"path":"...","start_line":1,"end_line":2,"replacement":"..."}]}
-  // NOTE: This is intentionally tiny for the demo; later replace with a real JSON lib.
-  std::vector<Edit> edits;
-
-  std::regex edit_re(R"EDITS(\{\s*"path"\s*:\s*"([^"]*)"\s*,\s*"start_line"\s*:\s*([0-9]+)\s*,\s*"end_line"\s*:\s*([0-9]+)\s*,\s*"replacement"\s*:\s*"((?:\\.|[^"\\])*)"\s*\})EDITS");
-
-  // 将 JSON 字符串字面量（不含外围引号）反转义成真实内容。
-  //
-  // 重要细节：要正确区分这两种情况：
-  // - "\n"  表示换行（应该变成真正的 '\n'）
-  // - "\\n" 表示两个字符：反斜杠 + n（应该保留为 "\\n"）
-  //
-  // 之前用简单的 regex_replace 会把 "\\n" 误处理成 "\<换行>"，导致 C++ 代码出现行续接。
-  auto json_unescape = [](const std::string& in, std::string& out,
-                          std::string& uerr) -> bool {
-    out.clear();
-    out.reserve(in.size());
-    for (std::size_t i = 0; i < in.size(); i++) {
-      char c = in[i];
-      if (c != '\\') {
-        out.push_back(c);
+    // 协议层的回复（解析失败、shutdown ...）固定用 JSON；子命令的回复按请求里的 "format" 编码
+    RecordTags tags{{"id", request_id_value(req.get("id"))}};
+    ResponseWriter reply(WireFormat::Json, sink, tags);
+    Args args;
+    if (!request_to_args(req, args, err)) {
+      engine::write_error(reply, err);
+      continue;
+    }
+    if (args[0] == "shutdown") {
+      session.wait_idle();
+      reply.begin_map(1);
+      reply.field("ok", true);
+      reply.end_map();
+      break;
+    }
+    if (args[0] == "serve") {
+      engine::write_error(reply, "unsupported_in_serve");
+      continue;
+    }
+    if (args[0] == "cancel") {
+      // 在读取线程里立即处理，不进线程池排队：被取消的请求在下一个检查点停下，
+      // 搜索类请求会带着 partial:true 回复目前为止的结果，还在排队的请求直接回 cancelled。
+      const JsonValue* params = req.get("args");
+      const JsonValue* target = params ? params->get("id") : nullptr;
+      std::string key = target ? request_key(*target) : std::string();
+      if (key.empty()) {
+        engine::write_error(reply, "missing_id");
         continue;
       }
-      if (i + 1 >= in.size()) {
-        uerr = "invalid_escape_trailing_backslash";
-        return false;
-      }
-      char n = in[++i];
-      switch (n) {
-        case 'n':
-          out.push_back('\n');
-          break;
-        case 't':
-          out.push_back('\t');
-          break;
-        case 'r':
-          out.push_back('\r');
-          break;
-        case '"':
-          out.push_back('"');
-          break;
-        case '\\':
-          out.push_back('\\');
-          break;
-        case 'u': {
-          if (i + 4 >= in.size()) {
-            uerr = "invalid_unicode_escape";
-            return false;
-          }
-          unsigned int code = 0;
-          for (int k = 0; k < 4; k++) {
-            char h = in[i + 1 + k];
-            code <<= 4;
-            if (h >= '0' && h <= '9')
-              code |= static_cast<unsigned int>(h - '0');
-            else if (h >= 'a' && h <= 'f')
-              code |= static_cast<unsigned int>(10 + h - 'a');
-            else if (h >= 'A' && h <= 'F')
-              code |= static_cast<unsigned int>(10 + h - 'A');
-            else {
-              uerr = "invalid_unicode_escape";
-              return false;
-            }
-          }
-          i += 4;
-          // demo 版：只保证 ASCII 可读；更完整的 UTF-8 编码可作为后续增强点。
-          if (code <= 0x7F) {
-            out.push_back(static_cast<char>(code));
-          } else {
-            out.push_back('?');
-          }
-          break;
-        }
-        default:
-          uerr = "unsupported_escape";
-          return false;
-      }
+      std::size_t n = session.cancel(key);
+      reply.begin_map(2);
+      reply.field("ok", true);
+      reply.field("cancelled", n);
+      reply.end_map();
+      continue;
     }
-    return true;
-  };
-  auto begin = std::sregex_iterator(text.begin(), text.end(), edit_re);
-  auto end = std::sregex_iterator();
-  for (auto it = begin; it != end; ++it) {
-    Edit e;
-    e.path = (*it)[1].str();
-    e.start_line = std::stoi((*it)[2].str());
-    e.end_line = std::stoi((*it)[3].str());
-    std::string replacement_raw = (*it)[4].str();
-    std::string replacement;
-    std::string uerr;
-    if (!json_unescape(replacement_raw, replacement, uerr)) {
-      err = "invalid_replacement_string";
-      return std::nullopt;
+    if (args[0] == "stats") {
+      write_scheduler_stats(reply, state);
+      continue;
     }
-    e.replacement = std::move(replacement);
-    edits.push_back(std::move(e));
-  }
-  if (edits.empty()) {
-    err = "invalid_or_empty_edits_json";
-    return std::nullopt;
+    // batch 会在自己的线程池里展开，这里照常投递即可
+
+    Priority priority = args[0] == "read-file" ? Priority::Interactive : Priority::Normal;
+    auto priority_arg = arg_value(args, std::string("--priority"));
+    if (priority_arg.has_value() && !engine::parse_priority(*priority_arg, priority)) {
+      engine::write_error(reply, "invalid_priority", "priority", *priority_arg);
+      continue;
+    }
+
+    // 截止时间从收到请求时算起：在线程池里排队的时间也计入预算
+    std::string key = request_key(tags.front().second);
+    std::shared_ptr<CancelToken> token = session.track(key);
+    auto deadline_ms = arg_value(args, std::string("--deadline-ms"));
+    if (deadline_ms.has_value()) {
+      try {
+        token->set_deadline_after_ms(std::stoll(*deadline_ms));
+      } catch (const std::exception&) {
+        // 格式错误留给 run_command 报 invalid_argument
+      }
+    }
+    // 遍历到每个文件之前给更高优先级的请求让路
+    token->set_checkpoint_hook(
+        [&state, priority] { state.scheduler.yield_to_higher(priority); });
+    // 修改类请求要拿独占锁、batch 里可能有修改类操作：都不能插到别人的遍历中间执行
+    bool inline_ok = !engine::is_mutating_command(args[0]) && args[0] != "batch";
+
+    session.begin_request();
+    state.scheduler.submit(
+        priority,
+        [&session, sink, key, token, tags = std::move(tags), args = std::move(args)] {
+          run_command_guarded(args, sink, tags, nullptr, token.get());
+          session.untrack(key, token);
+          session.end_request();
+        },
+        inline_ok);
   }
-  return edits;
+  session.wait_idle();
 }
 
-static std::string timestamp_id() {
-  using namespace std::chrono;
-  auto now = system_clock::now().time_since_epoch();
-  auto ms = duration_cast<milliseconds>(now).count();
-  return std::to_string(ms);
-}
+static std::atomic<bool> g_stop_serving{false};
+
+extern "C" void on_stop_signal(int) { g_stop_serving = true; }
 
-static int cmd_apply_edits(const fs::path& root, const fs::path& edits_json_path) {
-  // apply-edits：
-  // - 输入：一个 edits.json（包含若干“文件路径 + 行号区间 + replacement”）
-  // - 行为：
-  //   1) 读取目标文件
-  //   2) 对每个文件先做快照备份到 root/.agent_snapshots/<snapshot_id>/...
-  //   3) 再把指定行号区间替换成 replacement
-  // - 输出：{ ok, snapshot_id, changed[] }
-  //
-  // 为什么要 snapshot？
-  // - 这是“可控修改”的核心：任何一次自动修改都必须可回滚
-  // - 答辩时你可以强调：即使模型/规则出错，也不会把仓库改坏
-  auto text_opt = read_text_file_all(edits_json_path);
-  if (!text_opt.has_value()) {
-    std::cout << "{\"ok\":false,\"error\":\"edits_json_read_failed\"}\n";
+static int cmd_serve_socket(const std::string& socket_path, ServeState& state,
+                            std::ostream& out) {
+  // 多客户端模式：每个连接一个读取线程（只做解析/投递），真正的执行都在共享线程池里。
+  sockaddr_un addr{};
+  if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+    out << "{\"ok\":false,\"error\":\"invalid_socket_path\"}\n";
     return 2;
   }
-  std::string parse_err;
-  auto edits_opt = parse_edits_json(*text_opt, parse_err);
-  if (!edits_opt.has_value()) {
-    std::cout << "{\"ok\":false,\"error\":\"" << json_escape(parse_err) << "\"}\n";
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+  int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    out << "{\"ok\":false,\"error\":\"socket_failed\"}\n";
+    return 2;
+  }
+  ::unlink(socket_path.c_str());  // 上一次异常退出可能留下了同名的 socket 文件
+  if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(listen_fd, 64) != 0) {
+    ::close(listen_fd);
+    out << "{\"ok\":false,\"error\":\"bind_failed\",\"socket\":\""
+        << json_escape(socket_path) << "\"}\n";
     return 2;
   }
 
-  std::string snapshot_id = timestamp_id();
-  fs::path snap_root = root / ".agent_snapshots" / snapshot_id;
-  std::error_code ec;
-  fs::create_directories(snap_root, ec);
-
-  std::vector<std::string> changed;
-  for (const auto& e : *edits_opt) {
-    fs::path abs = root / fs::path(e.path);
-    auto content_opt = read_text_file_all(abs);
-    if (!content_opt.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"file_read_failed\",\"path\":\""
-                << json_escape(e.path) << "\"}\n";
-      return 2;
-    }
-    auto lines = split_lines(*content_opt);
-    if (e.start_line < 1 || e.end_line < e.start_line ||
-        e.end_line > static_cast<int>(lines.size())) {
-      std::cout << "{\"ok\":false,\"error\":\"invalid_line_range\",\"path\":\""
-                << json_escape(e.path) << "\"}\n";
-      return 2;
-    }
-
-    // Snapshot original.
-    fs::path snap_path = snap_root / fs::path(e.path);
-    fs::create_directories(snap_path.parent_path(), ec);
-    std::string write_err;
-    if (!write_text_file_all(snap_path, *content_opt, write_err)) {
-      std::cout << "{\"ok\":false,\"error\":\"snapshot_write_failed\",\"path\":\""
-                << json_escape(e.path) << "\"}\n";
-      return 2;
-    }
-
-    std::vector<std::string> repl_lines = split_lines(e.replacement);
-    lines.erase(lines.begin() + (e.start_line - 1), lines.begin() + e.end_line);
-    lines.insert(lines.begin() + (e.start_line - 1), repl_lines.begin(),
-                 repl_lines.end());
-
-    std::string updated = join_lines(lines);
-    if (!write_text_file_all(abs, updated, write_err)) {
-      std::cout << "{\"ok\":false,\"error\":\"write_failed\",\"path\":\""
-                << json_escape(e.path) << "\"}\n";
-      return 2;
+  std::signal(SIGINT, on_stop_signal);
+  std::signal(SIGTERM, on_stop_signal);
+
+  // 就绪通知：启动方读到这一行就可以开始连接了
+  out << "{\"ok\":true,\"socket\":\"" << json_escape(socket_path)
+      << "\",\"threads\":" << state.scheduler.size() << "}\n";
+  out.flush();
+
+  std::mutex conns_mu;
+  std::condition_variable conns_cv;
+  std::unordered_set<int> conns;
+
+  while (!g_stop_serving) {
+    pollfd pfd{listen_fd, POLLIN, 0};
+    int ready = ::poll(&pfd, 1, 200);  // 定期醒来检查停止标志
+    if (ready <= 0) continue;
+    int client_fd = ::accept(listen_fd, nullptr, nullptr);
+    if (client_fd < 0) continue;
+    {
+      std::lock_guard<std::mutex> lk(conns_mu);
+      conns.insert(client_fd);
     }
-    changed.push_back(e.path);
+    std::thread([client_fd, &state, &conns_mu, &conns_cv, &conns] {
+      {
+        ServeSession session(client_fd, client_fd);
+        serve_session(session, state);
+      }
+      std::lock_guard<std::mutex> lk(conns_mu);
+      ::close(client_fd);
+      conns.erase(client_fd);
+      conns_cv.notify_all();
+    }).detach();
   }
 
-  std::sort(changed.begin(), changed.end());
-  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
-
-  std::cout << "{\"ok\":true,\"snapshot_id\":\"" << json_escape(snapshot_id)
-            << "\",\"changed\":[";
-  for (std::size_t i = 0; i < changed.size(); i++) {
-    if (i) std::cout << ",";
-    std::cout << "\"" << json_escape(changed[i]) << "\"";
-  }
-  std::cout << "]}\n";
+  ::close(listen_fd);
+  ::unlink(socket_path.c_str());
+  // 停止时唤醒所有还阻塞在 read 上的连接，等它们把在飞的请求处理完
+  std::unique_lock<std::mutex> lk(conns_mu);
+  for (int fd : conns) ::shutdown(fd, SHUT_RDWR);
+  conns_cv.wait(lk, [&conns] { return conns.empty(); });
   return 0;
 }
 
-static int cmd_rollback(const fs::path& root, const std::string& snapshot_id) {
-  // rollback：
-  // - 输入：snapshot_id
-  // - 行为：遍历 root/.agent_snapshots/<snapshot_id>/ 下的文件，并写回 root 对应位置
-  // - 输出：{ ok, snapshot_id, restored[] }
-  fs::path snap_root = root / ".agent_snapshots" / snapshot_id;
-  std::error_code ec;
-  if (!fs::exists(snap_root, ec) || !fs::is_directory(snap_root, ec)) {
-    std::cout << "{\"ok\":false,\"error\":\"snapshot_not_found\",\"snapshot_id\":\""
-              << json_escape(snapshot_id) << "\"}\n";
-    return 2;
-  }
-
-  std::vector<std::string> restored;
-  for (auto it = fs::recursive_directory_iterator(snap_root, ec);
-       it != fs::recursive_directory_iterator(); it.increment(ec)) {
-    if (ec) break;
-    const auto& entry = *it;
-    if (!entry.is_regular_file(ec)) continue;
-
-    fs::path rel = fs::relative(entry.path(), snap_root, ec);
-    if (ec) continue;
-    fs::path dest = root / rel;
-    fs::create_directories(dest.parent_path(), ec);
-
-    auto content_opt = read_text_file_all(entry.path());
-    if (!content_opt.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"snapshot_read_failed\",\"path\":\""
-                << json_escape(to_posix_path(rel)) << "\"}\n";
+static int cmd_serve(const Args& args, std::ostream& out) {
+  std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  auto th = arg_value(args, std::string("--threads"));
+  if (th.has_value()) {
+    // 不合法的值启动前就报错退出，不要 abort 或者起不来线程
+    auto n = engine::parse_threads(*th);
+    if (!n.has_value()) {
+      out << "{\"ok\":false,\"error\":\"invalid_threads\",\"threads\":\"" << json_escape(*th)
+          << "\"}\n";
       return 2;
     }
-    std::string write_err;
-    if (!write_text_file_all(dest, *content_opt, write_err)) {
-      std::cout << "{\"ok\":false,\"error\":\"restore_write_failed\",\"path\":\""
-                << json_escape(to_posix_path(rel)) << "\"}\n";
+    threads = *n;
+  }
+  ServeState state(threads);
+
+  // --watch ROOT（可以给多个）：启动前先把整棵树扫一遍并挂上 inotify
+  for (const auto& root : engine::arg_list(args, "--watch")) {
+    std::string err;
+    auto watcher = engine::Watcher::start(std::filesystem::path(root), err);
+    if (!watcher) {
+      out << "{\"ok\":false,\"error\":\"" << err << "\",\"root\":\"" << json_escape(root)
+          << "\"}\n";
       return 2;
     }
-    restored.push_back(to_posix_path(rel));
+    engine::register_watcher(watcher);
+    state.watchers.push_back(std::move(watcher));
+  }
+  // 被监听的工作区默认在后台建三元组索引，之后随 watcher 报告的变化增量重建
+  if (!engine::has_flag(args, "--no-index")) {
+    for (const auto& watcher : state.watchers) {
+      state.indexers.push_back(std::make_unique<engine::IndexKeeper>(watcher));
+    }
   }
 
-  std::sort(restored.begin(), restored.end());
-  restored.erase(std::unique(restored.begin(), restored.end()), restored.end());
+  // 对端提前断开时 write 返回 EPIPE 即可，不要让 SIGPIPE 把整个进程带走
+  std::signal(SIGPIPE, SIG_IGN);
 
-  std::cout << "{\"ok\":true,\"snapshot_id\":\"" << json_escape(snapshot_id)
-            << "\",\"restored\":[";
-  for (std::size_t i = 0; i < restored.size(); i++) {
-    if (i) std::cout << ",";
-    std::cout << "\"" << json_escape(restored[i]) << "\"";
-  }
-  std::cout << "]}\n";
-  return 0;
-}
+  auto socket_path = arg_value(args, std::string("--socket"));
+  if (socket_path.has_value()) return cmd_serve_socket(*socket_path, state, out);
 
-static std::optional<std::string> arg_value(int argc, char** argv,
-                                           const std::string& key) {
-  for (int i = 0; i + 1 < argc; i++) {
-    if (argv[i] == key) return std::string(argv[i + 1]);
-  }
-  return std::nullopt;
+  ServeSession session(STDIN_FILENO, STDOUT_FILENO);
+  serve_session(session, state);
+  return 0;
 }
 
 int main(int argc, char** argv) {
-  // 入口：按“子命令”的方式分发（类似 git 的 git status / git log）。
-  // 这种设计非常利于未来扩展更多工具能力：只要新增一个 cmd_xxx + 参数解析即可。
   if (argc < 2) {
     print_usage(argv[0]);
     return 2;
   }
-  std::string cmd = argv[1];
-
-  if (cmd == "list-files") {
-    auto root = arg_value(argc, argv, std::string("--root"));
-    if (!root.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"missing_root\"}\n";
-      return 2;
-    }
-    return cmd_list_files(fs::path(*root));
-  }
-
-  if (cmd == "read-file") {
-    auto path = arg_value(argc, argv, std::string("--path"));
-    if (!path.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"missing_path\"}\n";
-      return 2;
-    }
-    std::size_t max_bytes = 200000;
-    auto mb = arg_value(argc, argv, std::string("--max-bytes"));
-    if (mb.has_value()) max_bytes = static_cast<std::size_t>(std::stoull(*mb));
-    return cmd_read_file(fs::path(*path), max_bytes);
-  }
+  Args args(argv + 1, argv + argc);
 
-  if (cmd == "search-text") {
-    auto root = arg_value(argc, argv, std::string("--root"));
-    auto query = arg_value(argc, argv, std::string("--query"));
-    if (!root.has_value() || !query.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"missing_root_or_query\"}\n";
-      return 2;
-    }
-    int topk = 10;
-    auto tk = arg_value(argc, argv, std::string("--topk"));
-    if (tk.has_value()) topk = std::stoi(*tk);
-    std::size_t max_bytes = 200000;
-    auto mb = arg_value(argc, argv, std::string("--max-bytes"));
-    if (mb.has_value()) max_bytes = static_cast<std::size_t>(std::stoull(*mb));
-    return cmd_search_text(fs::path(*root), *query, topk, max_bytes);
-  }
-
-  if (cmd == "apply-edits") {
-    auto root = arg_value(argc, argv, std::string("--root"));
-    auto edits_json = arg_value(argc, argv, std::string("--edits-json"));
-    if (!root.has_value() || !edits_json.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"missing_root_or_edits_json\"}\n";
-      return 2;
-    }
-    return cmd_apply_edits(fs::path(*root), fs::path(*edits_json));
-  }
+  if (args[0] == "serve") return cmd_serve(args, std::cout);
 
-  if (cmd == "rollback") {
-    auto root = arg_value(argc, argv, std::string("--root"));
-    auto sid = arg_value(argc, argv, std::string("--snapshot-id"));
-    if (!root.has_value() || !sid.has_value()) {
-      std::cout << "{\"ok\":false,\"error\":\"missing_root_or_snapshot_id\"}\n";
-      return 2;
-    }
-    return cmd_rollback(fs::path(*root), *sid);
+  if (!engine::is_known_command(args[0])) {
+    print_usage(argv[0]);
+    return 2;
   }
-
-  print_usage(argv[0]);
-  return 2;
+  // 和 serve / batch 走同一个入口：坏参数、起不来线程这类异常变成错误记录，而不是 abort
+  return run_command_guarded(
+      args, [](const std::string& record) { std::cout << record; }, {},
+      [] { std::cout.flush(); });
 }
+
@@ -0,0 +1,644 @@
+/*
+  engine/src/manifest.cpp：manifest.h 的实现
+
+  文件格式（本机字节序，只给本机的引擎自己读，版本不对就当作没有 manifest 重建）：
+    "AGMF0003" epoch generation base_generation
+    paths[]     目录表（相对路径，第 0 个是根目录 ""）
+    files[]     dir name inode size mtime hash kind created_gen changed_gen   （dir 是目录表的下标）
+    dirs[]      rel mtime inode has_ignore files[] subdirs[]
+    ignores[]   path exists size mtime inode      （规则文件的 stat，变了就整棵树重新读）
+    tombstones[] path gen
+  写入时先写临时文件再 rename，其它进程不会读到写了一半的 manifest。
+*/
+
+#include "manifest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_kind.h"
+#include "thread_pool.h"
+#include "walker.h"
+
+namespace engine {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'A', 'G', 'M', 'F', '0', '0', '0', '3'};
+
+struct IgnoreStamp {
+  std::string path;  // 相对 root
+  bool exists = false;
+  std::uint64_t size = 0;
+  std::int64_t mtime_ns = 0;
+  std::uint64_t inode = 0;
+
+  bool operator==(const IgnoreStamp& o) const {
+    return path == o.path && exists == o.exists && size == o.size && mtime_ns == o.mtime_ns &&
+           inode == o.inode;
+  }
+};
+
+struct ManifestData {
+  std::uint64_t epoch = 0;
+  std::uint64_t generation = 0;
+  std::uint64_t base_generation = 0;  // 比它更早的令牌已经对不上了（墓碑被清理过）
+  PathTable paths;
+  std::vector<ManifestFile> files;  // files[i] 是 paths 里编号 i 的文件
+  std::vector<DirInfo> dirs;
+  std::vector<IgnoreStamp> ignores;
+  std::vector<std::pair<std::string, std::uint64_t>> tombstones;
+};
+
+class Encoder {
+ public:
+  template <typename T>
+  void put(T v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+  void str(std::string_view s) {
+    put(static_cast<std::uint32_t>(s.size()));
+    buf += s;
+  }
+  void names(const std::vector<std::string>& v) {
+    put(static_cast<std::uint32_t>(v.size()));
+    for (const auto& s : v) str(s);
+  }
+  std::string buf;
+};
+
+class Decoder {
+ public:
+  explicit Decoder(const std::string& data) : data_(data) {}
+
+  template <typename T>
+  bool get(T& v) {
+    if (data_.size() - pos_ < sizeof(T)) return false;
+    std::memcpy(&v, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+  bool str(std::string& s) {
+    std::uint32_t n = 0;
+    if (!get(n) || data_.size() - pos_ < n) return false;
+    s.assign(data_, pos_, n);
+    pos_ += n;
+    return true;
+  }
+  bool names(std::vector<std::string>& v) {
+    std::uint32_t n = 0;
+    if (!get(n)) return false;
+    v.resize(n);
+    for (auto& s : v) {
+      if (!str(s)) return false;
+    }
+    return true;
+  }
+  bool count(std::uint64_t& n) {
+    // 每条记录至少几个字节：明显超出剩余长度的计数说明文件坏了，不要按它去 resize
+    return get(n) && n <= data_.size() - pos_;
+  }
+  bool at_end() const { return pos_ == data_.size(); }
+
+ private:
+  const std::string& data_;
+  std::size_t pos_ = 0;
+};
+
+fs::path manifest_path(const fs::path& root) { return root / ".agent_index" / "manifest"; }
+
+std::int64_t mtime_of(const struct stat& st) {
+  return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+bool load_manifest(const fs::path& root, ManifestData& out) {
+  std::ifstream in(manifest_path(root), std::ios::binary | std::ios::ate);
+  if (!in) return false;
+  std::string data(static_cast<std::size_t>(in.tellg()), '\0');
+  in.seekg(0);
+  if (!in.read(data.data(), static_cast<std::streamsize>(data.size()))) return false;
+  if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  data.erase(0, sizeof(kMagic));
+  Decoder d(data);
+  std::uint64_t n = 0;
+  if (!d.get(out.epoch) || !d.get(out.generation) || !d.get(out.base_generation)) return false;
+  if (!d.count(n)) return false;
+  std::vector<DirId> dir_ids(n);
+  std::string text;
+  for (auto& id : dir_ids) {
+    if (!d.str(text)) return false;
+    id = out.paths.intern_dir(text);
+  }
+  if (!d.count(n)) return false;
+  out.files.resize(n);
+  for (auto& f : out.files) {
+    std::uint32_t dir = 0;
+    if (!d.get(dir) || dir >= dir_ids.size() || !d.str(text) || !d.get(f.inode) ||
+        !d.get(f.size) || !d.get(f.mtime_ns) || !d.get(f.hash) || !d.get(f.kind) ||
+        !d.get(f.created_gen) || !d.get(f.changed_gen)) {
+      return false;
+    }
+    f.id = out.paths.add(dir_ids[dir], text);
+  }
+  if (!d.count(n)) return false;
+  out.dirs.resize(n);
+  for (auto& dir : out.dirs) {
+    std::uint8_t has_ignore = 0;
+    if (!d.str(dir.rel) || !d.get(dir.mtime_ns) || !d.get(dir.inode) || !d.get(has_ignore) ||
+        !d.names(dir.files) || !d.names(dir.subdirs)) {
+      return false;
+    }
+    dir.has_ignore = has_ignore != 0;
+  }
+  if (!d.count(n)) return false;
+  out.ignores.resize(n);
+  for (auto& s : out.ignores) {
+    std::uint8_t exists = 0;
+    if (!d.str(s.path) || !d.get(exists) || !d.get(s.size) || !d.get(s.mtime_ns) ||
+        !d.get(s.inode)) {
+      return false;
+    }
+    s.exists = exists != 0;
+  }
+  if (!d.count(n)) return false;
+  out.tombstones.resize(n);
+  for (auto& t : out.tombstones) {
+    if (!d.str(t.first) || !d.get(t.second)) return false;
+  }
+  return d.at_end();
+}
+
+bool save_manifest(const fs::path& root, const ManifestData& m) {
+  Encoder e;
+  e.buf.append(kMagic, sizeof(kMagic));
+  e.put(m.epoch);
+  e.put(m.generation);
+  e.put(m.base_generation);
+  e.put(static_cast<std::uint64_t>(m.paths.dir_count()));
+  for (DirId dir = 0; dir < m.paths.dir_count(); dir++) e.str(m.paths.dir_path(dir));
+  e.put(static_cast<std::uint64_t>(m.files.size()));
+  for (const auto& f : m.files) {
+    e.put(static_cast<std::uint32_t>(m.paths.dir(f.id)));
+    e.str(m.paths.name(f.id));
+    e.put(f.inode);
+    e.put(f.size);
+    e.put(f.mtime_ns);
+    e.put(f.hash);
+    e.put(f.kind);
+    e.put(f.created_gen);
+    e.put(f.changed_gen);
+  }
+  e.put(static_cast<std::uint64_t>(m.dirs.size()));
+  for (const auto& d : m.dirs) {
+    e.str(d.rel);
+    e.put(d.mtime_ns);
+    e.put(d.inode);
+    e.put(static_cast<std::uint8_t>(d.has_ignore ? 1 : 0));
+    e.names(d.files);
+    e.names(d.subdirs);
+  }
+  e.put(static_cast<std::uint64_t>(m.ignores.size()));
+  for (const auto& s : m.ignores) {
+    e.str(s.path);
+    e.put(static_cast<std::uint8_t>(s.exists ? 1 : 0));
+    e.put(s.size);
+    e.put(s.mtime_ns);
+    e.put(s.inode);
+  }
+  e.put(static_cast<std::uint64_t>(m.tombstones.size()));
+  for (const auto& t : m.tombstones) {
+    e.str(t.first);
+    e.put(t.second);
+  }
+
+  std::error_code ec;
+  fs::path target = manifest_path(root);
+  fs::create_directories(target.parent_path(), ec);
+  if (ec) return false;
+  fs::path tmp = target;
+  tmp += ".tmp." + std::to_string(::getpid());
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(e.buf.data(), static_cast<std::streamsize>(e.buf.size()));
+    if (!out) return false;
+  }
+  fs::rename(tmp, target, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+bool hash_file(const std::string& path, std::uint64_t& out, FileKind& kind) {
+  // MurmurHash64A 的流式写法：只用来判断内容有没有变，不需要密码学强度，要的是快。
+  // 顺带用读到的第一块判断文本/二进制（kind 传进来时已经按扩展名判断过，Unknown 才看内容）
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  constexpr std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+  constexpr int r = 47;
+  std::uint64_t h = 0x9747b28c9747b28cULL;
+  std::uint64_t total = 0;
+  static thread_local std::vector<char> buf(1 << 16);
+  std::size_t carry = 0;  // 上一块末尾不满 8 字节的部分，挪到 buf 开头
+  while (true) {
+    ssize_t got = ::read(fd, buf.data() + carry, buf.size() - carry);
+    if (got < 0 && errno == EINTR) continue;
+    if (got < 0) {
+      ::close(fd);
+      return false;
+    }
+    std::size_t len = carry + static_cast<std::size_t>(got);
+    if (total == 0 && kind == FileKind::Unknown) {
+      kind = kind_from_content(buf.data(), static_cast<std::size_t>(got));
+    }
+    total += static_cast<std::uint64_t>(got);
+    std::size_t blocks = got == 0 ? 0 : len / 8;
+    for (std::size_t i = 0; i < blocks; i++) {
+      std::uint64_t k;
+      std::memcpy(&k, buf.data() + i * 8, 8);
+      k *= m;
+      k ^= k >> r;
+      k *= m;
+      h ^= k;
+      h *= m;
+    }
+    if (got == 0) {
+      std::uint64_t tail = 0;
+      for (std::size_t i = 0; i < len; i++) {
+        tail |= static_cast<std::uint64_t>(static_cast<unsigned char>(buf[i])) << (8 * i);
+      }
+      if (len > 0) {
+        h ^= tail;
+        h *= m;
+      }
+      break;
+    }
+    carry = len - blocks * 8;
+    std::memmove(buf.data(), buf.data() + blocks * 8, carry);
+  }
+  ::close(fd);
+  h ^= total;
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  out = h;
+  return true;
+}
+
+std::vector<IgnoreStamp> stamp_ignores(const std::string& base, const std::vector<DirInfo>& dirs) {
+  // 根目录的三个候选总是记录（包括不存在的：新建 .gitignore 也要能发现）；其它目录只记有规则文件的
+  std::vector<IgnoreStamp> out;
+  auto stamp = [&](const std::string& rel) {
+    IgnoreStamp s;
+    s.path = rel;
+    struct stat st {};
+    if (::stat(join_root(base, rel).c_str(), &st) == 0) {
+      s.exists = true;
+      s.size = static_cast<std::uint64_t>(st.st_size);
+      s.mtime_ns = mtime_of(st);
+      s.inode = static_cast<std::uint64_t>(st.st_ino);
+    }
+    out.push_back(std::move(s));
+  };
+  stamp(".git/info/exclude");
+  for (const auto& d : dirs) {
+    if (!d.rel.empty() && !d.has_ignore) continue;
+    std::string prefix = d.rel.empty() ? std::string() : d.rel + "/";
+    stamp(prefix + ".gitignore");
+    stamp(prefix + ".ignore");
+  }
+  return out;
+}
+
+bool ignores_unchanged(const std::string& base, const std::vector<IgnoreStamp>& old) {
+  for (const auto& s : old) {
+    IgnoreStamp now;
+    now.path = s.path;
+    struct stat st {};
+    if (::stat(join_root(base, s.path).c_str(), &st) == 0) {
+      now.exists = true;
+      now.size = static_cast<std::uint64_t>(st.st_size);
+      now.mtime_ns = mtime_of(st);
+      now.inode = static_cast<std::uint64_t>(st.st_ino);
+    }
+    if (!(now == s)) return false;
+  }
+  return true;
+}
+
+bool parse_token(const std::string& token, std::uint64_t& epoch, std::uint64_t& gen) {
+  std::size_t dot = token.find('.');
+  if (dot == std::string::npos || dot == 0 || dot + 1 == token.size()) return false;
+  try {
+    std::size_t used = 0;
+    epoch = std::stoull(token.substr(0, dot), &used);
+    if (used != dot) return false;
+    gen = std::stoull(token.substr(dot + 1), &used);
+    return used == token.size() - dot - 1;
+  } catch (...) {
+    return false;
+  }
+}
+
+std::string make_token(const ManifestData& m) {
+  return std::to_string(m.epoch) + "." + std::to_string(m.generation);
+}
+
+void diff_since(const ManifestData& m, const std::string& since, ManifestChanges& out) {
+  std::uint64_t epoch = 0, gen = 0;
+  if (!parse_token(since, epoch, gen) || epoch != m.epoch || gen < m.base_generation ||
+      gen > m.generation) {
+    out.reset = true;
+    for (const auto& f : m.files) out.added.push_back(m.paths.path(f.id));
+    return;
+  }
+  for (const auto& f : m.files) {
+    if (f.created_gen > gen) {
+      out.added.push_back(m.paths.path(f.id));
+    } else if (f.changed_gen > gen) {
+      out.modified.push_back(m.paths.path(f.id));
+    }
+  }
+  for (const auto& t : m.tombstones) {
+    if (t.second > gen) out.removed.push_back(t.first);
+  }
+  std::sort(out.removed.begin(), out.removed.end());
+}
+
+}  // namespace
+
+bool refresh_manifest(const fs::path& root, const CancelToken* cancel, const std::string* since,
+                      ManifestSnapshot& out, ManifestChanges* changes, std::string& err) {
+  // 同一进程里的并发刷新（serve 下多个 list-files）串行化：后来的那个直接吃到前一个的结果
+  static std::mutex refresh_mu;
+  std::lock_guard<std::mutex> lk(refresh_mu);
+
+  const std::string base = root.string();
+  ManifestData old;
+  bool have_old = load_manifest(root, old);
+  if (!have_old) old = ManifestData();
+  std::int64_t scan_start = now_ns();
+
+  // 规则文件变了（内容变化不会改目录 mtime）就不能信任缓存的子项，整棵树重新读
+  DirCache cache;
+  bool use_cache = have_old && ignores_unchanged(base, old.ignores);
+  if (use_cache) {
+    for (const auto& d : old.dirs) cache.emplace(d.rel, d);
+  }
+  WalkOptions options;
+  options.cache = use_cache ? &cache : nullptr;
+  options.collect_dirs = true;
+  WalkResult walk = walk_tree(root, cancel, options);
+  std::vector<IgnoreStamp> stamps = stamp_ignores(base, walk.dirs);
+  if (walk.complete && use_cache) {
+    // 新增/删除的规则文件会影响它下面那些 mtime 没变的目录：规则文件集合变了就不用缓存再来一遍
+    auto existing = [](const std::vector<IgnoreStamp>& v) {
+      std::vector<std::string> paths;
+      for (const auto& s : v) {
+        if (s.exists) paths.push_back(s.path);
+      }
+      std::sort(paths.begin(), paths.end());
+      return paths;
+    };
+    if (existing(stamps) != existing(old.ignores)) {
+      options.cache = nullptr;
+      walk = walk_tree(root, cancel, options);
+      stamps = stamp_ignores(base, walk.dirs);
+    }
+  }
+  out.dirs_cached = walk.dirs_cached;
+  out.dirs_scanned = walk.dirs.size() - walk.dirs_cached;
+
+  // 新列表和旧 manifest 都按 path 排序，一遍归并就能给每个文件找到旧记录
+  std::vector<const ManifestFile*> prev(walk.files.size(), nullptr);
+  for (FileId i = 0, j = 0; i < walk.files.size() && j < old.files.size();) {
+    int c = walk.files.compare(i, old.paths, old.files[j].id);
+    if (c == 0) prev[i++] = &old.files[j++];
+    else if (c < 0) i++;
+    else j++;
+  }
+
+  // 被取消/超时打断：返回已经找到的部分（有旧记录的沿用旧记录），不落盘，令牌保持不变
+  auto partial = [&] {
+    out.complete = false;
+    out.token = have_old ? make_token(old) : std::string();
+    for (FileId i = 0; i < walk.files.size(); i++) {
+      ManifestFile f = prev[i] ? *prev[i] : ManifestFile();
+      f.id = i;
+      out.files.push_back(f);
+    }
+    out.paths = std::move(walk.files);
+    return true;
+  };
+  if (!walk.complete) return partial();
+
+  // 并行 stat + 按需算哈希
+  std::vector<ManifestFile> next(walk.files.size());
+  std::vector<char> present(walk.files.size(), 0);
+  std::vector<char> rehashed(walk.files.size(), 0);
+  std::atomic<std::size_t> cursor{0};
+  std::atomic<bool> stopped{false};
+  auto worker = [&](bool is_caller) {
+    std::size_t counter = 0;
+    std::string rel;
+    while (!stopped) {
+      std::size_t i = cursor++;
+      if (i >= walk.files.size()) return;
+      if (++counter % 256 == 0 && (is_caller ? checkpoint(cancel) : should_stop(cancel))) {
+        stopped = true;
+        return;
+      }
+      walk.files.path_into(static_cast<FileId>(i), rel);
+      std::string abs = join_root(base, rel);
+      struct stat st {};
+      if (::stat(abs.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;  // 遍历之后被删了
+      ManifestFile& f = next[i];
+      f.inode = static_cast<std::uint64_t>(st.st_ino);
+      f.size = static_cast<std::uint64_t>(st.st_size);
+      f.mtime_ns = mtime_of(st);
+      const ManifestFile* p = prev[i];
+      if (p != nullptr && p->mtime_ns >= 0 && p->mtime_ns == f.mtime_ns && p->size == f.size &&
+          p->inode == f.inode) {
+        f.hash = p->hash;
+        f.kind = p->kind;
+      } else {
+        f.kind = kind_from_name(walk.files.name(static_cast<FileId>(i)));
+        if (!hash_file(abs, f.hash, f.kind)) {
+          f.hash = 0;
+          f.kind = FileKind::Unknown;
+        }
+        rehashed[i] = 1;
+      }
+      if (f.mtime_ns >= scan_start - kRacyWindowNs) f.mtime_ns = -1;
+      present[i] = 1;
+    }
+  };
+  std::size_t threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 16);
+  threads = std::min(threads, std::max<std::size_t>(1, walk.files.size() / 64));
+  run_workers(threads, [&](std::size_t t) { worker(t == 0); });
+  if (stopped) return partial();
+
+  ManifestData m;
+  m.epoch = have_old ? old.epoch : static_cast<std::uint64_t>(scan_start);
+  m.base_generation = old.base_generation;
+  const std::uint64_t gen = old.generation + 1;  // 这次刷新如果有变化，就是这一代
+  bool changed = !have_old;
+  bool dirty = !have_old;  // 有任何东西要写回（包括只是 stat 信息变了）
+  std::unordered_map<std::string, std::uint64_t> tombstones(old.tombstones.begin(),
+                                                            old.tombstones.end());
+  // 遍历之后又被删掉的文件（很少见）不进新表；都在的话直接接管遍历的路径表
+  bool all_present = std::all_of(present.begin(), present.end(), [](char c) { return c != 0; });
+  if (all_present) m.paths = std::move(walk.files);
+  for (std::size_t i = 0; i < next.size(); i++) {
+    if (!present[i]) continue;
+    ManifestFile& f = next[i];
+    const ManifestFile* p = prev[i];
+    FileId walk_id = static_cast<FileId>(i);
+    f.id = all_present ? walk_id
+                       : m.paths.add(m.paths.intern_dir(walk.files.dir_path(walk.files.dir(walk_id))),
+                                     walk.files.name(walk_id));
+    if (rehashed[i]) out.files_hashed++;
+    if (p == nullptr) {
+      f.created_gen = f.changed_gen = gen;
+      tombstones.erase(m.paths.path(f.id));
+      changed = dirty = true;
+    } else {
+      f.created_gen = p->created_gen;
+      f.changed_gen = p->changed_gen;
+      if (f.hash != p->hash) {
+        f.changed_gen = gen;
+        changed = true;
+      }
+      if (f.hash != p->hash || f.inode != p->inode || f.size != p->size ||
+          f.mtime_ns != p->mtime_ns) {
+        dirty = true;
+      }
+    }
+    m.files.push_back(std::move(f));
+  }
+  {
+    std::size_t j = 0;
+    for (const auto& f : old.files) {
+      while (j < m.files.size() && m.paths.compare(m.files[j].id, old.paths, f.id) < 0) j++;
+      if (j < m.files.size() && m.paths.compare(m.files[j].id, old.paths, f.id) == 0) continue;
+      tombstones[old.paths.path(f.id)] = gen;
+      changed = dirty = true;
+    }
+  }
+  m.generation = changed ? gen : old.generation;
+  m.tombstones.assign(tombstones.begin(), tombstones.end());
+  std::sort(m.tombstones.begin(), m.tombstones.end());
+  // 墓碑只保留最近的一批；更早的令牌会被判为 reset
+  std::size_t keep = std::max<std::size_t>(1024, m.files.size());
+  if (m.tombstones.size() > keep) {
+    std::vector<std::uint64_t> gens;
+    for (const auto& t : m.tombstones) gens.push_back(t.second);
+    std::nth_element(gens.begin(), gens.begin() + static_cast<std::ptrdiff_t>(gens.size() - keep / 2),
+                     gens.end());
+    std::uint64_t cutoff = gens[gens.size() - keep / 2];
+    m.base_generation = std::max(m.base_generation, cutoff);
+    m.tombstones.erase(std::remove_if(m.tombstones.begin(), m.tombstones.end(),
+                                      [&](const auto& t) { return t.second <= cutoff; }),
+                       m.tombstones.end());
+  }
+
+  m.dirs = std::move(walk.dirs);
+  for (auto& d : m.dirs) {
+    if (d.mtime_ns >= scan_start - kRacyWindowNs) {
+      d.mtime_ns = -1;
+      dirty = true;
+    }
+  }
+  if (out.dirs_scanned > 0 || !(stamps == old.ignores)) dirty = true;
+  m.ignores = std::move(stamps);
+
+  if (dirty && !save_manifest(root, m)) {
+    err = "manifest_write_failed";
+    return false;
+  }
+  out.token = make_token(m);
+  if (since != nullptr && changes != nullptr) diff_since(m, *since, *changes);
+  out.files = std::move(m.files);
+  out.paths = std::move(m.paths);
+  return true;
+}
+
+std::vector<KnownKind> known_file_kinds(const fs::path& root, const PathTable& files) {
+  struct Cached {
+    std::int64_t mtime_ns = 0;
+    std::uint64_t size = 0;
+    std::uint64_t inode = 0;
+    std::shared_ptr<const ManifestData> data;
+  };
+  static std::mutex mu;
+  static std::unordered_map<std::string, Cached> cache;
+
+  std::vector<KnownKind> out;
+  struct stat st {};
+  if (::stat(manifest_path(root).c_str(), &st) != 0) return out;
+  std::shared_ptr<const ManifestData> data;
+  {
+    // manifest 每次落盘都是 rename 一个新文件上来：inode / size / mtime 任何一个变了就重新解析
+    std::lock_guard<std::mutex> lk(mu);
+    Cached& c = cache[root.string()];
+    if (!c.data || c.mtime_ns != mtime_of(st) || c.size != static_cast<std::uint64_t>(st.st_size) ||
+        c.inode != static_cast<std::uint64_t>(st.st_ino)) {
+      auto fresh = std::make_shared<ManifestData>();
+      if (!load_manifest(root, *fresh)) return out;
+      c = {mtime_of(st), static_cast<std::uint64_t>(st.st_size),
+           static_cast<std::uint64_t>(st.st_ino), std::move(fresh)};
+    }
+    data = c.data;
+  }
+
+  // 两边都按路径排序：一遍归并
+  out.resize(files.size());
+  for (FileId i = 0, j = 0; i < files.size() && j < data->files.size();) {
+    const ManifestFile& f = data->files[j];
+    int c = files.compare(i, data->paths, f.id);
+    if (c == 0) {
+      out[i++] = {f.kind, f.inode, f.size, f.mtime_ns};
+      j++;
+    } else if (c < 0) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+  return out;
+}
+
+bool kind_still_valid(const KnownKind& known, const std::string& abs) {
+  if (known.kind == FileKind::Unknown || known.mtime_ns < 0) return false;
+  struct stat st {};
+  return ::stat(abs.c_str(), &st) == 0 && static_cast<std::uint64_t>(st.st_ino) == known.inode &&
+         static_cast<std::uint64_t>(st.st_size) == known.size && mtime_of(st) == known.mtime_ns;
+}
+
+}  // namespace engine
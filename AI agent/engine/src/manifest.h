@@ -0,0 +1,79 @@
+/*
+  engine/src/manifest.h：持久化的文件清单（root/.agent_index/manifest）+ 增量刷新
+
+  list-files 每次都从头遍历整棵树；大仓库里客户端真正关心的往往只是“上次之后变了什么”。
+  manifest 里记下每个文件的 path / inode / size / mtime / 内容哈希，以及每个目录的 mtime 和子项：
+  - 刷新时 mtime 没变的目录直接沿用上次的子项（不 readdir），只有变了的目录才重新读；
+  - 文件仍然逐个 stat（原地改写文件不会改变目录的 mtime），但只有 stat 信息变了才重新算哈希，
+    而且哈希没变的不算修改（比如只是 touch 了一下）；
+  - 每次刷新发现变化，generation 加一；每个文件记下自己是在哪一代被新增/修改的，
+    删除的文件留一条墓碑。客户端拿着上次的 generation 就能只要“从那以后的变化”。
+
+  generation 令牌是 "<epoch>.<n>" 形式的字符串：epoch 是 manifest 创建的时间。
+  manifest 被删掉重建、或者墓碑太旧已经被清理时，客户端会拿到 reset=true，需要丢弃本地状态、按全量处理。
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "cancel.h"
+#include "file_kind.h"
+#include "path_table.h"
+
+namespace engine {
+
+struct ManifestFile {
+  FileId id = 0;  // 在所属 PathTable 里的编号（files[i].id == i，路径只存在表里）
+  std::uint64_t inode = 0;
+  std::uint64_t size = 0;
+  std::int64_t mtime_ns = 0;  // -1 表示扫描时刚被改过（mtime 不可信），下次一定重新算哈希
+  std::uint64_t hash = 0;
+  FileKind kind = FileKind::Unknown;  // 内容变化时和哈希一起重新判断（file_kind.h）
+  std::uint64_t created_gen = 0;  // 第一次出现的那一代
+  std::uint64_t changed_gen = 0;  // 最近一次新增/内容变化的那一代
+};
+
+struct ManifestSnapshot {
+  std::string token;              // 当前 generation 令牌
+  PathTable paths;                // 全部文件的路径表，按路径排序
+  std::vector<ManifestFile> files;  // 和 paths 一一对应
+  bool complete = true;           // 刷新被取消/超时打断时为 false（这次的结果不会落盘）
+  std::size_t dirs_scanned = 0;   // 重新 readdir 的目录数
+  std::size_t dirs_cached = 0;    // 直接沿用上次子项的目录数
+  std::size_t files_hashed = 0;   // 重新计算哈希的文件数
+};
+
+struct ManifestChanges {
+  bool reset = false;  // since 令牌无法对上（不同 epoch / 太旧 / 来自未来）：added 里是全部文件
+  std::vector<std::string> added;
+  std::vector<std::string> modified;
+  std::vector<std::string> removed;
+};
+
+// 刷新 root 的 manifest 并写回磁盘；since 非空时顺带算出从 since 以来的变化。
+// 写 manifest 失败时返回 false，err 里是错误码。同一进程里对 manifest 的刷新是串行的。
+bool refresh_manifest(const std::filesystem::path& root, const CancelToken* cancel,
+                      const std::string* since, ManifestSnapshot& out, ManifestChanges* changes,
+                      std::string& err);
+
+// search-text 用：磁盘上那份 manifest 记下的文件类型（只读，不刷新，也不要求最新）。
+// 记录只在 inode / size / mtime 都和现在一致时才可信（mtime_ns == -1 的记录永远不可信），见 kind_still_valid。
+struct KnownKind {
+  FileKind kind = FileKind::Unknown;
+  std::uint64_t inode = 0;
+  std::uint64_t size = 0;
+  std::int64_t mtime_ns = -1;
+};
+
+// 和 files（按路径排序）一一对应；manifest 里没有的文件是 Unknown。没有 manifest 时返回空 vector。
+// 解析结果按 manifest 文件的 stat 缓存在进程里（serve 下不会每次搜索都重新读一遍）。
+std::vector<KnownKind> known_file_kinds(const std::filesystem::path& root, const PathTable& files);
+
+// stat 一下 abs：known 是否仍然描述这个文件
+bool kind_still_valid(const KnownKind& known, const std::string& abs);
+
+}  // namespace engine
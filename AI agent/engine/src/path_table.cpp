@@ -0,0 +1,137 @@
+/*
+  engine/src/path_table.cpp：path_table.h 的实现
+*/
+
+#include "path_table.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace engine {
+
+namespace {
+
+struct Joined {
+  // dir + "/" + name，按片段存着不拼出来（根目录下的文件 dir 和 "/" 都是空的）
+  std::string_view part[3];
+};
+
+Joined joined(std::string_view dir, std::string_view name) {
+  return Joined{{dir, dir.empty() ? std::string_view() : std::string_view("/"), name}};
+}
+
+int compare_joined(const Joined& x, const Joined& y) {
+  // 和 std::string::compare 一样按无符号字节的字典序
+  std::size_t i = 0, j = 0;
+  std::string_view a = x.part[0], b = y.part[0];
+  while (true) {
+    while (a.empty() && i < 2) a = x.part[++i];
+    while (b.empty() && j < 2) b = y.part[++j];
+    if (a.empty() || b.empty()) return a.empty() ? (b.empty() ? 0 : -1) : 1;
+    std::size_t n = std::min(a.size(), b.size());
+    int c = std::char_traits<char>::compare(a.data(), b.data(), n);
+    if (c != 0) return c;
+    a.remove_prefix(n);
+    b.remove_prefix(n);
+  }
+}
+
+}  // namespace
+
+PathTable::PathTable() { intern_dir(std::string_view()); }
+
+PathTable::PathTable(const PathTable& other)
+    : files_(other.files_), names_(other.names_), dirs_(other.dirs_) {
+  dir_index_.reserve(dirs_.size());
+  for (std::size_t i = 0; i < dirs_.size(); i++) {
+    dir_index_.emplace(dirs_[i], static_cast<DirId>(i));
+  }
+}
+
+PathTable& PathTable::operator=(const PathTable& other) {
+  if (this != &other) *this = PathTable(other);
+  return *this;
+}
+
+DirId PathTable::intern_dir(std::string_view dir) {
+  auto it = dir_index_.find(dir);
+  if (it != dir_index_.end()) return it->second;
+  DirId id = static_cast<DirId>(dirs_.size());
+  dirs_.emplace_back(dir);
+  dir_index_.emplace(dirs_.back(), id);
+  return id;
+}
+
+FileId PathTable::add(DirId dir, std::string_view name) {
+  FileId id = static_cast<FileId>(files_.size());
+  files_.push_back(Entry{dir, static_cast<std::uint32_t>(names_.size()),
+                         static_cast<std::uint32_t>(name.size())});
+  names_.append(name);
+  return id;
+}
+
+FileId PathTable::add(std::string_view path) {
+  std::size_t slash = path.rfind('/');
+  if (slash == std::string_view::npos) return add(0, path);
+  return add(intern_dir(path.substr(0, slash)), path.substr(slash + 1));
+}
+
+void PathTable::reserve(std::size_t files, std::size_t name_bytes) {
+  files_.reserve(files);
+  names_.reserve(name_bytes);
+}
+
+std::string PathTable::path(FileId id) const {
+  std::string out;
+  path_into(id, out);
+  return out;
+}
+
+void PathTable::path_into(FileId id, std::string& out) const {
+  const std::string& d = dirs_[files_[id].dir];
+  out.assign(d);
+  if (!d.empty()) out.push_back('/');
+  out.append(name(id));
+}
+
+int PathTable::compare(FileId id, const PathTable& other, FileId other_id) const {
+  if (&other == this && files_[id].dir == files_[other_id].dir) {
+    return name(id).compare(name(other_id));
+  }
+  return compare_joined(joined(dir_path(dir(id)), name(id)),
+                        joined(other.dir_path(other.dir(other_id)), other.name(other_id)));
+}
+
+int PathTable::compare(FileId id, std::string_view path) const {
+  return compare_joined(joined(dir_path(dir(id)), name(id)), Joined{{path, {}, {}}});
+}
+
+void PathTable::sort() {
+  std::vector<FileId> order(files_.size());
+  for (std::size_t i = 0; i < order.size(); i++) order[i] = static_cast<FileId>(i);
+  std::sort(order.begin(), order.end(),
+            [this](FileId a, FileId b) { return compare(a, *this, b) < 0; });
+  // 文件名也按新顺序重新排进 arena：之后顺序遍历时是连续访问
+  std::vector<Entry> files;
+  std::string names;
+  files.reserve(files_.size());
+  names.reserve(names_.size());
+  for (FileId id : order) {
+    files.push_back(Entry{files_[id].dir, static_cast<std::uint32_t>(names.size()),
+                          files_[id].length});
+    names.append(name(id));
+  }
+  files_ = std::move(files);
+  names_ = std::move(names);
+}
+
+std::size_t PathTable::memory_bytes() const {
+  std::size_t bytes = files_.capacity() * sizeof(Entry) + names_.capacity();
+  for (const auto& d : dirs_) bytes += sizeof(std::string) + d.capacity();
+  // 哈希表：每个节点大约一个 string_view + 编号 + next 指针，再加桶数组
+  bytes += dir_index_.size() * (sizeof(std::string_view) + 2 * sizeof(void*)) +
+           dir_index_.bucket_count() * sizeof(void*);
+  return bytes;
+}
+
+}  // namespace engine
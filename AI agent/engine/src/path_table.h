@@ -0,0 +1,83 @@
+/*
+  engine/src/path_table.h：紧凑的路径表（文件编号 FileId <-> 相对路径）
+
+  百万文件的 monorepo 里，std::vector<std::string> 存完整相对路径时每个文件都要一次堆分配，
+  而且同一个目录前缀被重复存了成千上万份（search 的每个命中、manifest 的每条记录又各拷一份）。
+  PathTable 把路径拆成 (目录, 文件名)：
+  - 目录表：每个目录的完整路径只存一次，按路径查编号（DirId，根目录是 0）
+  - 文件：12 字节的定长记录 {目录编号, 文件名在 names 里的偏移, 长度}，文件名首尾相接放在一块 arena 里
+  其它地方（遍历结果、搜索命中、manifest）只保存 32 位的 FileId，真正要输出时才拼出完整路径。
+
+  walk_tree 返回的表是排好序的：FileId 越小路径越小（和原来 std::sort 过的字符串列表顺序相同）。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+using FileId = std::uint32_t;
+using DirId = std::uint32_t;
+
+class PathTable {
+ public:
+  PathTable();
+  // 目录索引里是指向自己目录表的 string_view：拷贝时要重建，移动时原样接管
+  PathTable(const PathTable& other);
+  PathTable& operator=(const PathTable& other);
+  PathTable(PathTable&&) = default;
+  PathTable& operator=(PathTable&&) = default;
+
+  // 目录的相对路径（根目录是空串）-> 编号，第一次出现时登记
+  DirId intern_dir(std::string_view dir);
+  // 追加一个文件，返回它的编号（= 追加之前的 size()）
+  FileId add(DirId dir, std::string_view name);
+  FileId add(std::string_view path);
+
+  std::size_t size() const { return files_.size(); }
+  bool empty() const { return files_.empty(); }
+  std::size_t dir_count() const { return dirs_.size(); }
+  void reserve(std::size_t files, std::size_t name_bytes);
+
+  DirId dir(FileId id) const { return files_[id].dir; }
+  std::string_view dir_path(DirId dir) const { return dirs_[dir]; }
+  std::string_view name(FileId id) const {
+    return std::string_view(names_).substr(files_[id].offset, files_[id].length);
+  }
+
+  // 拼出完整的相对路径（POSIX 风格）
+  std::string path(FileId id) const;
+  // 同上，写进 out（覆盖原内容），循环里复用同一个 string 不用每次分配
+  void path_into(FileId id, std::string& out) const;
+
+  // 按完整路径比较（< 0 / 0 / > 0），不需要拼出字符串；可以跨两张表比较
+  int compare(FileId id, const PathTable& other, FileId other_id) const;
+  int compare(FileId id, std::string_view path) const;
+
+  // 按路径重排文件（编号随之改变），之后 FileId 的大小顺序就是路径的字典序
+  void sort();
+
+  // 粗略的内存占用（字节），stats / 基准用
+  std::size_t memory_bytes() const;
+
+ private:
+  struct Entry {
+    DirId dir;
+    std::uint32_t offset;  // 文件名在 names_ 里的位置
+    std::uint32_t length;
+  };
+
+  std::vector<Entry> files_;
+  std::string names_;
+  std::deque<std::string> dirs_;  // deque：追加时已有元素不搬家，dir_index_ 里的 string_view 一直有效
+  std::unordered_map<std::string_view, DirId> dir_index_;
+};
+
+}  // namespace engine
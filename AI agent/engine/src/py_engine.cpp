@@ -0,0 +1,463 @@
+/*
+  engine/src/py_engine.cpp：engine_core 的 CPython 扩展模块（_engine_core）
+
+  为什么要有它？
+  - subprocess 路径下每次调用都是 C++ → JSON 文本 → 管道 → json.loads；
+    对 200KB 的 read-file 来说，json_escape 和 Python 侧解析比读文件本身还贵。
+  - 扩展模块在进程内直接调用 engine_core 的数据层接口：
+    read_file 直接把文件读进 bytes 对象（只有一次拷贝），list/search 直接构造 Python 对象。
+  - 耗时的部分都会释放 GIL，多个 Python 线程可以并行调用。
+
+  接口（都和 engine_cli 对应子命令的参数含义一致）：
+    list_files(root) -> list[str]
+    read_file(path, max_bytes=200000) -> bytes          # 失败抛 OSError
+    search_text(root, query, topk=10, max_bytes=200000, regex=False,
+                ignore_case=False, smart_case=False, word=False)
+                                       -> list[dict(path, line, snippet)]
+    search_text_multi(root, queries, topk=10, max_bytes=200000,
+                      ignore_case=False, smart_case=False, word=False)
+                                       -> list[dict(query, matches, results)]
+    call(argv: list[str]) -> str | bytes                 # 兜底：任意子命令，返回它的原始输出
+                                                         # （--format cbor/msgpack 时是 bytes）
+    call_iter(argv: list[str]) -> Iterator[str | bytes]  # 同 call，但命令在后台线程里跑，
+                                                         # 每条记录一出来就产出（--stream、batch）；
+                                                         # 迭代器提前丢弃时取消命令
+
+  没有用 pybind11：只依赖 Python.h，构建时少一个三方依赖（见 CMakeLists.txt）。
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "engine_core.h"
+
+namespace fs = std::filesystem;
+
+static PyObject* py_list_files(PyObject*, PyObject* args) {
+  const char* root = nullptr;
+  if (!PyArg_ParseTuple(args, "s:list_files", &root)) return nullptr;
+
+  engine::PathTable files;
+  Py_BEGIN_ALLOW_THREADS
+  files = engine::list_files(fs::path(root));
+  Py_END_ALLOW_THREADS
+
+  PyObject* list = PyList_New(static_cast<Py_ssize_t>(files.size()));
+  if (list == nullptr) return nullptr;
+  std::string path;
+  for (engine::FileId i = 0; i < files.size(); i++) {
+    files.path_into(i, path);
+    PyObject* item =
+        PyUnicode_DecodeFSDefaultAndSize(path.data(), static_cast<Py_ssize_t>(path.size()));
+    if (item == nullptr) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+  }
+  return list;
+}
+
+static PyObject* py_read_file(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* kwlist[] = {"path", "max_bytes", nullptr};
+  const char* path = nullptr;
+  Py_ssize_t max_bytes = 200000;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|n:read_file",
+                                   const_cast<char**>(kwlist), &path, &max_bytes))
+    return nullptr;
+  if (max_bytes < 0) {
+    PyErr_SetString(PyExc_ValueError, "max_bytes must be >= 0");
+    return nullptr;
+  }
+
+  // 先按文件大小分配好 bytes 对象，再直接读进它的缓冲区：整个过程只有内核 → bytes 这一次拷贝。
+  // 失败时按真实的 errno 抛 OSError（PermissionError、IsADirectoryError ...），不一律说文件不存在
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd < 0) return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+  struct stat st;
+  int err = ::fstat(fd, &st) != 0 ? errno
+            : S_ISREG(st.st_mode) ? 0
+            : S_ISDIR(st.st_mode) ? EISDIR
+                                  : EINVAL;  // FIFO、设备之类：不是普通文件
+  if (err != 0) {
+    ::close(fd);
+    errno = err;
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+  }
+  Py_ssize_t want = static_cast<Py_ssize_t>(std::min<std::uintmax_t>(
+      static_cast<std::uintmax_t>(st.st_size), static_cast<std::uintmax_t>(max_bytes)));
+  PyObject* bytes = PyBytes_FromStringAndSize(nullptr, want);
+  if (bytes == nullptr) {
+    ::close(fd);
+    return nullptr;
+  }
+  char* buf = PyBytes_AS_STRING(bytes);
+  Py_ssize_t got = 0;
+  Py_BEGIN_ALLOW_THREADS
+  while (got < want) {
+    ssize_t n = ::read(fd, buf + got, static_cast<std::size_t>(want - got));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) err = errno;
+    if (n <= 0) break;
+    got += n;
+  }
+  ::close(fd);
+  Py_END_ALLOW_THREADS
+  if (err != 0) {
+    Py_DECREF(bytes);
+    errno = err;
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+  }
+  if (got < want && _PyBytes_Resize(&bytes, got) != 0) return nullptr;
+  return bytes;
+}
+
+// search_text 的命中 -> list[dict(path, line, snippet)]
+static PyObject* hits_to_list(const std::vector<engine::SearchHit>& hits,
+                              const engine::PathTable& paths) {
+  PyObject* list = PyList_New(static_cast<Py_ssize_t>(hits.size()));
+  if (list == nullptr) return nullptr;
+  std::string path;
+  for (std::size_t i = 0; i < hits.size(); i++) {
+    const auto& h = hits[i];
+    paths.path_into(h.file, path);
+    // snippet 来自任意文件内容，不保证是合法 UTF-8：用 replace 兜底，和 JSON 路径的观感一致
+    PyObject* snippet = PyUnicode_DecodeUTF8(h.snippet.data(),
+                                             static_cast<Py_ssize_t>(h.snippet.size()),
+                                             "replace");
+    PyObject* item = snippet == nullptr
+                         ? nullptr
+                         : Py_BuildValue("{s:s#,s:i,s:N}", "path", path.data(),
+                                         static_cast<Py_ssize_t>(path.size()), "line",
+                                         h.line, "snippet", snippet);
+    if (item == nullptr) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+  }
+  return list;
+}
+
+static PyObject* py_search_text(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* kwlist[] = {"root",  "query",       "topk",       "max_bytes",
+                                 "regex", "ignore_case", "smart_case", "word",
+                                 nullptr};
+  const char* root = nullptr;
+  const char* query = nullptr;
+  int topk = 10;
+  Py_ssize_t max_bytes = 200000;
+  int regex = 0;
+  int ignore_case = 0;
+  int smart_case = 0;
+  int word = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|inpppp:search_text",
+                                   const_cast<char**>(kwlist), &root, &query, &topk,
+                                   &max_bytes, &regex, &ignore_case, &smart_case, &word))
+    return nullptr;
+
+  engine::SearchResult result;
+  engine::SearchOptions options;
+  options.regex = regex != 0;
+  options.ignore_case = ignore_case != 0;
+  options.smart_case = smart_case != 0;
+  options.whole_word = word != 0;
+  std::string q(query);
+  Py_BEGIN_ALLOW_THREADS
+  result = engine::search_text(fs::path(root), q, topk,
+                               static_cast<std::size_t>(std::max<Py_ssize_t>(max_bytes, 0)),
+                               nullptr, nullptr, options);
+  Py_END_ALLOW_THREADS
+  if (!result.error.empty()) {
+    PyErr_SetString(PyExc_ValueError, result.error.c_str());
+    return nullptr;
+  }
+
+  return hits_to_list(result.hits, result.paths);
+}
+
+static PyObject* py_search_text_multi(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* kwlist[] = {"root",        "queries",    "topk", "max_bytes",
+                                 "ignore_case", "smart_case", "word", nullptr};
+  const char* root = nullptr;
+  PyObject* seq = nullptr;
+  int topk = 10;
+  Py_ssize_t max_bytes = 200000;
+  int ignore_case = 0;
+  int smart_case = 0;
+  int word = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|inppp:search_text_multi",
+                                   const_cast<char**>(kwlist), &root, &seq, &topk, &max_bytes,
+                                   &ignore_case, &smart_case, &word))
+    return nullptr;
+  PyObject* fast = PySequence_Fast(seq, "search_text_multi() expects a list of strings");
+  if (fast == nullptr) return nullptr;
+  std::vector<std::string> queries;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(fast);
+  for (Py_ssize_t i = 0; i < n; i++) {
+    Py_ssize_t len = 0;
+    const char* s = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(fast, i), &len);
+    if (s == nullptr) {
+      Py_DECREF(fast);
+      return nullptr;
+    }
+    queries.emplace_back(s, static_cast<std::size_t>(len));
+  }
+  Py_DECREF(fast);
+
+  engine::MultiSearchResult result;
+  engine::SearchOptions options;
+  options.ignore_case = ignore_case != 0;
+  options.smart_case = smart_case != 0;
+  options.whole_word = word != 0;
+  Py_BEGIN_ALLOW_THREADS
+  result = engine::search_text_multi(fs::path(root), queries, topk,
+                                     static_cast<std::size_t>(std::max<Py_ssize_t>(max_bytes, 0)),
+                                     nullptr, options);
+  Py_END_ALLOW_THREADS
+
+  PyObject* list = PyList_New(static_cast<Py_ssize_t>(queries.size()));
+  if (list == nullptr) return nullptr;
+  for (std::size_t i = 0; i < queries.size(); i++) {
+    PyObject* results = hits_to_list(result.hits[i], result.paths);
+    PyObject* item = results == nullptr
+                         ? nullptr
+                         : Py_BuildValue("{s:s#,s:n,s:N}", "query", queries[i].data(),
+                                         static_cast<Py_ssize_t>(queries[i].size()), "matches",
+                                         static_cast<Py_ssize_t>(result.total_matches[i]),
+                                         "results", results);
+    if (item == nullptr) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+  }
+  return list;
+}
+
+// call / call_iter 的参数：list[str] -> Args，并拒绝空命令和 serve。失败时已设置 Python 异常
+static bool argv_from_sequence(PyObject* seq, const char* fn, engine::Args& argv) {
+  std::string what = std::string(fn) + "() expects a list of strings";
+  PyObject* fast = PySequence_Fast(seq, what.c_str());
+  if (fast == nullptr) return false;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(fast);
+  for (Py_ssize_t i = 0; i < n; i++) {
+    PyObject* item = PySequence_Fast_GET_ITEM(fast, i);
+    Py_ssize_t len = 0;
+    const char* s = PyUnicode_AsUTF8AndSize(item, &len);
+    if (s == nullptr) {
+      Py_DECREF(fast);
+      return false;
+    }
+    argv.emplace_back(s, static_cast<std::size_t>(len));
+  }
+  Py_DECREF(fast);
+  if (argv.empty()) {
+    PyErr_Format(PyExc_ValueError, "%s() needs at least a subcommand", fn);
+    return false;
+  }
+  if (argv[0] == "serve") {
+    PyErr_SetString(PyExc_ValueError, "serve is not available in-process");
+    return false;
+  }
+  return true;
+}
+
+static PyObject* py_call(PyObject*, PyObject* args) {
+  PyObject* seq = nullptr;
+  if (!PyArg_ParseTuple(args, "O:call", &seq)) return nullptr;
+  engine::Args argv;
+  if (!argv_from_sequence(seq, "call", argv)) return nullptr;
+
+  std::string out;
+  Py_BEGIN_ALLOW_THREADS
+  engine::run_command_guarded(argv, [&out](const std::string& record) { out += record; });
+  Py_END_ALLOW_THREADS
+  auto format = engine::arg_value(argv, "--format");
+  if (format.has_value() && *format != "json")
+    return PyBytes_FromStringAndSize(out.data(), static_cast<Py_ssize_t>(out.size()));
+  return PyUnicode_DecodeUTF8(out.data(), static_cast<Py_ssize_t>(out.size()), "replace");
+}
+
+// ---- call_iter：边执行边产出记录 ----
+// 命令在后台线程里跑，每条记录放进一个有界队列；Python 侧的迭代器每次 __next__ 取一条（等待时释放 GIL）。
+// 队列满了生产者就等着，所以内存不随输出总量增长；迭代器提前被丢弃时取消命令、丢掉剩下的记录，再 join
+
+struct RecordStream {
+  static constexpr std::size_t kMaxQueued = 256;
+
+  std::mutex mu;
+  std::condition_variable cv;
+  std::deque<std::string> queue;
+  bool done = false;      // 命令执行完了（所有记录都已入队）
+  bool abandoned = false;  // 迭代器没读完就被丢弃
+  engine::CancelToken cancel;
+
+  void push(const std::string& record) {
+    std::unique_lock<std::mutex> lk(mu);
+    cv.wait(lk, [this] { return queue.size() < kMaxQueued || abandoned; });
+    if (abandoned) return;
+    queue.push_back(record);
+    cv.notify_all();
+  }
+};
+
+struct RecordIter {
+  PyObject_HEAD
+  RecordStream* stream;
+  std::thread* worker;
+  bool binary;  // --format cbor/msgpack：产出 bytes
+};
+
+static void record_iter_finish(RecordIter* self) {
+  // 调用方持有 GIL；join 时释放它，后台线程可能还在等队列
+  if (self->worker == nullptr) return;
+  {
+    std::lock_guard<std::mutex> lk(self->stream->mu);
+    self->stream->abandoned = true;
+  }
+  self->stream->cancel.cancel();
+  self->stream->cv.notify_all();
+  Py_BEGIN_ALLOW_THREADS
+  self->worker->join();
+  Py_END_ALLOW_THREADS
+  delete self->worker;
+  self->worker = nullptr;
+}
+
+static void record_iter_dealloc(RecordIter* self) {
+  PyTypeObject* type = Py_TYPE(self);
+  record_iter_finish(self);
+  delete self->stream;
+  PyObject_Del(self);
+  Py_DECREF(type);  // 堆类型（PyType_FromSpec）：每个实例都持有类型的一个引用
+}
+
+static PyObject* record_iter_next(RecordIter* self) {
+  if (self->worker == nullptr) return nullptr;
+  std::string record;
+  bool got = false;
+  Py_BEGIN_ALLOW_THREADS
+  std::unique_lock<std::mutex> lk(self->stream->mu);
+  self->stream->cv.wait(lk, [self] { return !self->stream->queue.empty() || self->stream->done; });
+  if (!self->stream->queue.empty()) {
+    record = std::move(self->stream->queue.front());
+    self->stream->queue.pop_front();
+    got = true;
+    self->stream->cv.notify_all();
+  }
+  Py_END_ALLOW_THREADS
+  if (!got) {
+    record_iter_finish(self);  // 已经执行完：只是 join
+    return nullptr;            // StopIteration
+  }
+  if (self->binary)
+    return PyBytes_FromStringAndSize(record.data(), static_cast<Py_ssize_t>(record.size()));
+  return PyUnicode_DecodeUTF8(record.data(), static_cast<Py_ssize_t>(record.size()), "replace");
+}
+
+static PyType_Slot kRecordIterSlots[] = {
+    {Py_tp_dealloc, reinterpret_cast<void*>(record_iter_dealloc)},
+    {Py_tp_doc, const_cast<char*>("Records of one call_iter() command, in output order")},
+    {Py_tp_iter, reinterpret_cast<void*>(PyObject_SelfIter)},
+    {Py_tp_iternext, reinterpret_cast<void*>(record_iter_next)},
+    {0, nullptr},
+};
+
+static PyType_Spec kRecordIterSpec = {
+    "_engine_core.RecordIter",
+    sizeof(RecordIter),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    kRecordIterSlots,
+};
+
+static PyTypeObject* g_record_iter_type = nullptr;  // PyInit 里从 kRecordIterSpec 建出来
+
+static PyObject* py_call_iter(PyObject*, PyObject* args) {
+  PyObject* seq = nullptr;
+  if (!PyArg_ParseTuple(args, "O:call_iter", &seq)) return nullptr;
+  engine::Args argv;
+  if (!argv_from_sequence(seq, "call_iter", argv)) return nullptr;
+
+  RecordIter* it = PyObject_New(RecordIter, g_record_iter_type);
+  if (it == nullptr) return nullptr;
+  auto format = engine::arg_value(argv, "--format");
+  it->binary = format.has_value() && *format != "json";
+  it->stream = new RecordStream();
+  it->worker = nullptr;
+  RecordStream* stream = it->stream;
+  try {
+    it->worker = new std::thread([stream, argv = std::move(argv)] {
+      engine::run_command_guarded(
+          argv, [stream](const std::string& record) { stream->push(record); }, {}, nullptr,
+          &stream->cancel);
+      std::lock_guard<std::mutex> lk(stream->mu);
+      stream->done = true;
+      stream->cv.notify_all();
+    });
+  } catch (const std::system_error& e) {
+    Py_DECREF(it);
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return nullptr;
+  }
+  return reinterpret_cast<PyObject*>(it);
+}
+
+static PyMethodDef kMethods[] = {
+    {"list_files", py_list_files, METH_VARARGS,
+     "list_files(root) -> list[str]: sorted relative paths of non-ignored files"},
+    {"read_file", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(py_read_file)),
+     METH_VARARGS | METH_KEYWORDS,
+     "read_file(path, max_bytes=200000) -> bytes: file content truncated to max_bytes"},
+    {"search_text",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(py_search_text)),
+     METH_VARARGS | METH_KEYWORDS,
+     "search_text(root, query, topk=10, max_bytes=200000, regex=False, ignore_case=False,\n"
+     "            smart_case=False, word=False) -> list[dict]"},
+    {"search_text_multi",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(py_search_text_multi)),
+     METH_VARARGS | METH_KEYWORDS,
+     "search_text_multi(root, queries, topk=10, max_bytes=200000, ignore_case=False,\n"
+     "                  smart_case=False, word=False) -> list[dict(query, matches, results)]"},
+    {"call_iter", py_call_iter, METH_VARARGS,
+     "call_iter(argv) -> Iterator[str | bytes]: like call(), but yields each record as the "
+     "command produces it (cancels the command if the iterator is dropped early)"},
+    {"call", py_call, METH_VARARGS,
+     "call(argv) -> str | bytes: run any engine_cli subcommand and return its output "
+     "(bytes for --format cbor/msgpack)"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+static PyModuleDef kModule = {
+    PyModuleDef_HEAD_INIT,
+    "_engine_core",
+    "In-process bindings for the local engine core (see engine/src/py_engine.cpp).",
+    -1,
+    kMethods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+};
+
+PyMODINIT_FUNC PyInit__engine_core(void) {
+  g_record_iter_type = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&kRecordIterSpec));
+  if (g_record_iter_type == nullptr) return nullptr;
+  return PyModule_Create(&kModule);
+}
@@ -0,0 +1,368 @@
+/*
+  engine/src/response.cpp：response.h 的实现
+
+  编码参考：
+  - CBOR：RFC 8949（只用到定长的 map/array/text/bytes/int/float64/simple）
+  - MessagePack：https://github.com/msgpack/msgpack/blob/master/spec.md
+*/
+
+#include "response.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace engine {
+
+bool parse_wire_format(const std::string& name, WireFormat& out) {
+  if (name == "json") {
+    out = WireFormat::Json;
+  } else if (name == "cbor") {
+    out = WireFormat::Cbor;
+  } else if (name == "msgpack") {
+    out = WireFormat::MsgPack;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* wire_format_name(WireFormat format) {
+  switch (format) {
+    case WireFormat::Cbor: return "cbor";
+    case WireFormat::MsgPack: return "msgpack";
+    case WireFormat::Json: break;
+  }
+  return "json";
+}
+
+ResponseWriter::ResponseWriter(WireFormat format, RecordSink sink, RecordTags tags,
+                               std::function<void()> flush)
+    : format_(format), sink_(std::move(sink)), tags_(std::move(tags)), flush_(std::move(flush)) {}
+
+void ResponseWriter::raw(const std::string& record) {
+  assert(stack_.empty() && "raw record inside an open container");
+  sink_(record);
+}
+
+void ResponseWriter::flush() {
+  if (flush_) flush_();
+}
+
+void ResponseWriter::put_be(std::uint64_t v, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) buf_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void ResponseWriter::write_head(std::uint8_t major, std::uint64_t n) {
+  std::uint8_t m = static_cast<std::uint8_t>(major << 5);
+  if (n < 24) {
+    buf_.push_back(static_cast<char>(m | n));
+  } else if (n <= 0xFF) {
+    buf_.push_back(static_cast<char>(m | 24));
+    put_be(n, 1);
+  } else if (n <= 0xFFFF) {
+    buf_.push_back(static_cast<char>(m | 25));
+    put_be(n, 2);
+  } else if (n <= 0xFFFFFFFFull) {
+    buf_.push_back(static_cast<char>(m | 26));
+    put_be(n, 4);
+  } else {
+    buf_.push_back(static_cast<char>(m | 27));
+    put_be(n, 8);
+  }
+}
+
+void ResponseWriter::write_msgpack_len(std::uint8_t fix_base, std::size_t fix_limit,
+                                       std::uint8_t c8, std::uint8_t c16, std::uint8_t c32,
+                                       std::uint64_t n) {
+  // fix_limit == 0 表示该类型没有 fix 形式；c8 == 0 表示没有 8 位长度形式（map/array）
+  if (fix_limit != 0 && n < fix_limit) {
+    buf_.push_back(static_cast<char>(fix_base | n));
+  } else if (c8 != 0 && n <= 0xFF) {
+    buf_.push_back(static_cast<char>(c8));
+    put_be(n, 1);
+  } else if (n <= 0xFFFF) {
+    buf_.push_back(static_cast<char>(c16));
+    put_be(n, 2);
+  } else {
+    buf_.push_back(static_cast<char>(c32));
+    put_be(n, 4);
+  }
+}
+
+void ResponseWriter::before_value() {
+  if (stack_.empty()) return;
+  Frame& top = stack_.back();
+  if (top.is_map) {
+    assert(after_key_ && "map value without key");
+    after_key_ = false;
+    return;
+  }
+  assert(top.written < top.expected && "array has more items than declared");
+  if (format_ == WireFormat::Json && top.written > 0) buf_.push_back(',');
+  top.written++;
+}
+
+void ResponseWriter::after_container() {
+  if (!stack_.empty()) return;
+  // 顶层容器结束 = 一条记录编码完成
+  if (format_ == WireFormat::Json) buf_.push_back('\n');
+  sink_(buf_);
+  buf_.clear();
+}
+
+void ResponseWriter::begin_map(std::size_t n) {
+  bool top_level = stack_.empty();
+  if (top_level) n += tags_.size();
+  before_value();
+  switch (format_) {
+    case WireFormat::Json: buf_.push_back('{'); break;
+    case WireFormat::Cbor: write_head(5, n); break;
+    case WireFormat::MsgPack: write_msgpack_len(0x80, 16, 0, 0xDE, 0xDF, n); break;
+  }
+  stack_.push_back(Frame{true, n});
+  if (top_level) {
+    for (const auto& tag : tags_) {
+      key(tag.first);
+      value(tag.second);
+    }
+  }
+}
+
+void ResponseWriter::end_map() {
+  assert(!stack_.empty() && stack_.back().is_map && !after_key_);
+  assert(stack_.back().written == stack_.back().expected && "map size mismatch");
+  if (format_ == WireFormat::Json) buf_.push_back('}');
+  stack_.pop_back();
+  after_container();
+}
+
+void ResponseWriter::begin_array(std::size_t n) {
+  assert(!stack_.empty() && "records must be maps");
+  before_value();
+  switch (format_) {
+    case WireFormat::Json: buf_.push_back('['); break;
+    case WireFormat::Cbor: write_head(4, n); break;
+    case WireFormat::MsgPack: write_msgpack_len(0x90, 16, 0, 0xDC, 0xDD, n); break;
+  }
+  stack_.push_back(Frame{false, n});
+}
+
+void ResponseWriter::end_array() {
+  assert(!stack_.empty() && !stack_.back().is_map);
+  assert(stack_.back().written == stack_.back().expected && "array size mismatch");
+  if (format_ == WireFormat::Json) buf_.push_back(']');
+  stack_.pop_back();
+  after_container();
+}
+
+void ResponseWriter::key(std::string_view k) {
+  assert(!stack_.empty() && stack_.back().is_map && !after_key_);
+  Frame& top = stack_.back();
+  assert(top.written < top.expected && "map has more keys than declared");
+  if (format_ == WireFormat::Json) {
+    if (top.written > 0) buf_.push_back(',');
+    buf_.push_back('"');
+    json_escape_to(buf_, k);
+    buf_ += "\":";
+  } else if (format_ == WireFormat::Cbor) {
+    write_head(3, k.size());
+    buf_.append(k.data(), k.size());
+  } else {
+    write_msgpack_len(0xA0, 32, 0xD9, 0xDA, 0xDB, k.size());
+    buf_.append(k.data(), k.size());
+  }
+  top.written++;
+  after_key_ = true;
+}
+
+void ResponseWriter::str(std::string_view s) {
+  before_value();
+  switch (format_) {
+    case WireFormat::Json:
+      buf_.push_back('"');
+      json_escape_to(buf_, s);
+      buf_.push_back('"');
+      return;
+    case WireFormat::Cbor: write_head(3, s.size()); break;
+    case WireFormat::MsgPack: write_msgpack_len(0xA0, 32, 0xD9, 0xDA, 0xDB, s.size()); break;
+  }
+  buf_.append(s.data(), s.size());
+}
+
+void ResponseWriter::bytes(std::string_view b) {
+  if (format_ == WireFormat::Json) {
+    str(b);
+    return;
+  }
+  before_value();
+  if (format_ == WireFormat::Cbor)
+    write_head(2, b.size());
+  else
+    write_msgpack_len(0, 0, 0xC4, 0xC5, 0xC6, b.size());
+  buf_.append(b.data(), b.size());
+}
+
+void ResponseWriter::integer(std::int64_t v) {
+  before_value();
+  if (format_ == WireFormat::Json) {
+    buf_ += std::to_string(v);
+  } else if (format_ == WireFormat::Cbor) {
+    if (v >= 0)
+      write_head(0, static_cast<std::uint64_t>(v));
+    else
+      write_head(1, static_cast<std::uint64_t>(-(v + 1)));
+  } else if (v >= 0) {
+    std::uint64_t u = static_cast<std::uint64_t>(v);
+    if (u < 128) {
+      buf_.push_back(static_cast<char>(u));
+    } else if (u <= 0xFF) {
+      buf_.push_back(static_cast<char>(0xCC));
+      put_be(u, 1);
+    } else if (u <= 0xFFFF) {
+      buf_.push_back(static_cast<char>(0xCD));
+      put_be(u, 2);
+    } else if (u <= 0xFFFFFFFFull) {
+      buf_.push_back(static_cast<char>(0xCE));
+      put_be(u, 4);
+    } else {
+      buf_.push_back(static_cast<char>(0xCF));
+      put_be(u, 8);
+    }
+  } else {
+    std::uint64_t bits = static_cast<std::uint64_t>(v);
+    if (v >= -32) {
+      buf_.push_back(static_cast<char>(bits & 0xFF));
+    } else if (v >= -128) {
+      buf_.push_back(static_cast<char>(0xD0));
+      put_be(bits, 1);
+    } else if (v >= -32768) {
+      buf_.push_back(static_cast<char>(0xD1));
+      put_be(bits, 2);
+    } else if (v >= INT32_MIN) {
+      buf_.push_back(static_cast<char>(0xD2));
+      put_be(bits, 4);
+    } else {
+      buf_.push_back(static_cast<char>(0xD3));
+      put_be(bits, 8);
+    }
+  }
+}
+
+void ResponseWriter::real(double v) {
+  before_value();
+  if (format_ == WireFormat::Json) {
+    // 先试 15 位有效数字（0.1 打印成 0.1 而不是 0.10000000000000001），不能精确还原时再用 17 位
+    char tmp[32];
+    std::snprintf(tmp, sizeof(tmp), "%.15g", v);
+    if (std::strtod(tmp, nullptr) != v) std::snprintf(tmp, sizeof(tmp), "%.17g", v);
+    buf_ += tmp;
+    return;
+  }
+  std::uint64_t bits = 0;
+  std::memcpy(&bits, &v, sizeof(bits));
+  buf_.push_back(static_cast<char>(format_ == WireFormat::Cbor ? 0xFB : 0xCB));
+  put_be(bits, 8);
+}
+
+void ResponseWriter::boolean(bool b) {
+  before_value();
+  switch (format_) {
+    case WireFormat::Json: buf_ += b ? "true" : "false"; break;
+    case WireFormat::Cbor: buf_.push_back(static_cast<char>(b ? 0xF5 : 0xF4)); break;
+    case WireFormat::MsgPack: buf_.push_back(static_cast<char>(b ? 0xC3 : 0xC2)); break;
+  }
+}
+
+void ResponseWriter::null() {
+  before_value();
+  switch (format_) {
+    case WireFormat::Json: buf_ += "null"; break;
+    case WireFormat::Cbor: buf_.push_back(static_cast<char>(0xF6)); break;
+    case WireFormat::MsgPack: buf_.push_back(static_cast<char>(0xC0)); break;
+  }
+}
+
+void ResponseWriter::value(const JsonValue& v) {
+  switch (v.type) {
+    case JsonValue::Type::Null:
+      null();
+      return;
+    case JsonValue::Type::Bool:
+      boolean(v.boolean);
+      return;
+    case JsonValue::Type::String:
+      str(v.text);
+      return;
+    case JsonValue::Type::Number: {
+      if (format_ == WireFormat::Json) {
+        before_value();
+        buf_ += v.text;  // 原样回显，保证 id 逐字节不变
+        return;
+      }
+      const char* begin = v.text.c_str();
+      char* end = nullptr;
+      errno = 0;
+      long long i = std::strtoll(begin, &end, 10);
+      if (errno == 0 && end != begin && *end == '\0') {
+        integer(i);
+      } else {
+        real(std::strtod(begin, nullptr));
+      }
+      return;
+    }
+    case JsonValue::Type::Array:
+      begin_array(v.items.size());
+      for (const auto& item : v.items) value(item);
+      end_array();
+      return;
+    case JsonValue::Type::Object:
+      begin_map(v.members.size());
+      for (const auto& kv : v.members) {
+        key(kv.first);
+        value(kv.second);
+      }
+      end_map();
+      return;
+  }
+}
+
+void write_error(ResponseWriter& w, std::string_view error) {
+  w.begin_map(2);
+  w.field("ok", false);
+  w.field("error", error);
+  w.end_map();
+}
+
+void write_error(ResponseWriter& w, std::string_view error, std::string_view k,
+                 std::string_view v) {
+  w.begin_map(3);
+  w.field("ok", false);
+  w.field("error", error);
+  w.field(k, v);
+  w.end_map();
+}
+
+std::pair<std::uint32_t, bool> PathDict::intern(std::string_view dir) {
+  auto it = index_.find(std::string(dir));
+  if (it != index_.end()) return {it->second, false};
+  std::uint32_t id = static_cast<std::uint32_t>(dirs_.size());
+  dirs_.emplace_back(dir);
+  index_.emplace(dirs_.back(), id);
+  return {id, true};
+}
+
+void PathDict::split(std::string_view path, std::string_view& dir, std::string_view& name) {
+  std::size_t slash = path.rfind('/');
+  if (slash == std::string_view::npos) {
+    dir = std::string_view();
+    name = path;
+  } else {
+    dir = path.substr(0, slash);
+    name = path.substr(slash + 1);
+  }
+}
+
+}  // namespace engine
@@ -0,0 +1,126 @@
+/*
+  engine/src/response.h：子命令的响应编码（JSON / CBOR / MessagePack）
+
+  所有子命令都通过 ResponseWriter 输出“记录”（一个顶层 map 就是一条记录），
+  具体编码由 --format 决定：
+  - json（默认）：每条记录一行 JSON，和最早的输出格式逐字节一致
+  - cbor / msgpack：二进制编码，记录本身自带长度，直接首尾相接即可
+    * 文件内容用原始字节串（带长度前缀，不做任何转义）
+    * 路径做字典编码：目录只发送一次，之后用编号引用（见 PathDict）
+
+  为什么不直接各写一套输出代码？
+  - 子命令只描述“结构”（map/array/字段），编码细节集中在这里，新增格式不用改子命令；
+  - serve 的 "id"、batch 的 "op" 这类附加字段也由 writer 统一插到每条记录开头（tags）。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+
+namespace engine {
+
+enum class WireFormat { Json, Cbor, MsgPack };
+
+// "json" / "cbor" / "msgpack" -> WireFormat；不认识的名字返回 false
+bool parse_wire_format(const std::string& name, WireFormat& out);
+const char* wire_format_name(WireFormat format);
+
+// 每条完整记录编码完成后交给 sink（一次调用 = 一条完整记录，方便并发写同一个连接）
+using RecordSink = std::function<void(const std::string&)>;
+
+// 插到每条记录开头的附加字段，例如 {"id", 1}
+using RecordTags = std::vector<std::pair<std::string, JsonValue>>;
+
+class ResponseWriter {
+ public:
+  ResponseWriter(WireFormat format, RecordSink sink, RecordTags tags = {},
+                 std::function<void()> flush = nullptr);
+
+  WireFormat format() const { return format_; }
+  bool binary() const { return format_ != WireFormat::Json; }
+  const RecordTags& tags() const { return tags_; }
+
+  // map / array 需要事先给出元素个数（二进制格式的头部要写长度）；JSON 下只用来做一致性检查。
+  // 顶层 map 的个数不含 tags，writer 会自动加上。
+  void begin_map(std::size_t n);
+  void end_map();
+  void begin_array(std::size_t n);
+  void end_array();
+
+  void key(std::string_view k);
+  void str(std::string_view s);      // 文本（路径、snippet……）
+  void bytes(std::string_view b);    // 原始字节（文件内容）；JSON 下按字符串转义输出
+  void integer(std::int64_t v);
+  void real(double v);
+  void boolean(bool b);
+  void null();
+  void value(const JsonValue& v);    // 原样回显请求里的值（如 id）
+
+  // 常用的 key + value 组合
+  void field(std::string_view k, std::string_view v) { key(k); str(v); }
+  void field(std::string_view k, const char* v) { key(k); str(v); }
+  void field(std::string_view k, std::int64_t v) { key(k); integer(v); }
+  void field(std::string_view k, int v) { key(k); integer(v); }
+  void field(std::string_view k, std::size_t v) { key(k); integer(static_cast<std::int64_t>(v)); }
+  void field(std::string_view k, bool v) { key(k); boolean(v); }
+
+  // 原样转发另一个 writer 编好的完整记录（batch 汇总各操作的输出时用）
+  void raw(const std::string& record);
+
+  // 把已经写完的记录尽快推给对端（流式输出时用）
+  void flush();
+
+ private:
+  struct Frame {
+    bool is_map;
+    std::size_t expected;
+    std::size_t written = 0;
+  };
+
+  void before_value();
+  void after_container();
+  void write_head(std::uint8_t major, std::uint64_t n);  // CBOR 头部
+  void write_msgpack_len(std::uint8_t fix_base, std::size_t fix_limit, std::uint8_t c8,
+                         std::uint8_t c16, std::uint8_t c32, std::uint64_t n);
+  void put_be(std::uint64_t v, int bytes);
+
+  WireFormat format_;
+  RecordSink sink_;
+  RecordTags tags_;
+  std::function<void()> flush_;
+  std::string buf_;
+  std::vector<Frame> stack_;
+  bool after_key_ = false;
+};
+
+// 便捷写法：{"ok":false,"error":<error>[,<k>:<v>]}
+void write_error(ResponseWriter& w, std::string_view error);
+void write_error(ResponseWriter& w, std::string_view error, std::string_view k,
+                 std::string_view v);
+
+class PathDict {
+  // 路径字典编码："src/a/b.cpp" -> (目录编号, "b.cpp")。
+  // 大仓库里成千上万个文件共享少量目录前缀，二进制格式下每个目录只发送一次完整路径。
+ public:
+  // 返回 {目录编号, 是否第一次出现}
+  std::pair<std::uint32_t, bool> intern(std::string_view dir);
+  const std::vector<std::string>& dirs() const { return dirs_; }
+
+  // "a/b/c.cpp" -> dir="a/b", name="c.cpp"；没有目录时 dir 为空
+  static void split(std::string_view path, std::string_view& dir, std::string_view& name);
+
+ private:
+  std::unordered_map<std::string, std::uint32_t> index_;
+  std::vector<std::string> dirs_;
+};
+
+}  // namespace engine
@@ -0,0 +1,144 @@
+/*
+  engine/src/scheduler.cpp：scheduler.h 的实现
+*/
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace engine {
+
+bool parse_priority(const std::string& name, Priority& out) {
+  if (name == "interactive") {
+    out = Priority::Interactive;
+  } else if (name == "normal") {
+    out = Priority::Normal;
+  } else if (name == "background") {
+    out = Priority::Background;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* priority_name(Priority p) {
+  switch (p) {
+    case Priority::Interactive: return "interactive";
+    case Priority::Background: return "background";
+    case Priority::Normal: break;
+  }
+  return "normal";
+}
+
+Scheduler::Scheduler(std::size_t threads) {
+  if (threads == 0) threads = 1;
+  try {
+    for (std::size_t i = 0; i < threads; i++) workers_.emplace_back([this] { worker(); });
+  } catch (...) {
+    // 起到一半失败（std::system_error）：先让已经起来的线程退出并 join，再把异常抛给调用方
+    stop();
+    throw;
+  }
+}
+
+Scheduler::~Scheduler() { stop(); }
+
+void Scheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : workers_) t.join();
+}
+
+void Scheduler::submit(Priority p, std::function<void()> task, bool inline_ok) {
+  std::size_t cls = static_cast<std::size_t>(p);
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    queues_[cls].push_back(Task{std::move(task), Clock::now(), inline_ok});
+    stats_[cls].queued++;
+    queued_[cls]++;
+  }
+  cv_.notify_one();
+}
+
+void Scheduler::run(Task& task, std::size_t cls, bool preempting) {
+  // 调用方已经把 task 从队列里取出并更新了 queued 计数
+  double wait_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - task.enqueued).count();
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    PriorityStats& s = stats_[cls];
+    s.running++;
+    s.started++;
+    if (preempting) s.preempted++;
+    s.wait_ms_total += wait_ms;
+    s.wait_ms_max = std::max(s.wait_ms_max, wait_ms);
+  }
+  task.fn();
+  std::lock_guard<std::mutex> lk(mu_);
+  stats_[cls].running--;
+  stats_[cls].completed++;
+}
+
+void Scheduler::worker() {
+  while (true) {
+    Task task;
+    std::size_t cls = 0;
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      idle_++;
+      cv_.wait(lk, [this] {
+        return stopping_ || std::any_of(queues_.begin(), queues_.end(),
+                                        [](const std::deque<Task>& q) { return !q.empty(); });
+      });
+      idle_--;
+      while (cls < kPriorityClasses && queues_[cls].empty()) cls++;
+      if (cls == kPriorityClasses) return;  // stopping_ 且所有队列都已清空
+      task = std::move(queues_[cls].front());
+      queues_[cls].pop_front();
+      stats_[cls].queued--;
+      queued_[cls]--;
+    }
+    run(task, cls, false);
+  }
+}
+
+void Scheduler::yield_to_higher(Priority current) {
+  std::size_t limit = static_cast<std::size_t>(current);
+  while (true) {
+    // 快速路径：有空闲线程（它们会去取排队的任务），或者没有更高优先级的排队任务
+    if (idle_.load(std::memory_order_relaxed) > 0) return;
+    bool waiting = false;
+    for (std::size_t c = 0; c < limit; c++) waiting |= queued_[c].load(std::memory_order_relaxed) > 0;
+    if (!waiting) return;
+
+    Task task;
+    std::size_t cls = limit;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      for (std::size_t c = 0; c < limit; c++) {
+        auto& q = queues_[c];
+        auto it = std::find_if(q.begin(), q.end(), [](const Task& t) { return t.inline_ok; });
+        if (it == q.end()) continue;
+        task = std::move(*it);
+        q.erase(it);
+        stats_[c].queued--;
+        queued_[c]--;
+        cls = c;
+        break;
+      }
+    }
+    if (cls == limit) return;  // 排队的都是不能插队的（修改工作区的）请求
+    run(task, cls, true);
+  }
+}
+
+std::array<PriorityStats, kPriorityClasses> Scheduler::stats() const {
+  std::lock_guard<std::mutex> lk(mu_);
+  return stats_;
+}
+
+}  // namespace engine
@@ -0,0 +1,89 @@
+/*
+  engine/src/scheduler.h：serve 模式的优先级调度器（替代 FIFO 线程池）
+
+  常驻引擎同时服务多个 agent worker 时，后台的整库遍历/索引不能挡住交互式的 read-file。
+  - 三个优先级：interactive > normal > background；空闲线程总是先取最高优先级的队列。
+  - 文件边界上的抢占：长操作（walk_files 遍历到每个文件之前）会调用 yield_to_higher()。
+    如果所有线程都在忙、又有更高优先级的只读请求在排队，就在当前线程上先把它们跑完，
+    再继续原来的遍历——相当于在文件边界把低优先级任务“挂起”。
+    修改工作区的请求（apply-edits / rollback）要拿独占锁，不能插到持有共享锁的遍历中间，
+    所以它们只按正常顺序调度（inline_ok = false）。
+  - 每个优先级的队列长度、运行数、等待时间都可以通过 serve 的 {"cmd":"stats"} 查看。
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+enum class Priority { Interactive = 0, Normal = 1, Background = 2 };
+constexpr std::size_t kPriorityClasses = 3;
+
+// "interactive" / "normal" / "background" -> Priority；不认识的名字返回 false
+bool parse_priority(const std::string& name, Priority& out);
+const char* priority_name(Priority p);
+
+struct PriorityStats {
+  std::size_t queued = 0;     // 当前排队数
+  std::size_t running = 0;    // 当前正在执行（含被插队执行的；响应刚写出、还在收尾的也算）
+  std::size_t completed = 0;  // 累计完成数
+  std::size_t preempted = 0;  // 累计在低优先级任务的文件边界上插队执行的次数
+  double wait_ms_total = 0;   // 从入队到开始执行的累计等待
+  double wait_ms_max = 0;
+  std::size_t started = 0;
+};
+
+class Scheduler {
+ public:
+  explicit Scheduler(std::size_t threads);
+  ~Scheduler();  // 先把所有队列跑完再退出
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  // inline_ok：是否允许在低优先级任务的文件边界上插队执行（只读请求才可以）
+  void submit(Priority p, std::function<void()> task, bool inline_ok = true);
+
+  // 文件边界上的让出点：当前线程正在执行优先级为 current 的任务。
+  // 没有空闲线程、且有更高优先级的可插队任务在排队时，就地执行它们；否则立即返回（很便宜）。
+  void yield_to_higher(Priority current);
+
+  std::array<PriorityStats, kPriorityClasses> stats() const;
+  std::size_t size() const { return workers_.size(); }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Task {
+    std::function<void()> fn;
+    Clock::time_point enqueued;
+    bool inline_ok = true;
+  };
+
+  void stop();  // 让工作线程把队列跑完后退出，并 join
+  void worker();
+  void run(Task& task, std::size_t cls, bool preempting);
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  std::array<std::deque<Task>, kPriorityClasses> queues_;
+  std::array<PriorityStats, kPriorityClasses> stats_;
+  // 无锁快速判断用：文件边界每个文件都会问一次，绝大多数时候答案是“不用让”
+  std::array<std::atomic<std::size_t>, kPriorityClasses> queued_{};
+  std::atomic<std::size_t> idle_{0};
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace engine
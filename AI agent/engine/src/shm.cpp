@@ -0,0 +1,102 @@
+/*
+  engine/src/shm.cpp：shm.h 的实现（POSIX shm_open + mmap）
+*/
+
+#include "shm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace engine {
+
+namespace {
+
+class Fd {
+  // 出错路径很多，用 RAII 保证 fd 一定会被关掉
+ public:
+  explicit Fd(int fd) : fd_(fd) {}
+  ~Fd() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+  Fd(const Fd&) = delete;
+  Fd& operator=(const Fd&) = delete;
+  int get() const { return fd_; }
+
+ private:
+  int fd_;
+};
+
+std::string next_segment_name() {
+  // macOS 上段名最长 31 个字符：pid + 进程内计数器足够唯一，也足够短
+  static std::atomic<unsigned> counter{0};
+  return "/engine." + std::to_string(static_cast<long>(::getpid())) + "." +
+         std::to_string(counter++);
+}
+
+}  // namespace
+
+bool copy_file_to_shm(const std::filesystem::path& path, std::size_t max_bytes, ShmSegment& seg,
+                      std::string& err) {
+  Fd in(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  struct stat st{};
+  if (in.get() < 0 || ::fstat(in.get(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    err = "read_failed";
+    return false;
+  }
+  std::size_t want = std::min<std::size_t>(static_cast<std::size_t>(st.st_size), max_bytes);
+
+  std::string name;
+  int raw = -1;
+  for (int attempt = 0; attempt < 8 && raw < 0; attempt++) {
+    name = next_segment_name();
+    raw = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (raw < 0 && errno != EEXIST) break;  // 名字撞上了上一个同 pid 进程遗留的段就换一个
+  }
+  Fd out(raw);
+  if (out.get() < 0) {
+    err = "shm_create_failed";
+    return false;
+  }
+
+  // 从这里开始失败都要把半成品段删掉
+  auto fail = [&](const char* code) {
+    ::shm_unlink(name.c_str());
+    err = code;
+    return false;
+  };
+  if (want > 0 && ::ftruncate(out.get(), static_cast<off_t>(want)) != 0)
+    return fail("shm_create_failed");
+
+  std::size_t got = 0;
+  if (want > 0) {
+    void* map = ::mmap(nullptr, want, PROT_READ | PROT_WRITE, MAP_SHARED, out.get(), 0);
+    if (map == MAP_FAILED) return fail("shm_create_failed");
+    // 直接 read 进映射：页缓存 -> 共享内存只有这一次拷贝
+    char* dst = static_cast<char*>(map);
+    while (got < want) {
+      ssize_t n = ::read(in.get(), dst + got, want - got);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      got += static_cast<std::size_t>(n);
+    }
+    ::munmap(map, want);
+    // 文件在 stat 之后被截短：段也跟着缩到实际读到的长度
+    if (got < want && ::ftruncate(out.get(), static_cast<off_t>(got)) != 0)
+      return fail("shm_create_failed");
+  }
+  ::fchmod(out.get(), 0400);  // 写完即封存：之后只能只读打开
+
+  seg.name = name;
+  seg.offset = 0;
+  seg.length = got;
+  return true;
+}
+
+}  // namespace engine
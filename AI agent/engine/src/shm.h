@@ -0,0 +1,34 @@
+/*
+  engine/src/shm.h：大文件内容的共享内存传输（read-file --transport shm）
+
+  默认的 read-file 把文件内容塞进响应里：JSON 要逐字节转义，再经过管道/socket 拷贝一次，
+  客户端还要再解析/拷贝一次；几 MB 的上下文时 CPU 和峰值内存都花在这上面。
+
+  shm 传输：引擎把文件内容读进一个新建的 POSIX 共享内存段，响应里只带段名、偏移和长度，
+  客户端只读地 mmap 这段内存即可（内容从页缓存到共享内存只拷贝这一次）。
+  - 段以 0600 创建、写完后改成 0400：之后任何人（包括引擎自己）都只能只读打开，相当于“封存”。
+  - 段的所有权交给客户端：客户端 mmap 之后负责 shm_unlink（映射在 unlink 后依然有效）。
+    客户端不取走的话段会一直留在 /dev/shm 里，所以只有明确要求时才用这个传输。
+  - 没有用 Linux 的 memfd：memfd 只能通过 fd 传递（SCM_RIGHTS），而 CLI 子进程 / stdin serve
+    走的是管道；具名 POSIX 共享内存在所有调用方式（以及 macOS）上都能用。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+namespace engine {
+
+struct ShmSegment {
+  std::string name;         // shm_open 用的名字，形如 "/engine.1234.7"
+  std::size_t offset = 0;   // 内容在段内的起始偏移（目前总是 0）
+  std::size_t length = 0;   // 内容长度
+};
+
+// 把 path 的前 max_bytes 字节放进一个新的共享内存段；失败时 err 是错误码（如 "read_failed"）。
+bool copy_file_to_shm(const std::filesystem::path& path, std::size_t max_bytes, ShmSegment& seg,
+                      std::string& err);
+
+}  // namespace engine
@@ -0,0 +1,502 @@
+/*
+  engine/src/text_scan.cpp：text_scan.h 的实现
+
+  SIMD 版本用函数级的 target 属性编译（不需要给整个工程加 -mavx2），运行时按 CPU 选择；
+  非 x86-64 或者不是 GCC/Clang 时只有标量版本（glibc 的 memchr 本身就是向量化的）。
+*/
+
+#include "text_scan.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ENGINE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace engine {
+
+namespace {
+
+constexpr std::size_t npos = std::string_view::npos;
+
+std::size_t find_scalar(const char* hay, std::size_t n, const char* needle, std::size_t m) {
+  if (m == 0) return 0;
+  if (m > n) return npos;
+  const char* end = hay + (n - m + 1);  // 首字节可能出现的范围
+  for (const char* p = hay; p < end;) {
+    p = static_cast<const char*>(std::memchr(p, needle[0], static_cast<std::size_t>(end - p)));
+    if (p == nullptr) return npos;
+    if (std::memcmp(p + 1, needle + 1, m - 1) == 0) return static_cast<std::size_t>(p - hay);
+    p++;
+  }
+  return npos;
+}
+
+inline unsigned char to_lower(unsigned char c) {
+  return static_cast<unsigned>(c - 'A') < 26u ? static_cast<unsigned char>(c + 32) : c;
+}
+
+inline bool is_word_byte(unsigned char c) {
+  return static_cast<unsigned>((c | 0x20) - 'a') < 26u || static_cast<unsigned>(c - '0') < 10u ||
+         c == '_';
+}
+
+// a 的前 m 个字节转小写后和 lower 相同
+bool equal_fold(const char* a, const char* lower, std::size_t m) {
+  for (std::size_t i = 0; i < m; i++) {
+    if (to_lower(static_cast<unsigned char>(a[i])) != static_cast<unsigned char>(lower[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// hay[pos, pos + m) 前后都不紧挨着单词字符（整词）
+bool at_word_edges(const char* hay, std::size_t size, std::size_t pos, std::size_t m) {
+  return (pos == 0 || !is_word_byte(static_cast<unsigned char>(hay[pos - 1]))) &&
+         (pos + m == size || !is_word_byte(static_cast<unsigned char>(hay[pos + m])));
+}
+
+// 大小写不敏感的版本：needle 已经是小写
+std::size_t find_fold_scalar(const char* hay, std::size_t n, const char* needle, std::size_t m) {
+  if (m == 0) return 0;
+  if (m > n) return npos;
+  const auto first = static_cast<unsigned char>(needle[0]);
+  for (std::size_t i = 0; i + m <= n; i++) {
+    if (to_lower(static_cast<unsigned char>(hay[i])) == first &&
+        equal_fold(hay + i + 1, needle + 1, m - 1)) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+// MultiFinder：每个字节 OR 0x20 让大小写字母落到一起（别的字节也可能两两落到一起，只是多一点候选），
+// 再乘法哈希到 256 Kbit 的位图（比 64 Kbit 慢不了多少，needle 上千个时误报少得多）
+constexpr unsigned kMultiHashBits = 18;
+constexpr std::size_t kMultiWords = (std::size_t{1} << kMultiHashBits) / 32;  // 每层位图的字数
+constexpr std::uint32_t kFoldBits = 0x20202020u;
+constexpr std::uint32_t kMultiHashMul = 0x9E3779B1u;
+
+inline std::uint32_t multi_hash(std::uint32_t key) {
+  return (key * kMultiHashMul) >> (32 - kMultiHashBits);
+}
+
+// p 开始的 4 个字节（折叠后），超出 size 的部分补 0
+inline std::uint32_t multi_window(const char* hay, std::size_t size, std::size_t p) {
+  char buf[4] = {0, 0, 0, 0};
+  std::memcpy(buf, hay + p, std::min<std::size_t>(size - p, 4));
+  std::uint32_t w;
+  std::memcpy(&w, buf, 4);
+  return w | kFoldBits;
+}
+
+std::size_t multi_scan_scalar(const char* hay, std::size_t size, std::size_t from,
+                              const std::uint32_t* masks, const std::uint32_t* bits,
+                              std::size_t layers) {
+  for (std::size_t p = from; p + 4 <= size; p++) {
+    std::uint32_t w;
+    std::memcpy(&w, hay + p, 4);
+    w |= kFoldBits;
+    for (std::size_t l = 0; l < layers; l++) {
+      std::uint32_t h = multi_hash(w & masks[l]);
+      if ((bits[l * kMultiWords + (h >> 5)] >> (h & 31)) & 1) return p;
+    }
+  }
+  return npos;
+}
+
+std::size_t count_scalar(const char* data, std::size_t size) {
+  return static_cast<std::size_t>(std::count(data, data + size, '\n'));
+}
+
+#if defined(ENGINE_X86_SIMD)
+
+// 首字节 / 末字节过滤：一次看 16 个起点，首字节和末字节都对上的才比较中间
+std::size_t find_sse2(const char* hay, std::size_t n, const char* needle, std::size_t m) {
+  if (m < 2) return find_scalar(hay, n, needle, m);
+  if (m > n) return npos;
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[m - 1]);
+  std::size_t i = 0;
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+    auto mask = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+    while (mask != 0) {
+      unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+      if (std::memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+      mask &= mask - 1;
+    }
+  }
+  std::size_t r = find_scalar(hay + i, n - i, needle, m);
+  return r == npos ? npos : i + r;
+}
+
+__attribute__((target("avx2"))) std::size_t find_avx2(const char* hay, std::size_t n,
+                                                      const char* needle, std::size_t m) {
+  if (m < 2) return find_scalar(hay, n, needle, m);
+  if (m > n) return npos;
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+  std::size_t i = 0;
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + m - 1));
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+    while (mask != 0) {
+      unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+      if (std::memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+      mask &= mask - 1;
+    }
+  }
+  std::size_t r = find_sse2(hay + i, n - i, needle, m);
+  return r == npos ? npos : i + r;
+}
+
+// 大小写不敏感：needle 的首字节 / 末字节是字母时，缓冲区字节先 OR 0x20 再比较
+// （x | 0x20 == 小写字母 当且仅当 x 是它的大写或小写），两个都对上的才比较中间
+std::size_t find_fold_sse2(const char* hay, std::size_t n, const char* needle, std::size_t m) {
+  if (m == 0) return 0;
+  if (m > n) return npos;
+  auto fold_bit = [](char c) { return static_cast<char>(c >= 'a' && c <= 'z' ? 0x20 : 0); };
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[m - 1]);
+  const __m128i fold_first = _mm_set1_epi8(fold_bit(needle[0]));
+  const __m128i fold_last = _mm_set1_epi8(fold_bit(needle[m - 1]));
+  std::size_t i = 0;
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+    a = _mm_or_si128(a, fold_first);
+    b = _mm_or_si128(b, fold_last);
+    auto mask = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+    while (mask != 0) {
+      unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+      if (m < 3 || equal_fold(hay + i + bit + 1, needle + 1, m - 2)) return i + bit;
+      mask &= mask - 1;
+    }
+  }
+  std::size_t r = find_fold_scalar(hay + i, n - i, needle, m);
+  return r == npos ? npos : i + r;
+}
+
+__attribute__((target("avx2"))) std::size_t find_fold_avx2(const char* hay, std::size_t n,
+                                                           const char* needle, std::size_t m) {
+  if (m == 0) return 0;
+  if (m > n) return npos;
+  auto fold_bit = [](char c) { return static_cast<char>(c >= 'a' && c <= 'z' ? 0x20 : 0); };
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+  const __m256i fold_first = _mm256_set1_epi8(fold_bit(needle[0]));
+  const __m256i fold_last = _mm256_set1_epi8(fold_bit(needle[m - 1]));
+  std::size_t i = 0;
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + m - 1));
+    a = _mm256_or_si256(a, fold_first);
+    b = _mm256_or_si256(b, fold_last);
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+    while (mask != 0) {
+      unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+      if (m < 3 || equal_fold(hay + i + bit + 1, needle + 1, m - 2)) return i + bit;
+      mask &= mask - 1;
+    }
+  }
+  std::size_t r = find_fold_sse2(hay + i, n - i, needle, m);
+  return r == npos ? npos : i + r;
+}
+
+// MultiFinder：一次算 8 个位置。16 字节广播到两个 128 位通道，pshufb 拼出 8 个重叠的 4 字节窗口，
+// 乘法哈希后用 gather 取位图字，移位取出对应的位
+__attribute__((target("avx2"))) std::size_t multi_scan_avx2(const char* hay, std::size_t size,
+                                                            std::size_t from,
+                                                            const std::uint32_t* masks,
+                                                            const std::uint32_t* bits,
+                                                            std::size_t layers) {
+  const __m256i windows = _mm256_setr_epi8(0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6,  //
+                                           4, 5, 6, 7, 5, 6, 7, 8, 6, 7, 8, 9, 7, 8, 9, 10);
+  const __m256i fold = _mm256_set1_epi32(static_cast<int>(kFoldBits));
+  const __m256i mul = _mm256_set1_epi32(static_cast<int>(kMultiHashMul));
+  const __m256i low5 = _mm256_set1_epi32(31);
+  std::size_t p = from;
+  for (; p + 16 <= size; p += 8) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + p));
+    __m256i w = _mm256_or_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(x), windows), fold);
+    __m256i any = _mm256_setzero_si256();
+    for (std::size_t l = 0; l < layers; l++) {
+      __m256i key = _mm256_and_si256(w, _mm256_set1_epi32(static_cast<int>(masks[l])));
+      __m256i h = _mm256_srli_epi32(_mm256_mullo_epi32(key, mul), 32 - kMultiHashBits);
+      __m256i word = _mm256_i32gather_epi32(reinterpret_cast<const int*>(bits + l * kMultiWords),
+                                            _mm256_srli_epi32(h, 5), 4);
+      any = _mm256_or_si256(any, _mm256_srlv_epi32(word, _mm256_and_si256(h, low5)));
+    }
+    auto mask = static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(any, 31))));
+    if (mask != 0) return p + static_cast<unsigned>(__builtin_ctz(mask));
+  }
+  return multi_scan_scalar(hay, size, p, masks, bits, layers);
+}
+
+// 换行符计数：cmpeq 的结果是 0 / -1，逐字节减到计数器里（最多 255 轮不会溢出），再用 sad 横向求和
+std::size_t count_sse2(const char* data, std::size_t size) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i zero = _mm_setzero_si128();
+  std::size_t total = 0;
+  std::size_t i = 0;
+  while (i + 16 <= size) {
+    __m128i acc = zero;
+    for (int round = 0; round < 255 && i + 16 <= size; round++, i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, nl));
+    }
+    __m128i sum = _mm_sad_epu8(acc, zero);
+    total += static_cast<std::size_t>(_mm_cvtsi128_si64(sum)) +
+             static_cast<std::size_t>(_mm_extract_epi16(sum, 4));
+  }
+  return total + count_scalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) std::size_t count_avx2(const char* data, std::size_t size) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i zero = _mm256_setzero_si256();
+  std::size_t total = 0;
+  std::size_t i = 0;
+  while (i + 32 <= size) {
+    __m256i acc = zero;
+    for (int round = 0; round < 255 && i + 32 <= size; round++, i += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+      acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, nl));
+    }
+    __m256i sum = _mm256_sad_epu8(acc, zero);  // 4 个 64 位的部分和
+    total += static_cast<std::size_t>(_mm256_extract_epi64(sum, 0)) +
+             static_cast<std::size_t>(_mm256_extract_epi64(sum, 1)) +
+             static_cast<std::size_t>(_mm256_extract_epi64(sum, 2)) +
+             static_cast<std::size_t>(_mm256_extract_epi64(sum, 3));
+  }
+  return total + count_sse2(data + i, size - i);
+}
+
+#endif  // ENGINE_X86_SIMD
+
+SimdLevel detect_simd_level() {
+#if defined(ENGINE_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+  return SimdLevel::Sse2;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+}  // namespace
+
+SimdLevel simd_level() {
+  static const SimdLevel level = detect_simd_level();
+  return level;
+}
+
+const char* simd_level_name(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::Avx2:
+      return "avx2";
+    case SimdLevel::Sse2:
+      return "sse2";
+    case SimdLevel::Scalar:
+      break;
+  }
+  return "scalar";
+}
+
+SubstringFinder::SubstringFinder(std::string_view needle, FindOptions options, SimdLevel level)
+    : needle_(needle), options_(options), level_(std::min(level, simd_level())), impl_(find_scalar) {
+  if (options_.ignore_case) {
+    for (char& c : needle_) c = static_cast<char>(to_lower(static_cast<unsigned char>(c)));
+    impl_ = find_fold_scalar;
+  }
+#if defined(ENGINE_X86_SIMD)
+  if (level_ == SimdLevel::Avx2) impl_ = options_.ignore_case ? find_fold_avx2 : find_avx2;
+  if (level_ == SimdLevel::Sse2) impl_ = options_.ignore_case ? find_fold_sse2 : find_sse2;
+#endif
+}
+
+std::size_t SubstringFinder::find(const char* hay, std::size_t size, std::size_t from) const {
+  const std::size_t m = needle_.size();
+  while (from <= size) {
+    std::size_t r = impl_(hay + from, size - from, needle_.data(), m);
+    if (r == npos) return npos;
+    r += from;
+    // 整词：前后有一边紧挨着单词字符就不算，从下一个字节接着找
+    if (!options_.whole_word || at_word_edges(hay, size, r, m)) return r;
+    from = r + 1;
+  }
+  return npos;
+}
+
+MultiFinder::MultiFinder(const std::vector<std::string>& needles,
+                         const std::vector<FindOptions>& options, SimdLevel level)
+    : level_(std::min(level, simd_level())), scan_(multi_scan_scalar) {
+  // 按开头几个字节（最多 4 个）分层，每层收集 (哈希, 编号)
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> keyed[4];
+  needles_.reserve(needles.size());
+  for (std::size_t i = 0; i < needles.size(); i++) {
+    Needle n{needles[i], i < options.size() ? options[i] : FindOptions()};
+    if (n.options.ignore_case) {
+      for (char& c : n.text) c = static_cast<char>(to_lower(static_cast<unsigned char>(c)));
+    }
+    const auto id = static_cast<std::uint32_t>(i);
+    if (n.text.empty()) {
+      empty_.push_back(id);
+    } else if (n.text.find('\n') == std::string::npos) {
+      std::size_t len = std::min<std::size_t>(n.text.size(), 4);
+      std::uint32_t mask = 0;
+      std::memset(&mask, 0xFF, len);
+      keyed[len - 1].emplace_back(multi_hash(multi_window(n.text.data(), len, 0) & mask), id);
+    }
+    needles_.push_back(std::move(n));
+  }
+  for (std::size_t len = 1; len <= 4; len++) {
+    auto& keys = keyed[len - 1];
+    if (keys.empty()) continue;
+    std::sort(keys.begin(), keys.end());
+    Layer layer;
+    std::memset(&layer.mask, 0xFF, len);
+    const std::size_t base = bits_.size();
+    bits_.resize(base + kMultiWords, 0);
+    for (auto [h, id] : keys) bits_[base + (h >> 5)] |= 1u << (h & 31);
+    layer.keys = std::move(keys);
+    masks_.push_back(layer.mask);
+    layers_.push_back(std::move(layer));
+  }
+#if defined(ENGINE_X86_SIMD)
+  if (level_ == SimdLevel::Avx2) scan_ = multi_scan_avx2;
+#endif
+}
+
+void MultiFinder::probe(const char* hay, std::size_t size, std::size_t pos, std::uint32_t window,
+                        std::vector<std::uint32_t>& found) const {
+  auto check = [&](std::uint32_t id) {
+    const Needle& n = needles_[id];
+    const std::size_t m = n.text.size();
+    if (m > size - pos) return;
+    bool equal = n.options.ignore_case ? equal_fold(hay + pos, n.text.data(), m)
+                                       : std::memcmp(hay + pos, n.text.data(), m) == 0;
+    if (equal && (!n.options.whole_word || at_word_edges(hay, size, pos, m))) found.push_back(id);
+  };
+  const std::size_t before = found.size();
+  for (std::size_t l = 0; l < layers_.size(); l++) {
+    std::uint32_t h = multi_hash(window & masks_[l]);
+    if (((bits_[l * kMultiWords + (h >> 5)] >> (h & 31)) & 1) == 0) continue;
+    const auto& keys = layers_[l].keys;
+    auto it = std::lower_bound(keys.begin(), keys.end(), std::make_pair(h, std::uint32_t{0}));
+    for (; it != keys.end() && it->first == h; ++it) check(it->second);
+  }
+  for (std::uint32_t id : empty_) check(id);
+  std::sort(found.begin() + static_cast<std::ptrdiff_t>(before), found.end());
+}
+
+std::size_t MultiFinder::find(const char* hay, std::size_t size, std::size_t from,
+                              std::vector<std::uint32_t>& found) const {
+  // 开头 4 个字节都在缓冲区里的位置交给 scan_ 批量过位图（有空 needle 时每个位置都要看）；
+  // 最后 3 个位置只可能命中短 needle，逐个看
+  found.clear();
+  const std::size_t tail = size < 3 ? 0 : size - 3;
+  std::size_t p = from;
+  while (p <= size) {
+    if (p < tail && empty_.empty()) {
+      p = scan_(hay, size, p, masks_.data(), bits_.data(), layers_.size());
+      if (p == npos) {
+        p = tail;
+        continue;
+      }
+    }
+    probe(hay, size, p, multi_window(hay, size, p), found);
+    if (!found.empty()) return p;
+    p++;
+  }
+  return npos;
+}
+
+std::size_t count_newlines(const char* data, std::size_t size, SimdLevel level) {
+#if defined(ENGINE_X86_SIMD)
+  level = std::min(level, simd_level());
+  if (level == SimdLevel::Avx2) return count_avx2(data, size);
+  if (level == SimdLevel::Sse2) return count_sse2(data, size);
+#endif
+  (void)level;
+  return count_scalar(data, size);
+}
+
+bool scan_lines(const char* data, std::size_t size, const SubstringFinder& finder,
+                const std::function<bool(const LineMatch&)>& visit) {
+  // 没有内容就没有行；含 '\n' 的 needle 不可能落在一行里
+  if (size == 0 || finder.needle().find('\n') != std::string::npos) return true;
+  const SimdLevel level = finder.level();
+  std::size_t cursor = 0;  // 总是某一行的行首；它之前的行都处理完了
+  std::size_t line = 1;    // cursor 所在的行号
+  while (true) {
+    std::size_t pos = finder.find(data, size, cursor);
+    if (pos == npos) return true;
+    std::size_t begin = pos;
+    while (begin > cursor && data[begin - 1] != '\n') begin--;
+    line += count_newlines(data + cursor, begin - cursor, level);
+    const void* nl = std::memchr(data + pos, '\n', size - pos);
+    std::size_t end = nl != nullptr ? static_cast<std::size_t>(static_cast<const char*>(nl) - data)
+                                    : size;
+    LineMatch m;
+    m.line = line;
+    m.text = std::string_view(data + begin, end - begin);
+    if (!visit(m)) return false;
+    if (end == size) return true;
+    cursor = end + 1;
+    line++;
+  }
+}
+
+bool scan_lines(const char* data, std::size_t size, const MultiFinder& finder,
+                const std::function<bool(const LineMatch&, std::uint32_t needle)>& visit) {
+  // 同上：找到第一个命中就定位这一行，再把这一行剩下的部分找完（限定在行内，不会跨行），
+  // 这一行命中的 needle 去重后按编号回调，然后跳到下一行
+  if (size == 0) return true;
+  const SimdLevel level = finder.level();
+  std::vector<std::uint32_t> found, ids;
+  std::size_t cursor = 0;
+  std::size_t line = 1;
+  while (true) {
+    std::size_t pos = finder.find(data, size, cursor, found);
+    if (pos == npos) return true;
+    std::size_t begin = pos;
+    while (begin > cursor && data[begin - 1] != '\n') begin--;
+    line += count_newlines(data + cursor, begin - cursor, level);
+    const void* nl = std::memchr(data + pos, '\n', size - pos);
+    std::size_t end = nl != nullptr ? static_cast<std::size_t>(static_cast<const char*>(nl) - data)
+                                    : size;
+    ids.assign(found.begin(), found.end());
+    if (ids.size() < finder.size()) {
+      for (std::size_t p = pos + 1; p <= end; p++) {
+        p = finder.find(data, end, p, found);
+        if (p == npos) break;
+        ids.insert(ids.end(), found.begin(), found.end());
+      }
+      std::sort(ids.begin(), ids.end());
+      ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+    LineMatch m;
+    m.line = line;
+    m.text = std::string_view(data + begin, end - begin);
+    for (std::uint32_t id : ids) {
+      if (!visit(m, id)) return false;
+    }
+    if (end == size) return true;
+    cursor = end + 1;
+    line++;
+  }
+}
+
+}  // namespace engine
@@ -0,0 +1,136 @@
+/*
+  engine/src/text_scan.h：整块缓冲区上的子串查找 + 按需还原行号（search-text 的扫描内核）
+
+  原来每个文件先被 split_lines 拆成一行一个 std::string，再逐行 find：每行一次堆分配，
+  而且绝大多数行根本不含 query。现在直接在整个文件缓冲区上找 query：
+  - SubstringFinder：首字节 / 末字节过滤（一次比较 16 或 32 个位置的首字节和末字节，
+    两个都对上的候选才 memcmp 中间部分），AVX2 / SSE2 / 标量三种实现，启动时按 CPU 选一次；
+  - scan_lines：只在真正命中时才往回找行首、往前找行尾，行号用向量化的换行符计数补上；
+    命中之后直接跳到下一行，一行只报告一次。扫描过程中不分配内存。
+  结果和“按 '\n' 切行（不去掉 '\r'，末尾的换行后面还有一个空行）后逐行 find”完全一致。
+
+  FindOptions（search-text 的 --ignore-case / --word / --smart-case）也在内核里做，不复制、不转小写：
+  - 大小写不敏感（只折叠 ASCII）：needle 先转成小写；首字节 / 末字节是字母时，把寄存器里的缓冲区字节
+    OR 0x20 再比较（只有 x 和 x^0x20 两个字节会 OR 成同一个值，所以过滤条件不宽不窄），中间部分按小写比较；
+  - 整词：找到的位置前后紧挨着单词字符（[0-9A-Za-z_]，和 line_regex.h 的 \b 一样）时跳过，从下一个字节接着找。
+    和 grep -w 一样，query 本身以标点开头 / 结尾时也要求那一侧不是单词字符
+
+  MultiFinder：一次找很多个 needle（search-text 的多个 query），整个缓冲区只过一遍，耗时基本不随 needle 数增长。
+  思路同 Hyperscan 的 FDR：每个位置取开头 4 个字节（OR 0x20 折叠大小写）算乘法哈希，查一张 256 Kbit 的位图
+  （32 KiB，放得进 L1）；位图里有才按哈希找出对应的 needle 逐个核对，上千个 needle 时误报也不到 1%。
+  不足 4 字节的 needle 按自己的长度另建一层位图。AVX2 上一次算 8 个位置的哈希，用 gather 查位图。
+  没用 Teddy：它按首字节的半字节分桶，needle 一多（标识符的字母几乎覆盖所有半字节）几乎每个位置都是候选；
+  也没用 Aho-Corasick：每个字节一次依赖上一次结果的查表，状态表一大就卡在内存延迟上
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace engine {
+
+enum class SimdLevel : std::uint8_t {
+  Scalar = 0,  // memchr + memcmp
+  Sse2 = 1,    // x86-64 的基线
+  Avx2 = 2,
+};
+
+// 本机能用的最高级别（第一次调用时检测）
+SimdLevel simd_level();
+const char* simd_level_name(SimdLevel level);
+
+struct FindOptions {
+  bool ignore_case = false;  // ASCII 大小写不敏感
+  bool whole_word = false;   // 前后都不能紧挨着单词字符
+};
+
+class SubstringFinder {
+ public:
+  // level 高于本机支持的级别时按本机的来（基准程序用它比较几种实现）
+  explicit SubstringFinder(std::string_view needle, FindOptions options = {},
+                           SimdLevel level = simd_level());
+
+  // hay[from, size) 里第一次出现的位置，没有返回 npos。空 needle 返回 from（from <= size 时）。
+  // whole_word 时看的是 hay 里的前后字节（from 之前的也算），所以要传整个缓冲区
+  std::size_t find(const char* hay, std::size_t size, std::size_t from = 0) const;
+
+  // ignore_case 时是转成小写以后的
+  const std::string& needle() const { return needle_; }
+  const FindOptions& options() const { return options_; }
+  SimdLevel level() const { return level_; }
+
+ private:
+  using Impl = std::size_t (*)(const char* hay, std::size_t size, const char* needle,
+                               std::size_t m);
+
+  std::string needle_;
+  FindOptions options_;
+  SimdLevel level_;
+  Impl impl_;
+};
+
+class MultiFinder {
+ public:
+  // options[i] 是 needles[i] 的查找方式（大小写、整词可以各不相同）。含 '\n' 的 needle 永远不会命中
+  MultiFinder(const std::vector<std::string>& needles, const std::vector<FindOptions>& options,
+              SimdLevel level = simd_level());
+
+  // hay[from, size) 里第一个有 needle 命中的位置，found 是在这里命中的 needle 编号（升序）；没有返回 npos。
+  // 和 SubstringFinder 一样要传整个缓冲区（整词要看前后字节）
+  std::size_t find(const char* hay, std::size_t size, std::size_t from,
+                   std::vector<std::uint32_t>& found) const;
+
+  std::size_t size() const { return needles_.size(); }
+  SimdLevel level() const { return level_; }
+
+ private:
+  struct Needle {
+    std::string text;  // ignore_case 时是小写
+    FindOptions options;
+  };
+  // 开头 length 个字节（4 表示 4 个及以上）算哈希的 needle 一层
+  struct Layer {
+    std::uint32_t mask = 0;                                    // 取开头 length 个字节
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> keys;  // (哈希, 编号)，按哈希排序
+  };
+  // hay[from, size - 3) 里第一个在某一层位图里的位置（开头 4 个字节都在缓冲区里），没有返回 npos
+  using Scan = std::size_t (*)(const char* hay, std::size_t size, std::size_t from,
+                               const std::uint32_t* masks, const std::uint32_t* bits,
+                               std::size_t layers);
+
+  // pos 处各层的候选都核对一遍，命中的编号追加到 found
+  void probe(const char* hay, std::size_t size, std::size_t pos, std::uint32_t window,
+             std::vector<std::uint32_t>& found) const;
+
+  std::vector<Needle> needles_;
+  std::vector<Layer> layers_;
+  std::vector<std::uint32_t> masks_;  // 各层的 mask
+  std::vector<std::uint32_t> bits_;   // 各层的位图连在一起，每层 256 Kbit
+  std::vector<std::uint32_t> empty_;  // 空 needle：每个位置都是候选
+  SimdLevel level_;
+  Scan scan_;
+};
+
+// data 里 '\n' 的个数
+std::size_t count_newlines(const char* data, std::size_t size, SimdLevel level = simd_level());
+
+struct LineMatch {
+  std::size_t line = 0;  // 1-based
+  std::string_view text;  // 整行，不含 '\n'
+};
+
+// 按顺序回调 data 里每个包含 needle 的行。visit 返回 false 时停下，scan_lines 也返回 false
+bool scan_lines(const char* data, std::size_t size, const SubstringFinder& finder,
+                const std::function<bool(const LineMatch&)>& visit);
+
+// 多个 needle：按顺序回调每个 (行, needle 编号)，同一行里按编号升序，每个 needle 一行只报告一次
+bool scan_lines(const char* data, std::size_t size, const MultiFinder& finder,
+                const std::function<bool(const LineMatch&, std::uint32_t needle)>& visit);
+
+}  // namespace engine
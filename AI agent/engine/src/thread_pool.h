@@ -0,0 +1,120 @@
+/*
+  engine/src/thread_pool.h：固定大小的 FIFO 线程池（header-only）
+
+  serve 模式下所有连接的请求、batch 里的并行操作都投递到这里执行。
+  run_workers 是一次性的 fork/join（遍历、搜索、建索引这些“起 N 个线程干完就收”的地方共用）。
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+// 调用线程跑 work(0)，再另起 threads - 1 个线程跑 work(1) ...，全部结束才返回。
+// 起线程失败（std::system_error）时就用已经起来的这些，所以 work 必须在少几个线程时也能把活干完
+// （从共享游标领活，或者没起来的编号本来就没分到活）；已经起来的线程无论如何都会 join，
+// 不会带着 joinable 的 std::thread 析构（那会 std::terminate）。
+// 工作线程里抛出的异常（比如 bad_alloc）不会让进程 terminate：全部 join 之后在调用线程重新抛出第一个
+template <class Work>
+void run_workers(std::size_t threads, const Work& work) {
+  std::exception_ptr error;
+  std::mutex error_mu;
+  auto helper = [&](std::size_t t) {
+    try {
+      work(t);
+    } catch (...) {
+      std::lock_guard<std::mutex> lk(error_mu);
+      if (!error) error = std::current_exception();
+    }
+  };
+  {
+    std::vector<std::thread> helpers;
+    struct JoinAll {
+      std::vector<std::thread>& threads;
+      ~JoinAll() {
+        for (auto& t : threads) t.join();
+      }
+    } join_all{helpers};
+    helpers.reserve(threads);
+    for (std::size_t t = 1; t < threads; t++) {
+      try {
+        helpers.emplace_back(helper, t);
+      } catch (const std::system_error&) {
+        break;
+      }
+    }
+    work(0);
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t threads) {
+    if (threads == 0) threads = 1;
+    try {
+      for (std::size_t i = 0; i < threads; i++) workers_.emplace_back([this] { run(); });
+    } catch (...) {
+      // 起到一半失败（std::system_error）：先让已经起来的线程退出并 join，再把异常抛给调用方；
+      // 带着 joinable 的 std::thread 析构会直接 std::terminate
+      stop();
+      throw;
+    }
+  }
+
+  ~ThreadPool() { stop(); }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      queue_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  std::size_t size() const { return workers_.size(); }
+
+ private:
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) t.join();
+  }
+
+  void run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return;  // stopping_ 且队列已清空
+        task = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace engine
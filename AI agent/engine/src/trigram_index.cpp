@@ -0,0 +1,654 @@
+/*
+  engine/src/trigram_index.cpp：trigram_index.h 的实现
+
+  构建分批进行（每批 kBatchFiles 个文件，按 FileId 顺序）：一批之内多线程 stat / 读文件 / 抽三元组，
+  再由调用线程按 FileId 顺序把这批文件追加进各个三元组的倒排表——倒排表天然有序，边追加边做差值编码，
+  内存里放的就是最终格式。最后和旧索引里沿用下来的文件（编号重新映射）按三元组归并一遍写出。
+*/
+
+#include "trigram_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+#include "walker.h"
+#include "watcher.h"
+
+namespace engine {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'A', 'G', 'T', 'I', '0', '0', '0', '1'};
+constexpr std::size_t kBatchFiles = 2048;
+constexpr std::uint32_t kNoFile = UINT32_MAX;
+
+fs::path index_path(const fs::path& root) { return root / ".agent_index" / "trigrams"; }
+
+std::int64_t mtime_of(const struct stat& st) {
+  return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+bool same_stamp(const TrigramIndex::FileEntry& f, const struct stat& st) {
+  return f.mtime_ns >= 0 && S_ISREG(st.st_mode) &&
+         static_cast<std::uint64_t>(st.st_ino) == f.inode &&
+         static_cast<std::uint64_t>(st.st_size) == f.size && mtime_of(st) == f.mtime_ns;
+}
+
+std::size_t worker_count(std::size_t items) {
+  std::size_t threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 16);
+  return std::min(threads, std::max<std::size_t>(1, items / 64));
+}
+
+inline std::uint32_t fold(char c) {
+  auto u = static_cast<unsigned char>(c);
+  return u >= 'A' && u <= 'Z' ? u + 32u : u;
+}
+
+// data 里出现过的三元组（ASCII 小写折叠后的 24 位值），去重并排好序
+void collect_trigrams(const char* data, std::size_t size, std::vector<std::uint32_t>& out) {
+  // 2^24 位的位图（2 MiB）按线程复用，用完只清掉碰过的字
+  static thread_local std::vector<std::uint64_t> seen((1u << 24) / 64);
+  out.clear();
+  if (size < 3) return;
+  std::uint32_t key = (fold(data[0]) << 8) | fold(data[1]);
+  for (std::size_t i = 2; i < size; i++) {
+    key = ((key << 8) | fold(data[i])) & 0xFFFFFF;
+    std::uint64_t& word = seen[key >> 6];
+    std::uint64_t bit = std::uint64_t{1} << (key & 63);
+    if (word & bit) continue;
+    word |= bit;
+    out.push_back(key);
+  }
+  for (std::uint32_t k : out) seen[k >> 6] = 0;
+  std::sort(out.begin(), out.end());
+}
+
+void put_varint(std::string& out, std::uint32_t v) {
+  while (v >= 0x80) {
+    out += static_cast<char>((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  out += static_cast<char>(v);
+}
+
+// 解码 count 个差值编码的编号追加到 out；越界、编号不递增或超出 limit 都返回 false
+bool decode_postings(std::string_view data, std::uint32_t count, std::uint32_t limit,
+                     std::vector<FileId>& out) {
+  std::size_t pos = 0;
+  std::uint64_t id = 0;
+  for (std::uint32_t n = 0; n < count; n++) {
+    std::uint64_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+      if (pos >= data.size() || shift > 28) return false;
+      auto b = static_cast<unsigned char>(data[pos++]);
+      delta |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) break;
+    }
+    if (n > 0 && delta == 0) return false;
+    id += delta;
+    if (id >= limit) return false;
+    out.push_back(static_cast<FileId>(id));
+  }
+  return true;
+}
+
+class Encoder {
+ public:
+  template <typename T>
+  void put(T v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+  void str(std::string_view s) {
+    put(static_cast<std::uint32_t>(s.size()));
+    buf += s;
+  }
+  std::string buf;
+};
+
+class Decoder {
+ public:
+  explicit Decoder(std::string_view data) : data_(data) {}
+
+  template <typename T>
+  bool get(T& v) {
+    if (data_.size() - pos_ < sizeof(T)) return false;
+    std::memcpy(&v, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+  bool str(std::string_view& s) {
+    std::uint32_t n = 0;
+    if (!get(n) || data_.size() - pos_ < n) return false;
+    s = data_.substr(pos_, n);
+    pos_ += n;
+    return true;
+  }
+  bool count(std::uint64_t& n) { return get(n) && n <= data_.size() - pos_; }
+  std::string_view rest() const { return data_.substr(pos_); }
+
+ private:
+  std::string_view data_;
+  std::size_t pos_ = 0;
+};
+
+// 构建时一个三元组的倒排表：已经是差值编码的最终格式
+struct PostingBuilder {
+  std::uint32_t trigram = 0;
+  std::uint32_t count = 0;
+  FileId last = 0;
+  std::string bytes;
+};
+
+}  // namespace
+
+TrigramIndex::~TrigramIndex() {
+  if (map_ != nullptr) ::munmap(map_, map_size_);
+}
+
+bool TrigramIndex::parse() {
+  std::string_view data(static_cast<const char*>(map_), map_size_);
+  if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  Decoder d(data.substr(sizeof(kMagic)));
+  std::uint64_t n = 0;
+  if (!d.get(max_file_bytes_) || !d.count(n)) return false;
+  std::vector<DirId> dir_ids(n);
+  std::string_view text;
+  for (auto& id : dir_ids) {
+    if (!d.str(text)) return false;
+    id = paths_.intern_dir(text);
+  }
+  if (!d.count(n)) return false;
+  files_.resize(n);
+  for (auto& f : files_) {
+    std::uint32_t dir = 0;
+    if (!d.get(dir) || dir >= dir_ids.size() || !d.str(text) || !d.get(f.inode) ||
+        !d.get(f.size) || !d.get(f.mtime_ns) || !d.get(f.kind) || !d.get(f.indexed_bytes)) {
+      return false;
+    }
+    paths_.add(dir_ids[dir], text);
+  }
+  if (!d.count(n)) return false;
+  keys_.resize(n);
+  for (auto& k : keys_) {
+    if (!d.get(k.trigram) || !d.get(k.count) || !d.get(k.offset)) return false;
+  }
+  if (!d.get(n) || n != d.rest().size()) return false;
+  postings_ = d.rest();
+  for (std::size_t i = 0; i < keys_.size(); i++) {
+    if (keys_[i].offset > postings_.size()) return false;
+    if (i > 0 && keys_[i - 1].trigram >= keys_[i].trigram) return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const TrigramIndex> TrigramIndex::load(const fs::path& root) {
+  struct Cached {
+    std::int64_t mtime_ns = 0;
+    std::uint64_t size = 0;
+    std::uint64_t inode = 0;
+    std::shared_ptr<const TrigramIndex> index;
+  };
+  static std::mutex mu;
+  static std::unordered_map<std::string, Cached> cache;
+
+  const fs::path path = index_path(root);
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return nullptr;
+  }
+  // 索引每次落盘都是 rename 一个新文件上来：inode / size / mtime 任何一个变了就重新映射
+  std::lock_guard<std::mutex> lk(mu);
+  Cached& c = cache[root.string()];
+  if (c.index && c.mtime_ns == mtime_of(st) && c.size == static_cast<std::uint64_t>(st.st_size) &&
+      c.inode == static_cast<std::uint64_t>(st.st_ino)) {
+    ::close(fd);
+    return c.index;
+  }
+  std::shared_ptr<TrigramIndex> index(new TrigramIndex());
+  index->map_size_ = static_cast<std::size_t>(st.st_size);
+  void* map = ::mmap(nullptr, index->map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) return nullptr;
+  index->map_ = map;
+  if (!index->parse()) return nullptr;
+  c = {mtime_of(st), static_cast<std::uint64_t>(st.st_size), static_cast<std::uint64_t>(st.st_ino),
+       index};
+  return index;
+}
+
+std::vector<FileId> TrigramIndex::postings(std::uint32_t trigram) const {
+  std::vector<FileId> out;
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), trigram,
+                             [](const Key& k, std::uint32_t t) { return k.trigram < t; });
+  if (it == keys_.end() || it->trigram != trigram) return out;
+  out.reserve(it->count);
+  if (!decode_postings(postings_.substr(it->offset), it->count,
+                       static_cast<std::uint32_t>(files_.size()), out)) {
+    // 坏了的倒排表当作“所有文件都有”：宁可多读，不能漏
+    out.resize(files_.size());
+    std::iota(out.begin(), out.end(), FileId{0});
+  }
+  return out;
+}
+
+std::vector<char> TrigramIndex::candidates(const fs::path& root, const PathTable& files,
+                                           const std::vector<std::string>& required,
+                                           std::size_t max_bytes,
+                                           const CancelToken* cancel) const {
+  return candidates(root, files, std::vector<std::vector<std::string>>{required}, max_bytes, cancel);
+}
+
+std::vector<char> TrigramIndex::candidates(const fs::path& root, const PathTable& files,
+                                           const std::vector<std::vector<std::string>>& any_of,
+                                           std::size_t max_bytes,
+                                           const CancelToken* cancel) const {
+  std::vector<char> need(files.size(), 1);
+  if (any_of.empty()) return need;
+
+  // 每一组：每个字面串的每个三元组都必须出现，从最短的倒排表开始求交集；各组的结果取并集。
+  // 有一组一个三元组都没有（字面串都不足 3 字节）就没法缩小范围
+  std::vector<char> hit(files_.size(), 0);
+  std::vector<std::uint32_t> grams, one;
+  std::vector<FileId> hits, next, merged;
+  for (const auto& required : any_of) {
+    grams.clear();
+    for (const std::string& literal : required) {
+      collect_trigrams(literal.data(), literal.size(), one);
+      grams.insert(grams.end(), one.begin(), one.end());
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    if (grams.empty()) return need;
+    std::sort(grams.begin(), grams.end(), [this](std::uint32_t a, std::uint32_t b) {
+      auto count = [this](std::uint32_t t) -> std::uint32_t {
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), t,
+                                   [](const Key& k, std::uint32_t v) { return k.trigram < v; });
+        return it == keys_.end() || it->trigram != t ? 0 : it->count;
+      };
+      return count(a) < count(b);
+    });
+    hits = postings(grams[0]);
+    for (std::size_t g = 1; g < grams.size() && !hits.empty(); g++) {
+      next = postings(grams[g]);
+      merged.clear();
+      std::set_intersection(hits.begin(), hits.end(), next.begin(), next.end(),
+                            std::back_inserter(merged));
+      hits.swap(merged);
+    }
+    for (FileId id : hits) hit[id] = 1;
+  }
+
+  // 索引里不含这些三元组的文本文件，只要 stat 没变、而且索引覆盖了 search 要读的范围，就不用打开；
+  // 按内容判断为二进制的文件同理（search 判断类型看的那一块不比索引看的小时，结论一样）
+  std::vector<std::pair<FileId, std::uint32_t>> checks;  // {files 里的编号, 索引里的编号}
+  for (FileId i = 0, j = 0; i < files.size() && j < files_.size();) {
+    int c = files.compare(i, paths_, j);
+    if (c < 0) {
+      i++;
+      continue;
+    }
+    if (c > 0) {
+      j++;
+      continue;
+    }
+    const FileEntry& f = files_[j];
+    bool text_miss = f.kind == FileKind::Text && !hit[j] &&
+                     f.indexed_bytes >= std::min<std::uint64_t>(f.size, max_bytes);
+    bool binary = f.kind == FileKind::Binary && max_bytes >= std::min<std::uint64_t>(f.size, kKindProbeBytes);
+    if (f.mtime_ns >= 0 && (text_miss || binary)) {
+      checks.emplace_back(i, j);
+    }
+    i++;
+    j++;
+  }
+
+  const std::string base = root.string();
+  std::atomic<std::size_t> cursor{0};
+  std::atomic<bool> stopped{false};
+  auto worker = [&](bool is_caller) {
+    std::size_t counter = 0;
+    std::string rel;
+    while (!stopped) {
+      std::size_t k = cursor++;
+      if (k >= checks.size()) return;
+      if (++counter % 256 == 0 && (is_caller ? checkpoint(cancel) : should_stop(cancel))) {
+        stopped = true;
+        return;
+      }
+      auto [i, j] = checks[k];
+      files.path_into(i, rel);
+      struct stat st {};
+      if (::stat(join_root(base, rel).c_str(), &st) == 0 && same_stamp(files_[j], st)) need[i] = 0;
+    }
+  };
+  run_workers(worker_count(checks.size()), [&](std::size_t t) { worker(t == 0); });
+  if (stopped) return {};
+  return need;
+}
+
+bool build_trigram_index(const fs::path& root, const PathTable& files, std::size_t max_file_bytes,
+                         const CancelToken* cancel, IndexBuildStats& out, std::string& err) {
+  static std::mutex build_mu;
+  std::lock_guard<std::mutex> build_lk(build_mu);
+  out = IndexBuildStats();
+  // 至少要覆盖判断文本/二进制的那一块，否则索引里记的类型和 search 看到的可能不一样
+  max_file_bytes = std::max(max_file_bytes, kKindProbeBytes);
+  const std::int64_t scan_start = now_ns();
+
+  // 旧索引（上限不同的不能沿用）：两边都按路径排序，一遍归并找出每个文件的旧编号
+  auto old = TrigramIndex::load(root);
+  if (old && old->max_file_bytes_ != max_file_bytes) old.reset();
+  std::vector<FileId> prev(files.size(), kNoFile);
+  if (old) {
+    for (FileId i = 0, j = 0; i < files.size() && j < old->files_.size();) {
+      int c = files.compare(i, old->paths_, j);
+      if (c == 0) prev[i++] = j++;
+      else if (c < 0) i++;
+      else j++;
+    }
+  }
+
+  std::vector<TrigramIndex::FileEntry> entries(files.size());
+  std::vector<char> reused(files.size(), 0);
+  std::vector<std::uint32_t> slot(std::size_t{1} << 24, 0);  // 三元组 -> builders 的下标 + 1
+  std::vector<PostingBuilder> builders;
+  std::vector<std::vector<std::uint32_t>> grams(kBatchFiles);
+  std::atomic<std::size_t> read_count{0};
+  std::atomic<bool> stopped{false};
+  const std::string base = root.string();
+
+  for (std::size_t begin = 0; begin < files.size() && !stopped; begin += kBatchFiles) {
+    const std::size_t end = std::min(files.size(), begin + kBatchFiles);
+    std::atomic<std::size_t> cursor{begin};
+    auto worker = [&](bool is_caller) {
+      std::size_t counter = 0;
+      std::string rel, bytes;
+      while (!stopped) {
+        std::size_t i = cursor++;
+        if (i >= end) return;
+        if (++counter % 64 == 0 && (is_caller ? checkpoint(cancel) : should_stop(cancel))) {
+          stopped = true;
+          return;
+        }
+        const auto id = static_cast<FileId>(i);
+        TrigramIndex::FileEntry& f = entries[i];
+        std::vector<std::uint32_t>& g = grams[i - begin];
+        g.clear();
+        // 扩展名就能认出的二进制文件 search 自己会跳过，不用 stat 也不用读
+        if (kind_from_name(files.name(id)) == FileKind::Binary) {
+          f.kind = FileKind::Binary;
+          continue;
+        }
+        files.path_into(id, rel);
+        std::string abs = join_root(base, rel);
+        struct stat st {};
+        if (prev[i] != kNoFile && ::stat(abs.c_str(), &st) == 0 &&
+            same_stamp(old->files_[prev[i]], st)) {
+          f = old->files_[prev[i]];
+          reused[i] = 1;
+          continue;
+        }
+        int fd = ::open(abs.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;  // 遍历之后被删了：留一条 Unknown 记录，查询时当作候选
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+          ::close(fd);
+          continue;
+        }
+        std::size_t got = 0;
+        bytes.resize(std::min<std::size_t>(max_file_bytes, std::max<off_t>(st.st_size, 0) + 1));
+        while (got < bytes.size()) {
+          ssize_t n = ::read(fd, bytes.data() + got, bytes.size() - got);
+          if (n < 0 && errno == EINTR) continue;
+          if (n <= 0) break;
+          got += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+        read_count++;
+        f.inode = static_cast<std::uint64_t>(st.st_ino);
+        f.size = static_cast<std::uint64_t>(st.st_size);
+        f.mtime_ns = mtime_of(st);
+        if (f.mtime_ns >= scan_start - kRacyWindowNs) f.mtime_ns = -1;
+        f.indexed_bytes = got;
+        f.kind = kind_from_content(bytes.data(), got);
+        if (f.kind == FileKind::Text) collect_trigrams(bytes.data(), got, g);
+      }
+    };
+    run_workers(worker_count(end - begin), [&](std::size_t t) { worker(t == 0); });
+    if (stopped) break;
+
+    // 按 FileId 顺序追加：每个倒排表都是递增的，直接写差值
+    for (std::size_t i = begin; i < end; i++) {
+      auto id = static_cast<FileId>(i);
+      std::vector<std::uint32_t>& g = grams[i - begin];
+      for (std::uint32_t t : g) {
+        std::uint32_t& s = slot[t];
+        if (s == 0) {
+          builders.emplace_back();
+          builders.back().trigram = t;
+          s = static_cast<std::uint32_t>(builders.size());
+        }
+        PostingBuilder& b = builders[s - 1];
+        put_varint(b.bytes, b.count == 0 ? id : id - b.last);
+        b.last = id;
+        b.count++;
+      }
+      if (g.capacity() > (1u << 16)) std::vector<std::uint32_t>().swap(g);
+    }
+  }
+  if (stopped) {
+    out.complete = false;
+    return true;
+  }
+  std::vector<std::uint32_t>().swap(slot);
+
+  // 和旧索引里沿用下来的文件归并：旧编号 -> 新编号（两边都按路径排序，映射是单调的）
+  std::vector<FileId> remap(old ? old->files_.size() : 0, kNoFile);
+  bool any_reused = false;
+  for (std::size_t i = 0; i < files.size(); i++) {
+    if (reused[i]) {
+      remap[prev[i]] = static_cast<FileId>(i);
+      any_reused = true;
+    }
+  }
+  std::vector<std::uint32_t> order(builders.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::sort(order.begin(), order.end(), [&builders](std::uint32_t a, std::uint32_t b) {
+    return builders[a].trigram < builders[b].trigram;
+  });
+
+  std::vector<TrigramIndex::Key> keys;
+  std::string blob;
+  std::vector<FileId> from_old, from_new, ids;
+  std::size_t ki = 0, bi = 0;
+  const std::size_t old_keys = any_reused ? old->keys_.size() : 0;
+  while (ki < old_keys || bi < order.size()) {
+    std::uint32_t t;
+    if (bi == order.size() || (ki < old_keys && old->keys_[ki].trigram < builders[order[bi]].trigram)) {
+      t = old->keys_[ki].trigram;
+    } else {
+      t = builders[order[bi]].trigram;
+    }
+    from_old.clear();
+    if (ki < old_keys && old->keys_[ki].trigram == t) {
+      for (FileId id : old->postings(t)) {
+        if (remap[id] != kNoFile) from_old.push_back(remap[id]);
+      }
+      ki++;
+    }
+    PostingBuilder* b = nullptr;
+    if (bi < order.size() && builders[order[bi]].trigram == t) b = &builders[order[bi++]];
+
+    TrigramIndex::Key key{t, 0, blob.size()};
+    if (from_old.empty() && b != nullptr) {
+      key.count = b->count;
+      blob += b->bytes;
+    } else if (!from_old.empty()) {
+      from_new.clear();
+      if (b != nullptr) decode_postings(b->bytes, b->count, kNoFile, from_new);
+      ids.clear();
+      std::merge(from_old.begin(), from_old.end(), from_new.begin(), from_new.end(),
+                 std::back_inserter(ids));
+      FileId last = 0;
+      for (std::size_t n = 0; n < ids.size(); n++) {
+        put_varint(blob, n == 0 ? ids[n] : ids[n] - last);
+        last = ids[n];
+      }
+      key.count = static_cast<std::uint32_t>(ids.size());
+    }
+    if (b != nullptr) std::string().swap(b->bytes);
+    if (key.count > 0) keys.push_back(key);
+  }
+
+  Encoder e;
+  e.buf.append(kMagic, sizeof(kMagic));
+  e.put(static_cast<std::uint64_t>(max_file_bytes));
+  e.put(static_cast<std::uint64_t>(files.dir_count()));
+  for (DirId dir = 0; dir < files.dir_count(); dir++) e.str(files.dir_path(dir));
+  e.put(static_cast<std::uint64_t>(files.size()));
+  for (FileId id = 0; id < files.size(); id++) {
+    const auto& f = entries[id];
+    e.put(static_cast<std::uint32_t>(files.dir(id)));
+    e.str(files.name(id));
+    e.put(f.inode);
+    e.put(f.size);
+    e.put(f.mtime_ns);
+    e.put(f.kind);
+    e.put(f.indexed_bytes);
+    if (f.kind == FileKind::Text) out.text++;
+  }
+  e.put(static_cast<std::uint64_t>(keys.size()));
+  for (const auto& k : keys) {
+    e.put(k.trigram);
+    e.put(k.count);
+    e.put(k.offset);
+  }
+  e.put(static_cast<std::uint64_t>(blob.size()));
+
+  // 先写临时文件再 rename：正在查询的进程继续用它映射着的旧文件
+  std::error_code ec;
+  fs::path target = index_path(root);
+  fs::create_directories(target.parent_path(), ec);
+  fs::path tmp = target;
+  tmp += ".tmp." + std::to_string(::getpid());
+  bool written = !ec;
+  if (written) {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    file.write(e.buf.data(), static_cast<std::streamsize>(e.buf.size()));
+    file.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+    written = static_cast<bool>(file);
+  }
+  if (written) {
+    fs::rename(tmp, target, ec);
+    written = !ec;
+  }
+  if (!written) {
+    fs::remove(tmp, ec);
+    err = "index_write_failed";
+    return false;
+  }
+  out.files = files.size();
+  out.read = read_count;
+  out.trigrams = keys.size();
+  out.bytes = e.buf.size() + blob.size();
+  return true;
+}
+
+IndexKeeper::IndexKeeper(std::shared_ptr<Watcher> watcher)
+    : watcher_(std::move(watcher)), signal_(std::make_shared<Signal>()) {
+  watcher_->subscribe([signal = signal_](const WatchBatch&) {
+    {
+      std::lock_guard<std::mutex> lk(signal->mu);
+      signal->changes++;
+    }
+    signal->cv.notify_all();
+  });
+  thread_ = std::thread([this] { run(); });
+}
+
+IndexKeeper::~IndexKeeper() {
+  {
+    std::lock_guard<std::mutex> lk(signal_->mu);
+    signal_->stopping = true;
+  }
+  signal_->cv.notify_all();
+  cancel_.cancel();
+  thread_.join();
+}
+
+IndexKeeper::Stats IndexKeeper::stats() {
+  std::lock_guard<std::mutex> lk(stats_mu_);
+  return stats_;
+}
+
+void IndexKeeper::run() {
+  using Clock = std::chrono::steady_clock;
+  std::uint64_t built = 0;  // 建好的索引对应到哪一次变化
+  while (true) {
+    std::uint64_t target = 0;
+    {
+      std::unique_lock<std::mutex> lk(signal_->mu);
+      signal_->cv.wait(lk, [&] { return signal_->stopping || signal_->changes != built; });
+      if (signal_->stopping) return;
+      // 启动后的第一次马上建；之后等变化安静下来，一次 checkout 触发的多批变化只重建一次。
+      // 一直有变化时最多等 kMaxDelayMs
+      if (built != 0) {
+        auto deadline = Clock::now() + std::chrono::milliseconds(kMaxDelayMs);
+        while (Clock::now() < deadline) {
+          std::uint64_t seen = signal_->changes;
+          bool changed = signal_->cv.wait_for(lk, std::chrono::milliseconds(kQuietMs), [&] {
+            return signal_->stopping || signal_->changes != seen;
+          });
+          if (signal_->stopping) return;
+          if (!changed) break;
+        }
+      }
+      target = signal_->changes;
+    }
+
+    auto start = Clock::now();
+    WalkResult walk = watcher_->files();
+    IndexBuildStats s;
+    std::string err;
+    bool ok = build_trigram_index(fs::path(watcher_->root()), walk.files, kDefaultIndexFileBytes,
+                                  &cancel_, s, err);
+    if (cancel_.cancelled()) return;
+    // 写失败也不马上重试，等下一批变化
+    built = target;
+    if (!ok || !s.complete) continue;
+    std::lock_guard<std::mutex> lk(stats_mu_);
+    stats_.builds++;
+    stats_.last_build_ms = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+    stats_.files = s.files;
+    stats_.trigrams = s.trigrams;
+    stats_.ready = true;
+  }
+}
+
+}  // namespace engine
@@ -0,0 +1,156 @@
+/*
+  engine/src/trigram_index.h：search-text 的持久化三元组倒排索引（root/.agent_index/trigrams）
+
+  不建索引时 search-text 每次都要把每个文件读一遍。索引把“哪些文件含有这个 3 字节序列”记下来：
+  查询时取出 query（--regex 时是模式里必须出现的字面串）里每个三元组的倒排表求交集，只有交集里的文件才需要打开验证。
+  多个 query 一起搜时各自求交集，再取并集
+  - 三元组按 ASCII 小写折叠后记录（大小写不敏感的查询也能用同一份索引，大小写敏感时只是候选多一点）
+  - 每个文件记着建索引时的 inode / size / mtime；查询时逐个 stat，对不上（或者新文件）的一律当作候选，
+    所以索引旧了只会变慢，不会漏结果
+  - 每个文件只索引开头 max_file_bytes（默认 1 MiB）；更大的文件在 search 的 max_bytes 超出这个范围时也一律当作候选
+  - 二进制文件（file_kind.h）只记类型，不进倒排表
+  - 重建是增量的：stat 没变的文件直接沿用旧索引里的倒排表项，只读新增和变了的文件
+
+  构建方式：engine_cli index --root PATH；或者 serve --watch ROOT 时由 IndexKeeper 在后台自动建、
+  watcher 报告变化后自动增量重建。
+
+  文件格式（本机字节序，版本不对就当作没有索引）：
+    "AGTI0001" max_file_bytes
+    dirs[]    目录表
+    files[]   dir name inode size mtime kind indexed_bytes
+    keys[]    trigram count offset     （按 trigram 排序）
+    postings  每个三元组的文件编号，递增，按差值用 LEB128 变长整数编码
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "cancel.h"
+#include "file_kind.h"
+#include "path_table.h"
+
+namespace engine {
+
+class Watcher;
+
+constexpr std::size_t kDefaultIndexFileBytes = 1 << 20;
+
+struct IndexBuildStats {
+  std::size_t files = 0;     // 索引里的文件数
+  std::size_t text = 0;      // 其中进了倒排表的文本文件
+  std::size_t read = 0;      // 这次真正读了内容的文件（其余沿用旧索引或按扩展名判断为二进制）
+  std::size_t trigrams = 0;  // 不同三元组的个数
+  std::uint64_t bytes = 0;   // 索引文件大小
+  bool complete = true;      // 被取消/超时打断时为 false（不落盘）
+};
+
+// 为 files（root 下枚举到的文件，按路径排序）建 / 增量重建索引并写到磁盘。同一进程里的构建串行执行。
+// 被取消/超时打断时 out.complete=false、不落盘；其它失败返回 false，err 是错误码（index_write_failed）
+bool build_trigram_index(const std::filesystem::path& root, const PathTable& files,
+                         std::size_t max_file_bytes, const CancelToken* cancel,
+                         IndexBuildStats& out, std::string& err);
+
+class TrigramIndex {
+ public:
+  // 读 root 的索引；没有或者坏了返回 nullptr。按索引文件的 stat 缓存在进程里
+  static std::shared_ptr<const TrigramIndex> load(const std::filesystem::path& root);
+
+  // files 是这次枚举到的文件（按路径排序），required 是命中的行必须包含的字面串（普通搜索就是 query，
+  // --regex 时是从模式里提取的）。返回和 files 一一对应的标记：1 表示需要打开验证。
+  // 每个在索引里的文件 stat 一次（多线程）；被取消时返回空 vector（调用方按没有索引处理）
+  std::vector<char> candidates(const std::filesystem::path& root, const PathTable& files,
+                               const std::vector<std::string>& required, std::size_t max_bytes,
+                               const CancelToken* cancel) const;
+  // 多个 query 一起搜时：any_of 的每一组是一个 query 的字面串，文件可能满足其中任何一组就要打开
+  std::vector<char> candidates(const std::filesystem::path& root, const PathTable& files,
+                               const std::vector<std::vector<std::string>>& any_of,
+                               std::size_t max_bytes, const CancelToken* cancel) const;
+
+  ~TrigramIndex();
+
+  struct FileEntry {
+    std::uint64_t inode = 0;
+    std::uint64_t size = 0;
+    std::int64_t mtime_ns = -1;  // -1：建索引时刚被改过，永远不可信
+    FileKind kind = FileKind::Unknown;
+    std::uint64_t indexed_bytes = 0;
+  };
+  struct Key {
+    std::uint32_t trigram;
+    std::uint32_t count;
+    std::uint64_t offset;  // 在 postings_ 里的位置
+  };
+
+ private:
+  friend bool build_trigram_index(const std::filesystem::path&, const PathTable&, std::size_t,
+                                  const CancelToken*, IndexBuildStats&, std::string&);
+
+  TrigramIndex() = default;
+  bool parse();
+
+  // 解码一个三元组的倒排表（没有这个三元组时返回空）
+  std::vector<FileId> postings(std::uint32_t trigram) const;
+
+  void* map_ = nullptr;  // 整个索引文件 mmap 进来；倒排表直接在映射上解码
+  std::size_t map_size_ = 0;
+  std::uint64_t max_file_bytes_ = kDefaultIndexFileBytes;
+  PathTable paths_;
+  std::vector<FileEntry> files_;
+  std::vector<Key> keys_;
+  std::string_view postings_;
+};
+
+// serve --watch 用：启动时在后台建一次索引，之后 watcher 每报告一批变化就标记为脏，
+// 安静 kQuietMs 后增量重建（一直有变化时最多等 kMaxDelayMs；重建期间再来的变化合并到下一次）。
+class IndexKeeper {
+ public:
+  struct Stats {
+    std::uint64_t builds = 0;
+    std::uint64_t last_build_ms = 0;
+    std::size_t files = 0;
+    std::size_t trigrams = 0;
+    bool ready = false;  // 至少建好过一次
+  };
+
+  explicit IndexKeeper(std::shared_ptr<Watcher> watcher);
+  ~IndexKeeper();
+
+  IndexKeeper(const IndexKeeper&) = delete;
+  IndexKeeper& operator=(const IndexKeeper&) = delete;
+
+  const std::shared_ptr<Watcher>& watcher() const { return watcher_; }
+  Stats stats();
+
+ private:
+  static constexpr int kQuietMs = 1000;
+  static constexpr int kMaxDelayMs = 10000;
+
+  // watcher 的回调也持有一份：watcher 没有退订接口，keeper 先析构时回调不能悬空
+  struct Signal {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::uint64_t changes = 1;  // 启动时先建一次
+    bool stopping = false;
+  };
+
+  void run();
+
+  std::shared_ptr<Watcher> watcher_;
+  std::shared_ptr<Signal> signal_;
+  CancelToken cancel_;
+  std::mutex stats_mu_;
+  Stats stats_;
+  std::thread thread_;
+};
+
+}  // namespace engine
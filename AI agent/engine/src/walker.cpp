@@ -0,0 +1,495 @@
+/*
+  engine/src/walker.cpp：walker.h 的实现
+*/
+
+#include "walker.h"
+
+#include "ignore.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+
+namespace engine {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct DirFd {
+  // 打开的目录 fd：子目录任务共享父目录的这一份，最后一个子目录打开之后就关掉
+  explicit DirFd(int fd) : fd(fd) {}
+  ~DirFd() { ::close(fd); }
+  DirFd(const DirFd&) = delete;
+  DirFd& operator=(const DirFd&) = delete;
+  int fd;
+};
+
+struct DirJob {
+  std::string abs;  // 目录的路径（root 拼上相对路径）
+  std::string rel;  // 相对 root 的路径，root 自己是空串
+  std::shared_ptr<const IgnoreNode> ignore;  // 父目录为止的 ignore 规则链
+  std::shared_ptr<const DirFd> parent;  // 非空时相对它 openat（只用最后一段名字，不再解析整条路径）
+};
+
+enum class EntryKind { Dir, File, Other };
+
+constexpr DirId kNoDir = static_cast<DirId>(-1);
+
+struct FoundFiles {
+  // 一个工作线程找到的文件：目录编号（所有线程共用一张目录表）+ 文件名（放在线程自己的 arena 里）
+  struct Entry {
+    DirId dir;
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+  void add(DirId dir, std::string_view name) {
+    entries.push_back(Entry{dir, static_cast<std::uint32_t>(names.size()),
+                            static_cast<std::uint32_t>(name.size())});
+    names.append(name);
+  }
+  std::vector<Entry> entries;
+  std::string names;
+};
+
+std::string_view last_component(const std::string& rel) {
+  std::size_t slash = rel.rfind('/');
+  return slash == std::string::npos ? std::string_view(rel)
+                                    : std::string_view(rel).substr(slash + 1);
+}
+
+class JobDeque {
+  // 每个工作线程一个：自己 push/pop 尾部，别人从头部 steal。
+  // 目录任务的粒度是“读一个目录”，远大于一次加锁的开销，用 mutex 就够了。
+ public:
+  void push(DirJob job) {
+    std::lock_guard<std::mutex> lk(mu_);
+    jobs_.push_back(std::move(job));
+  }
+
+  bool pop(DirJob& out) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (jobs_.empty()) return false;
+    out = std::move(jobs_.back());
+    jobs_.pop_back();
+    return true;
+  }
+
+  bool steal(DirJob& out) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (jobs_.empty()) return false;
+    out = std::move(jobs_.front());
+    jobs_.pop_front();
+    return true;
+  }
+
+ private:
+  std::mutex mu_;
+  std::deque<DirJob> jobs_;
+};
+
+class TreeWalk {
+ public:
+  TreeWalk(const WalkOptions& options, std::size_t threads, const CancelToken* cancel)
+      : options_(options), cancel_(cancel), deques_(threads), found_(threads), dirs_(threads) {}
+
+  void run(const std::string& root) {
+    pending_ = 1;
+    deques_[0].push(DirJob{options_.start.empty() ? root : join_root(root, options_.start),
+                           options_.start,
+                           options_.ignore ? options_.ignore : default_ignore_node(), nullptr});
+    // 调用线程是 0 号工作线程。起不来的线程的队列一直是空的，其余线程照样能把活偷完
+    run_workers(deques_.size(), [this](std::size_t i) { work(i); });
+  }
+
+  bool stopped() const { return stopped_.load(); }
+  int error() const { return error_.load(); }
+
+  PathTable take_sorted() {
+    std::size_t total = 0, bytes = 0;
+    for (const auto& f : found_) {
+      total += f.entries.size();
+      bytes += f.names.size();
+    }
+    PathTable files = std::move(table_);
+    files.reserve(total, bytes);
+    for (auto& f : found_) {
+      for (const auto& e : f.entries) {
+        files.add(e.dir, std::string_view(f.names).substr(e.offset, e.length));
+      }
+      f = FoundFiles();
+    }
+    files.sort();
+    return files;
+  }
+
+  std::vector<DirInfo> take_dirs() {
+    std::vector<DirInfo> dirs;
+    for (auto& v : dirs_) {
+      std::move(v.begin(), v.end(), std::back_inserter(dirs));
+      v.clear();
+    }
+    std::sort(dirs.begin(), dirs.end(),
+              [](const DirInfo& a, const DirInfo& b) { return a.rel < b.rel; });
+    return dirs;
+  }
+
+  std::size_t dirs_cached() const { return dirs_cached_.load(); }
+
+ private:
+  bool next_job(std::size_t self, DirJob& job) {
+    if (deques_[self].pop(job)) return true;
+    for (std::size_t k = 1; k < deques_.size(); k++) {
+      if (deques_[(self + k) % deques_.size()].steal(job)) return true;
+    }
+    return false;
+  }
+
+  void work(std::size_t self) {
+    DirJob job;
+    while (true) {
+      if (next_job(self, job)) {
+        // 0 号线程是调用方线程：在目录边界上走完整的检查点（含调度器让出）
+        bool stop = self == 0 ? checkpoint(cancel_) : should_stop(cancel_);
+        if (stop) stopped_ = true;
+        if (!stopped_) {
+          try {
+            scan(self, job);
+          } catch (...) {
+            // bad_alloc 之类：让其它线程把剩下的目录直接出队（不再扫描），pending_ 才能归零；
+            // 异常由 run_workers 在全部 join 之后交给调用方
+            stopped_ = true;
+            finish_job();
+            throw;
+          }
+        }
+        finish_job();
+        continue;
+      }
+      std::unique_lock<std::mutex> lk(idle_mu_);
+      if (pending_.load() == 0) return;
+      // 没偷到任务但还有目录在处理：等新的目录被 push（或者全部完成）
+      idle_cv_.wait_for(lk, std::chrono::milliseconds(1));
+    }
+  }
+
+  void finish_job() {
+    if (--pending_ == 0) {
+      std::lock_guard<std::mutex> lk(idle_mu_);
+      idle_cv_.notify_all();
+    }
+  }
+
+  void push_dir(std::size_t self, const DirJob& parent, std::string_view name, std::string rel,
+                const std::shared_ptr<const IgnoreNode>& ignore,
+                const std::shared_ptr<const DirFd>& parent_fd = nullptr) {
+    pending_++;  // 先记上：入队之后马上就可能被别的线程偷走、做完
+    try {
+      deques_[self].push(
+          DirJob{join_root(parent.abs, std::string(name)), std::move(rel), ignore, parent_fd});
+    } catch (...) {
+      pending_--;  // 没入队成功（bad_alloc）；当前目录还没做完，不会减到 0
+      throw;
+    }
+  }
+
+  void notify_pushed(std::size_t pushed) {
+    if (pushed > 0 && deques_.size() > 1) {
+      std::lock_guard<std::mutex> lk(idle_mu_);
+      idle_cv_.notify_all();
+    }
+  }
+
+  DirId intern_dir(const std::string& rel) {
+    // 每个有文件的目录只登记一次，加锁的开销分摊到整个目录上
+    std::lock_guard<std::mutex> lk(table_mu_);
+    return table_.intern_dir(rel);
+  }
+
+  void add_file(std::size_t self, const DirJob& job, DirId& dir, std::string_view name) {
+    if (dir == kNoDir) dir = intern_dir(job.rel);
+    found_[self].add(dir, name);
+  }
+
+  // 目录里的一项（类型已经确定）：先过忽略规则，目录入队，普通文件记下来
+  // 返回 true 表示入队了一个子目录；resolve() 只对非目录调用（符号链接要跟进才知道是不是普通文件）。
+  // dir 是这个目录在路径表里的编号，第一次找到文件时才登记（kNoDir 表示还没登记）
+  template <typename Resolve>
+  bool add_entry(std::size_t self, const DirJob& job, const IgnoreNode* ignore_node,
+                 const std::shared_ptr<const IgnoreNode>& ignore,
+                 const std::shared_ptr<const DirFd>& dir_fd, std::string_view name, bool is_dir,
+                 DirInfo* info, DirId& dir, Resolve&& resolve) {
+    std::string rel = job.rel.empty() ? std::string(name) : job.rel + "/" + std::string(name);
+    // 被忽略的目录在这里就剪掉，根本不会入队
+    if (is_ignored(ignore_node, rel, name, is_dir)) return false;
+    if (is_dir ? options_.enter_dir && !options_.enter_dir(rel)
+               : options_.keep_file && !options_.keep_file(rel, name)) {
+      return false;
+    }
+    if (is_dir) {
+      if (info != nullptr) info->subdirs.emplace_back(name);
+      push_dir(self, job, name, std::move(rel), ignore, dir_fd);
+      return true;
+    }
+    if (resolve() == EntryKind::File) {
+      if (info != nullptr) info->files.emplace_back(name);
+      add_file(self, job, dir, name);
+    }
+    return false;
+  }
+
+  void scan(std::size_t self, const DirJob& job) {
+#if defined(__linux__)
+    if (!options_.portable) {
+      scan_getdents(self, job);
+      return;
+    }
+#endif
+    scan_portable(self, job);
+  }
+
+  bool stat_dir(const DirJob& job, DirInfo& info) {
+    // 只有增量刷新才需要目录本身的 mtime/inode；普通遍历不多这一次 stat
+    struct stat st {};
+    int rc = job.parent ? ::fstatat(job.parent->fd, std::string(last_component(job.rel)).c_str(),
+                                    &st, 0)
+                        : ::stat(job.abs.c_str(), &st);
+    if (rc != 0) {
+      dir_error(errno);
+      return false;
+    }
+    info.rel = job.rel;
+    info.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    info.inode = static_cast<std::uint64_t>(st.st_ino);
+    return true;
+  }
+
+  void dir_error(int err) {
+    // 目录读不了：没权限、已经删了、不是目录了，是树本身的样子，跳过这棵子树就行；
+    // EMFILE/ENFILE/ENOMEM/EIO 之类是这一次遍历出的问题，结果不能算完整——
+    // 否则 manifest 会把这棵子树里的文件全当成删掉了
+    if (err == EACCES || err == ENOENT || err == ENOTDIR) return;
+    int none = 0;
+    error_.compare_exchange_strong(none, err);
+  }
+
+  void scan_portable(std::size_t self, const DirJob& job) {
+    // std::filesystem 版本：非 Linux 平台用它，WalkOptions::portable 时也用它（基准对照）
+    DirInfo info;
+    bool want_info = options_.cache != nullptr || options_.collect_dirs;
+    if (want_info) {
+      if (!stat_dir(job, info)) return;
+      if (options_.cache != nullptr && scan_cached(self, job, info)) return;
+    }
+
+    std::error_code ec;
+    fs::directory_iterator it(job.abs, ec);
+    if (ec) {
+      dir_error(ec.value());
+      return;
+    }
+    // 本目录的 .gitignore/.ignore 在这里编译一次，子目录沿用（没有规则文件时就是父目录的链）
+    auto ignore = load_ignore_node(job.ignore, job.abs, job.rel, job.rel.empty());
+    info.has_ignore = ignore != job.ignore;
+    std::size_t pushed = 0;
+    DirId dir = kNoDir;
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+      if (ec) {
+        dir_error(ec.value());
+        break;
+      }
+      const auto& entry = *it;
+      std::string name = entry.path().filename().string();
+      // .git 和引擎自己的索引目录（manifest.h）永远跳过
+      if (name == ".git" || name == ".agent_index") continue;
+      // 目录的符号链接不跟进（和 recursive_directory_iterator 的默认行为一致），文件的符号链接照常列出
+      fs::file_status link = entry.symlink_status(ec);
+      if (ec) continue;
+      bool is_dir = fs::is_directory(link);
+      pushed += add_entry(self, job, ignore.get(), ignore, nullptr, name, is_dir,
+                          want_info ? &info : nullptr, dir, [&] {
+                            return entry.is_regular_file(ec) ? EntryKind::File : EntryKind::Other;
+                          });
+    }
+    if (options_.collect_dirs) dirs_[self].push_back(std::move(info));
+    notify_pushed(pushed);
+  }
+
+#if defined(__linux__)
+  struct RawEntry {
+    std::uint32_t offset;  // 名字在 names 里的起始位置
+    std::uint32_t length;
+    unsigned char type;  // DT_*，DT_UNKNOWN 已经用 fstatat 补上
+  };
+
+  void scan_getdents(std::size_t self, const DirJob& job) {
+    // Linux 快速路径：getdents64 一次读一大块目录项，直接信任 d_type（绝大多数文件系统都会填），
+    // 只有 DT_UNKNOWN（部分 NFS/XFS 配置）和文件的符号链接才需要 stat；子目录相对父目录 fd 打开。
+    DirInfo info;
+    bool want_info = options_.cache != nullptr || options_.collect_dirs;
+    if (want_info) {
+      if (!stat_dir(job, info)) return;
+      if (options_.cache != nullptr && scan_cached(self, job, info)) return;
+    }
+
+    constexpr int kOpenFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int fd = job.parent ? ::openat(job.parent->fd, std::string(last_component(job.rel)).c_str(),
+                                   kOpenFlags)
+                        : ::open(job.abs.c_str(), kOpenFlags);
+    if (fd < 0) {
+      dir_error(errno);
+      return;
+    }
+    auto dir_fd = std::make_shared<const DirFd>(fd);
+
+    // 先把整个目录读完：要知道有没有 .gitignore/.ignore 才能决定读不读规则文件，
+    // 而 getdents 的缓冲区下一次调用就会被覆盖，所以名字统一拷进一块连续的 names
+    static thread_local std::vector<char> buf(1 << 17);
+    static thread_local std::string names;
+    static thread_local std::vector<RawEntry> entries;
+    names.clear();
+    entries.clear();
+    bool has_rule_file = false;
+    while (true) {
+      long n = ::syscall(SYS_getdents64, fd, buf.data(), buf.size());
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) dir_error(errno);
+      if (n <= 0) break;  // 0 是读完了；出错时已经读到的部分照常处理
+      for (long off = 0; off < n;) {
+        const auto* d = reinterpret_cast<const struct dirent64*>(buf.data() + off);
+        off += d->d_reclen;
+        std::string_view name(d->d_name);
+        if (name == "." || name == "..") continue;
+        // .git 和引擎自己的索引目录（manifest.h）永远跳过
+        if (name == ".git" || name == ".agent_index") continue;
+        if (name == ".gitignore" || name == ".ignore") has_rule_file = true;
+        unsigned char type = d->d_type;
+        if (type == DT_UNKNOWN) {
+          struct stat st {};
+          if (::fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+          type = IFTODT(st.st_mode);
+        }
+        if (type != DT_DIR && type != DT_REG && type != DT_LNK) continue;
+        entries.push_back(RawEntry{static_cast<std::uint32_t>(names.size()),
+                                   static_cast<std::uint32_t>(name.size()), type});
+        names.append(name);
+      }
+    }
+
+    // 规则文件只在这个目录确实有的时候才去读（根目录还要看 .git/info/exclude），
+    // 省掉绝大多数目录上两次注定失败的 open
+    auto ignore = job.ignore;
+    if (has_rule_file || job.rel.empty()) {
+      ignore = load_ignore_node(job.ignore, job.abs, job.rel, job.rel.empty());
+    }
+    info.has_ignore = ignore != job.ignore;
+    std::size_t pushed = 0;
+    DirId dir = kNoDir;
+    for (const auto& e : entries) {
+      std::string_view name(names.data() + e.offset, e.length);
+      pushed += add_entry(self, job, ignore.get(), ignore, dir_fd, name, e.type == DT_DIR,
+                          want_info ? &info : nullptr, dir, [&] {
+                            if (e.type == DT_REG) return EntryKind::File;
+                            // 文件的符号链接照常列出，目录的符号链接不跟进：只有这里要跟着链接 stat 一次
+                            struct stat st {};
+                            std::string target(name);
+                            if (::fstatat(dir_fd->fd, target.c_str(), &st, 0) != 0) {
+                              return EntryKind::Other;
+                            }
+                            return S_ISREG(st.st_mode) ? EntryKind::File : EntryKind::Other;
+                          });
+    }
+    if (options_.collect_dirs) dirs_[self].push_back(std::move(info));
+    notify_pushed(pushed);
+  }
+#endif
+
+  bool scan_cached(std::size_t self, const DirJob& job, DirInfo& info) {
+    // 目录的 mtime 只在增删改名子项时变化：mtime/inode 都没变，子项列表就和上次一样，
+    // 省掉 readdir 和每个子项的类型判断。规则文件只在这个目录确实有的时候才去读。
+    // 这里不打开目录本身，子目录按完整路径打开。
+    auto hit = options_.cache->find(job.rel);
+    if (hit == options_.cache->end()) return false;
+    const DirInfo& cached = hit->second;
+    if (cached.mtime_ns < 0 || cached.mtime_ns != info.mtime_ns || cached.inode != info.inode) {
+      return false;
+    }
+    auto ignore = cached.has_ignore
+                      ? load_ignore_node(job.ignore, job.abs, job.rel, job.rel.empty())
+                      : job.ignore;
+    DirId dir = kNoDir;
+    for (const auto& name : cached.files) add_file(self, job, dir, name);
+    for (const auto& name : cached.subdirs) {
+      push_dir(self, job, name, job.rel.empty() ? name : job.rel + "/" + name, ignore);
+    }
+    dirs_cached_++;
+    if (options_.collect_dirs) {
+      info.has_ignore = cached.has_ignore;
+      info.files = cached.files;
+      info.subdirs = cached.subdirs;
+      dirs_[self].push_back(std::move(info));
+    }
+    notify_pushed(cached.subdirs.size());
+    return true;
+  }
+
+  const WalkOptions& options_;
+  const CancelToken* cancel_;
+  std::vector<JobDeque> deques_;
+  std::vector<FoundFiles> found_;
+  std::mutex table_mu_;
+  PathTable table_;  // 只登记目录；文件在 take_sorted 里按路径排好序再放进来
+  std::vector<std::vector<DirInfo>> dirs_;
+  std::atomic<std::size_t> dirs_cached_{0};
+  std::atomic<std::size_t> pending_{0};  // 已入队但还没处理完的目录数；归零即遍历结束
+  std::atomic<bool> stopped_{false};
+  std::atomic<int> error_{0};  // 第一个让结果不完整的 errno（见 dir_error）
+  std::mutex idle_mu_;
+  std::condition_variable idle_cv_;
+};
+
+}  // namespace
+
+std::string join_root(const std::string& root, const std::string& rel) {
+  if (root.empty()) return rel;
+  if (root.back() == '/') return root + rel;
+  return root + "/" + rel;
+}
+
+WalkResult walk_tree(const fs::path& root, const CancelToken* cancel, const WalkOptions& options) {
+  std::size_t threads = options.threads;
+  if (threads == 0) {
+    // 遍历主要在等目录 I/O（尤其是 NFS），线程数可以比核数多一点，但没必要无限多
+    threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 16);
+  }
+  TreeWalk walk(options, threads, cancel);
+  walk.run(root.string());
+  WalkResult result;
+  result.files = walk.take_sorted();
+  result.error = walk.error();
+  result.complete = !walk.stopped() && result.error == 0;
+  result.dirs = walk.take_dirs();
+  result.dirs_cached = walk.dirs_cached();
+  return result;
+}
+
+}  // namespace engine
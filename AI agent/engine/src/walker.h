@@ -0,0 +1,86 @@
+/*
+  engine/src/walker.h：并行目录遍历（list-files / search-text 等所有枚举文件树的命令共用）
+
+  原来的实现是单线程的 recursive_directory_iterator，并且对每个条目都调一次 fs::relative；
+  在 NFS 或者非常“宽”的 monorepo 上，光遍历就要好几秒。这里改成：
+  - 目录是任务单位：每个工作线程有自己的双端队列，自己从尾部取（深度优先，局部性好），
+    空闲的线程从别人的头部“偷”（偷到的是离根更近、更大的子树）。
+  - 相对路径从父目录增量拼出来（parent_rel + "/" + name），不再对每个条目算 fs::relative。
+  - 各线程各自收集结果，最后合并并按相对路径排序：输出和线程数、调度顺序无关，结果可复现。
+    结果是一张 PathTable（path_table.h）：目录只存一次，文件只是 (目录编号, 文件名)。
+  - 忽略规则（.gitignore / .ignore，见 ignore.h）在进入目录前判断，被忽略的子树不会入队。
+  - Linux 上不走 std::filesystem：用 getdents64 按 128 KiB 一块读目录，直接信任 d_type，
+    只有 DT_UNKNOWN 和符号链接才 stat；子目录相对父目录的 fd 用 openat 打开，
+    没有 .gitignore/.ignore 的目录也不再去尝试打开规则文件。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "cancel.h"
+#include "path_table.h"
+
+namespace engine {
+
+struct IgnoreNode;  // ignore.h
+
+// mtime 落在扫描开始前这么久之内的文件 / 目录不可信（同一个时间戳粒度里可能还有后续写入），
+// 记成 mtime_ns = -1，下次一定重新读。manifest、三元组索引、watcher 的复核都用这一个值
+constexpr std::int64_t kRacyWindowNs = 2000000000;
+
+struct DirInfo {
+  // 一个目录在遍历时的样子（过滤之后），增量刷新（manifest.h）用它跳过 mtime 没变的目录
+  std::string rel;
+  std::int64_t mtime_ns = 0;  // -1 表示“不可信”（扫描时刚被改过），下次一定重新读
+  std::uint64_t inode = 0;
+  bool has_ignore = false;           // 目录里有 .gitignore/.ignore（根目录还包括 info/exclude）
+  std::vector<std::string> files;    // 未被忽略的文件名
+  std::vector<std::string> subdirs;  // 未被忽略的子目录名
+};
+using DirCache = std::unordered_map<std::string, DirInfo>;
+
+struct WalkOptions {
+  std::size_t threads = 0;  // 0 表示按 CPU 核数自动选择
+  // 非空时：目录的 mtime/inode 和缓存里一致，就直接用缓存的子项，不再 readdir
+  const DirCache* cache = nullptr;
+  bool collect_dirs = false;  // 把每个目录的 DirInfo 放进 WalkResult::dirs
+  // 只遍历 root 下的某个子目录（相对路径，空表示整棵树）；结果里的路径仍然相对 root。
+  // ignore 是 start 的父目录为止的规则链（空表示只有内置规则），watcher.h 用它补扫新出现的目录。
+  std::string start;
+  std::shared_ptr<const IgnoreNode> ignore;
+  // 遍历时的过滤（list-files 的 --include/--max-depth 等，见 list_filter.h）：
+  // enter_dir 返回 false 的目录不入队，整棵子树都不读；keep_file 返回 false 的文件不进结果。
+  // 不要和 cache / collect_dirs 一起用（缓存里记的子项必须是没过滤过的）
+  std::function<bool(std::string_view rel)> enter_dir;
+  std::function<bool(std::string_view rel, std::string_view name)> keep_file;
+  // 强制用 std::filesystem 的实现（非 Linux 平台本来就是它）；基准对照用，结果和快速路径一致
+  bool portable = false;
+};
+
+struct WalkResult {
+  PathTable files;                 // 排好序的 POSIX 风格相对路径（FileId 顺序即路径顺序）
+  bool complete = true;            // 因取消/超时提前结束时为 false（files 是已经找到的部分）
+  int error = 0;                   // 有目录因为 EACCES/ENOENT/ENOTDIR 以外的原因读不了时是它的 errno，
+                                   // complete 同时为 false
+  std::vector<DirInfo> dirs;       // collect_dirs 时才有，按 rel 排序
+  std::size_t dirs_cached = 0;     // 直接用了缓存的目录数
+};
+
+// 枚举 root 下所有未被忽略的普通文件。
+// 调用线程自己也参与遍历，并在每个目录上调用 checkpoint(cancel)（给调度器让出的机会）。
+WalkResult walk_tree(const std::filesystem::path& root, const CancelToken* cancel = nullptr,
+                     const WalkOptions& options = {});
+
+// 拼出文件的绝对路径：root + "/" + rel（root 本身以 "/" 结尾时不重复加）
+std::string join_root(const std::string& root, const std::string& rel);
+
+}  // namespace engine
@@ -0,0 +1,457 @@
+/*
+  engine/src/watcher.cpp：watcher.h 的实现（inotify 只有 Linux 有，其它平台 start() 直接报 watch_unsupported）
+*/
+
+#include "watcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <system_error>
+
+#include "ignore.h"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::int64_t kQuietMs = 50;      // 这么久没有新事件，就处理攒下的这一批
+constexpr std::int64_t kMaxDelayMs = 500;  // 事件一直不停（大批量写入）时，最多攒这么久
+
+std::int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::int64_t wall_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string parent_of(const std::string& rel) {
+  std::size_t slash = rel.rfind('/');
+  return slash == std::string::npos ? std::string() : rel.substr(0, slash);
+}
+
+std::string name_of(const std::string& rel) {
+  std::size_t slash = rel.rfind('/');
+  return slash == std::string::npos ? rel : rel.substr(slash + 1);
+}
+
+void note(std::unordered_map<std::string, std::pair<bool, bool>>& changes, const std::string& rel,
+          bool was_present, bool written) {
+  auto [it, inserted] = changes.try_emplace(rel, was_present, written);
+  if (!inserted) it->second.second = it->second.second || written;
+}
+
+std::mutex g_registry_mu;
+std::unordered_map<std::string, std::shared_ptr<Watcher>> g_registry;
+
+}  // namespace
+
+Watcher::Watcher(std::string root) : root_(std::move(root)) {}
+
+#if defined(__linux__)
+
+namespace {
+
+// 只关心会改变“文件树 / 文件内容”的事件；IN_MODIFY 每次 write 都会来一条，用 IN_CLOSE_WRITE 代替
+constexpr std::uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                     IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF |
+                                     IN_ONLYDIR | IN_DONT_FOLLOW;
+
+}  // namespace
+
+std::shared_ptr<Watcher> Watcher::start(const fs::path& root, std::string& err) {
+  std::error_code ec;
+  fs::path canon = fs::canonical(root, ec);
+  if (ec || !fs::is_directory(canon, ec)) {
+    err = "invalid_root";
+    return nullptr;
+  }
+  std::shared_ptr<Watcher> w(new Watcher(canon.string()));
+  w->fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  w->wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (w->fd_ < 0 || w->wake_fd_ < 0) {
+    err = "inotify_failed";
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lk(w->mu_);
+    w->rescan_locked(true);
+  }
+  w->thread_ = std::thread([raw = w.get()] { raw->run(); });
+  return w;
+}
+
+Watcher::~Watcher() {
+  if (thread_.joinable()) {
+    std::uint64_t one = 1;
+    ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+    thread_.join();
+  }
+  if (fd_ >= 0) ::close(fd_);
+  if (wake_fd_ >= 0) ::close(wake_fd_);
+}
+
+void Watcher::run() {
+  while (true) {
+    int timeout = 1000;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (has_pending_locked()) timeout = static_cast<int>(kQuietMs);
+    }
+    pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    int ready = ::poll(fds, 2, timeout);
+    if (ready > 0 && (fds[1].revents & POLLIN) != 0) return;
+    std::lock_guard<std::mutex> lk(mu_);
+    drain_locked();
+    if (!has_pending_locked()) continue;
+    std::int64_t now = now_ms();
+    if (now - last_event_ms_ >= kQuietMs || now - first_pending_ms_ >= kMaxDelayMs) {
+      apply_locked();
+    }
+  }
+}
+
+void Watcher::drain_locked() {
+  alignas(inotify_event) char buf[65536];
+  while (true) {
+    ssize_t n = ::read(fd_, buf, sizeof(buf));
+    if (n <= 0) return;  // EAGAIN：读空了
+    std::int64_t now = now_ms();
+    for (char* p = buf; p < buf + n;) {
+      const auto* ev = reinterpret_cast<const inotify_event*>(p);
+      p += sizeof(inotify_event) + ev->len;
+      stats_.events++;
+      if (!has_pending_locked()) first_pending_ms_ = now;
+      last_event_ms_ = now;
+      if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+        // 内核队列满了，丢了多少事件不知道：只能整棵树重扫
+        stats_.overflows++;
+        pending_rescan_ = true;
+        continue;
+      }
+      auto it = wd_to_dir_.find(ev->wd);
+      if (it == wd_to_dir_.end()) continue;
+      const std::string dir = it->second;
+      if ((ev->mask & IN_IGNORED) != 0) {
+        // 目录被删了，内核自动摘掉了 watch（子树由父目录的 IN_DELETE 处理）
+        auto d = dirs_.find(dir);
+        if (d != dirs_.end() && d->second.wd == ev->wd) d->second.wd = -1;
+        wd_to_dir_.erase(it);
+        continue;
+      }
+      if ((ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0) {
+        if (dir.empty()) pending_rescan_ = true;  // root 自己没了/被挪走
+        continue;
+      }
+      if (ev->len == 0) continue;
+      std::string name(ev->name);
+      if (name == ".git" || name == ".agent_index") continue;
+      // 规则文件变了，影响的是整棵子树的过滤结果：简单起见整棵树重扫
+      if (name == ".gitignore" || name == ".ignore") pending_rescan_ = true;
+      std::string rel = dir.empty() ? name : dir + "/" + name;
+      if ((ev->mask & IN_ISDIR) != 0) {
+        if ((ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) pending_gone_dirs_.push_back(rel);
+        if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) != 0) pending_new_dirs_.push_back(std::move(rel));
+      } else {
+        pending_files_.push_back(std::move(rel));
+      }
+    }
+  }
+}
+
+void Watcher::add_watch_locked(const std::string& rel, bool has_ignore) {
+  int wd = ::inotify_add_watch(fd_, join_root(root_, rel).c_str(), kWatchMask);
+  DirWatch& d = dirs_[rel];
+  if (d.failed) unwatched_--;
+  d.failed = wd < 0;
+  if (d.failed) {
+    stats_.watch_errors++;
+    unwatched_++;
+  }
+  d.wd = wd;
+  d.has_ignore = has_ignore;
+  d.ignore = nullptr;
+  if (wd >= 0) wd_to_dir_[wd] = rel;
+}
+
+void Watcher::drop_subtree_locked(const std::string& rel, ChangeSet& changes) {
+  // 目录被删/移出：它下面的文件和 watch 一起摘掉。移出的目录 watch 还在（会用旧路径报事件），要主动 rm
+  const std::string prefix = rel + "/";
+  auto drop_dir = [this](std::map<std::string, DirWatch>::iterator it) {
+    if (it->second.wd >= 0) {
+      ::inotify_rm_watch(fd_, it->second.wd);
+      wd_to_dir_.erase(it->second.wd);
+    }
+    if (it->second.failed) unwatched_--;
+    return dirs_.erase(it);
+  };
+  auto self = dirs_.find(rel);
+  if (self != dirs_.end()) drop_dir(self);
+  for (auto it = dirs_.lower_bound(prefix);
+       it != dirs_.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+    it = drop_dir(it);
+  }
+  for (auto it = files_.lower_bound(prefix);
+       it != files_.end() && it->compare(0, prefix.size(), prefix) == 0;) {
+    note(changes, *it, true, false);
+    it = files_.erase(it);
+  }
+}
+
+#else  // !__linux__
+
+std::shared_ptr<Watcher> Watcher::start(const fs::path&, std::string& err) {
+  err = "watch_unsupported";
+  return nullptr;
+}
+
+Watcher::~Watcher() = default;
+void Watcher::run() {}
+void Watcher::drain_locked() {}
+void Watcher::add_watch_locked(const std::string&, bool) {}
+void Watcher::drop_subtree_locked(const std::string&, ChangeSet&) {}
+
+#endif
+
+bool Watcher::has_pending_locked() const {
+  return pending_rescan_ || !pending_files_.empty() || !pending_new_dirs_.empty() ||
+         !pending_gone_dirs_.empty();
+}
+
+void Watcher::sync_locked() {
+  drain_locked();
+  if (has_pending_locked()) apply_locked();
+}
+
+void Watcher::apply_locked() {
+  auto unique_sorted = [](std::vector<std::string>& v) {
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+  };
+  if (pending_rescan_) {
+    pending_files_.clear();
+    pending_new_dirs_.clear();
+    pending_gone_dirs_.clear();
+    pending_rescan_ = false;
+    rescan_locked(false);
+    return;
+  }
+  stats_.batches++;
+  ChangeSet changes;
+  // 先摘掉消失的目录，再补扫新出现的目录，最后逐个确认文件：处理时都以磁盘上的现状为准，
+  // 所以同一批里“删了又建”“建了又删”的顺序无所谓
+  unique_sorted(pending_gone_dirs_);
+  for (const auto& rel : pending_gone_dirs_) drop_subtree_locked(rel, changes);
+  unique_sorted(pending_new_dirs_);
+  for (const auto& rel : pending_new_dirs_) scan_subtree_locked(rel, changes);
+  unique_sorted(pending_files_);
+  for (const auto& rel : pending_files_) recheck_file_locked(rel, changes);
+  pending_files_.clear();
+  pending_new_dirs_.clear();
+  pending_gone_dirs_.clear();
+  publish_locked(changes, WatchBatch());
+}
+
+void Watcher::rescan_locked(bool initial) {
+#if defined(__linux__)
+  for (const auto& [rel, d] : dirs_) {
+    if (d.wd >= 0) ::inotify_rm_watch(fd_, d.wd);
+  }
+#endif
+  dirs_.clear();
+  wd_to_dir_.clear();
+  unwatched_ = 0;
+  WalkResult walk = walk_and_watch_locked(WalkOptions());
+  walk_failed_ = walk.error != 0;
+
+  ChangeSet changes;
+  std::set<std::string> next;
+  for (FileId id = 0; id < walk.files.size(); id++) next.insert(next.end(), walk.files.path(id));
+  if (!initial) {
+    // 重扫拿不到“哪些文件被写过”，只能给出增删；batch.rescan 告诉订阅者需要自己全量核对
+    stats_.rescans++;
+    std::vector<std::string> gone;
+    std::set_difference(files_.begin(), files_.end(), next.begin(), next.end(),
+                        std::back_inserter(gone));
+    for (const auto& rel : gone) note(changes, rel, true, false);
+    std::vector<std::string> fresh;
+    std::set_difference(next.begin(), next.end(), files_.begin(), files_.end(),
+                        std::back_inserter(fresh));
+    for (const auto& rel : fresh) note(changes, rel, false, false);
+  }
+  files_ = std::move(next);
+  if (initial) return;
+  WatchBatch batch;
+  batch.rescan = true;
+  publish_locked(changes, std::move(batch));
+}
+
+void Watcher::scan_subtree_locked(const std::string& rel, ChangeSet& changes) {
+  const std::string parent = parent_of(rel);
+  if (dirs_.count(parent) == 0 || dirs_.count(rel) != 0) return;  // 父目录被忽略 / 已经扫过
+  std::error_code ec;
+  if (!fs::is_directory(fs::symlink_status(join_root(root_, rel), ec))) return;
+  auto ignore = ignore_for_locked(parent);
+  if (is_ignored(ignore.get(), rel, name_of(rel), true)) return;
+  // 新目录一般不大（一次 mkdir / 一次 git checkout 里的一小片），单线程走完即可
+  WalkOptions options;
+  options.threads = 1;
+  options.start = rel;
+  options.ignore = ignore;
+  WalkResult walk = walk_and_watch_locked(std::move(options));
+  if (walk.error != 0) walk_failed_ = true;  // 下次整棵重扫成功才清掉
+  for (FileId id = 0; id < walk.files.size(); id++) {
+    std::string f = walk.files.path(id);
+    if (files_.insert(f).second) note(changes, f, false, true);
+  }
+}
+
+WalkResult Watcher::walk_and_watch_locked(WalkOptions options) {
+  // 遍历和挂 watch 之间有空档：这期间在新目录里建的文件既不在遍历结果里、也不会产生事件
+  // （build 一口气写几千个文件时很容易碰上）。所以挂完 watch 再复核一遍：
+  // 这时所有目录都已经在监听了，复核之后的变化一定会有事件。复核用上一遍的目录信息做缓存，
+  // mtime 没变的目录不用重新 readdir；复核又发现没挂 watch 的新目录，就再来一轮。
+  options.collect_dirs = true;
+  std::int64_t started = wall_ns();
+  WalkResult walk = walk_tree(root_, nullptr, options);
+  for (bool first = true;; first = false) {
+    bool new_dirs = false;
+    for (const auto& d : walk.dirs) {
+      if (dirs_.count(d.rel) != 0) continue;
+      add_watch_locked(d.rel, d.has_ignore);
+      new_dirs = true;
+    }
+    if (!first && !new_dirs) return walk;
+    DirCache cache;
+    for (auto& d : walk.dirs) {
+      if (d.mtime_ns >= started - kRacyWindowNs) d.mtime_ns = -1;
+      std::string rel = d.rel;
+      cache.emplace(std::move(rel), std::move(d));
+    }
+    options.cache = &cache;
+    started = wall_ns();
+    walk = walk_tree(root_, nullptr, options);
+  }
+}
+
+void Watcher::recheck_file_locked(const std::string& rel, ChangeSet& changes) {
+  const std::string parent = parent_of(rel);
+  if (dirs_.count(parent) == 0) return;
+  bool was = files_.count(rel) != 0;
+  bool now = false;
+  std::error_code ec;
+  if (fs::is_regular_file(join_root(root_, rel), ec)) {
+    now = !is_ignored(ignore_for_locked(parent).get(), rel, name_of(rel), false);
+  }
+  if (!was && !now) return;
+  if (now && !was) files_.insert(rel);
+  if (was && !now) files_.erase(rel);
+  note(changes, rel, was, now);
+}
+
+std::shared_ptr<const IgnoreNode> Watcher::ignore_for_locked(const std::string& dir) {
+  auto it = dirs_.find(dir);
+  if (it == dirs_.end()) return default_ignore_node();
+  if (it->second.ignore) return it->second.ignore;
+  auto parent = dir.empty() ? default_ignore_node() : ignore_for_locked(parent_of(dir));
+  it->second.ignore =
+      it->second.has_ignore ? load_ignore_node(parent, join_root(root_, dir), dir, dir.empty())
+                            : parent;
+  return it->second.ignore;
+}
+
+void Watcher::publish_locked(const ChangeSet& changes, WatchBatch batch) {
+  for (const auto& [rel, state] : changes) {
+    bool now = files_.count(rel) != 0;
+    if (!state.first && now) batch.added.push_back(rel);
+    else if (state.first && !now) batch.removed.push_back(rel);
+    else if (state.first && now && state.second) batch.modified.push_back(rel);
+  }
+  if (batch.added.empty() && batch.modified.empty() && batch.removed.empty() && !batch.rescan) {
+    return;
+  }
+  std::sort(batch.added.begin(), batch.added.end());
+  std::sort(batch.modified.begin(), batch.modified.end());
+  std::sort(batch.removed.begin(), batch.removed.end());
+  stats_.generation++;
+  for (const auto& listener : listeners_) listener(batch);
+}
+
+WalkResult Watcher::files() {
+  std::lock_guard<std::mutex> lk(mu_);
+  sync_locked();
+  WalkResult result;
+  result.files.reserve(files_.size(), 0);
+  for (const auto& f : files_) result.files.add(f);
+  return result;
+}
+
+bool Watcher::degraded() {
+  std::lock_guard<std::mutex> lk(mu_);
+  return unwatched_ > 0 || walk_failed_;
+}
+
+void Watcher::subscribe(Listener listener) {
+  std::lock_guard<std::mutex> lk(mu_);
+  listeners_.push_back(std::move(listener));
+}
+
+WatchStats Watcher::stats() {
+  std::lock_guard<std::mutex> lk(mu_);
+  WatchStats s = stats_;
+  s.files = files_.size();
+  s.dirs = wd_to_dir_.size();
+  s.unwatched = unwatched_;
+  return s;
+}
+
+void register_watcher(std::shared_ptr<Watcher> watcher) {
+  std::lock_guard<std::mutex> lk(g_registry_mu);
+  g_registry[watcher->root()] = std::move(watcher);
+}
+
+void unregister_watcher(const std::string& root) {
+  std::lock_guard<std::mutex> lk(g_registry_mu);
+  g_registry.erase(root);
+}
+
+std::shared_ptr<Watcher> find_watcher(const fs::path& root) {
+  {
+    std::lock_guard<std::mutex> lk(g_registry_mu);
+    if (g_registry.empty()) return nullptr;  // 没有 serve --watch 时不多一次 realpath
+  }
+  std::error_code ec;
+  fs::path canon = fs::canonical(root, ec);
+  if (ec) return nullptr;
+  std::lock_guard<std::mutex> lk(g_registry_mu);
+  auto it = g_registry.find(canon.string());
+  return it == g_registry.end() ? nullptr : it->second;
+}
+
+std::vector<std::shared_ptr<Watcher>> registered_watchers() {
+  std::lock_guard<std::mutex> lk(g_registry_mu);
+  std::vector<std::shared_ptr<Watcher>> out;
+  for (const auto& [root, w] : g_registry) out.push_back(w);
+  std::sort(out.begin(), out.end(),
+            [](const auto& a, const auto& b) { return a->root() < b->root(); });
+  return out;
+}
+
+}  // namespace engine
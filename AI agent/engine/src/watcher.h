@@ -0,0 +1,139 @@
+/*
+  engine/src/watcher.h：serve 常驻进程里的实时文件树（inotify）
+
+  增量 manifest 仍然要把整棵树 stat 一遍；常驻进程可以直接订阅 inotify 事件，
+  只为“真的变了的东西”干活：
+  - 每个未被忽略的目录一个 watch；新建/移入的目录补扫它的子树，删除/移出的目录整棵摘掉
+  - 事件先攒着：安静 kQuietMs 或者攒够 kMaxDelayMs 才处理一批。build.sh 重写 demo、
+    git checkout 一次碰几千个文件，都只合并成少数几批，而且同一个文件的多次写只检查一次
+  - 内核事件队列溢出（IN_Q_OVERFLOW）、根目录被删/移走、.gitignore/.ignore 变化时，退回整棵树重扫
+
+  serve --watch ROOT 会为 ROOT 启动一个 Watcher 并登记；之后 list-files / search-text 等命令
+  遇到同一个 root 时直接用它的文件树，不再遍历（见 engine_core.cpp 的 enumerate_files）。
+  用之前会先 sync()：把内核里已经排队的事件立刻处理掉，刚写完文件马上 list 也能看到。
+  有目录挂不上 watch（大仓库上通常是 max_user_watches 不够，ENOSPC）时 watcher 是 degraded 的：
+  那些目录里的变化看不到，enumerate_files 不用它的文件树，照常遍历，直到重扫时全部挂上。
+  遍历时有目录读不了（EMFILE 之类，见 WalkResult::error）也一样算 degraded。
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "walker.h"
+
+namespace engine {
+
+struct WatchBatch {
+  // 处理完一批事件后的净变化（路径相对 root，已排序）
+  bool rescan = false;  // 这一批是整棵树重扫的结果
+  std::vector<std::string> added;
+  std::vector<std::string> modified;
+  std::vector<std::string> removed;
+};
+
+struct WatchStats {
+  std::size_t files = 0;
+  std::size_t dirs = 0;  // 当前的 watch 数
+  std::uint64_t generation = 0;  // 每处理一批有变化的事件加一
+  std::uint64_t events = 0;
+  std::uint64_t batches = 0;
+  std::uint64_t rescans = 0;
+  std::uint64_t overflows = 0;
+  std::uint64_t watch_errors = 0;  // inotify_add_watch 失败（通常是 max_user_watches 不够）的目录数
+  std::size_t unwatched = 0;       // 当前没挂上 watch 的目录数；不是 0 就是 degraded
+};
+
+class Watcher {
+ public:
+  using Listener = std::function<void(const WatchBatch&)>;
+
+  // 扫描整棵树并开始监听；失败（非 Linux、inotify 不可用、root 不是目录）返回 nullptr，err 为错误码
+  static std::shared_ptr<Watcher> start(const std::filesystem::path& root, std::string& err);
+  ~Watcher();
+
+  Watcher(const Watcher&) = delete;
+  Watcher& operator=(const Watcher&) = delete;
+
+  const std::string& root() const { return root_; }
+
+  // 先处理已经排队的事件，再拷贝出当前的文件列表（排好序）
+  WalkResult files();
+
+  // 有目录没挂上 watch：文件树可能已经过时，调用方应当自己遍历
+  bool degraded();
+
+  // 每处理完一批有变化的事件就回调一次（在 watcher 的锁里调用，回调里不要再调 watcher）
+  void subscribe(Listener listener);
+
+  WatchStats stats();
+
+ private:
+  explicit Watcher(std::string root);
+
+  // 一批事件里涉及的路径 -> {处理前是否在文件树里, 内容是否被写过}；处理完再和现状比较得出净变化
+  using ChangeSet = std::unordered_map<std::string, std::pair<bool, bool>>;
+
+  void run();
+  bool has_pending_locked() const;
+  void sync_locked();
+  void drain_locked();  // 把 inotify fd 里现有的事件读进 pending_*
+  void apply_locked();  // 处理攒下的事件
+  void rescan_locked(bool initial);
+  WalkResult walk_and_watch_locked(WalkOptions options);
+  void scan_subtree_locked(const std::string& rel, ChangeSet& changes);
+  void drop_subtree_locked(const std::string& rel, ChangeSet& changes);
+  void recheck_file_locked(const std::string& rel, ChangeSet& changes);
+  void add_watch_locked(const std::string& rel, bool has_ignore);
+  std::shared_ptr<const IgnoreNode> ignore_for_locked(const std::string& dir);
+  void publish_locked(const ChangeSet& changes, WatchBatch batch);
+
+  struct DirWatch {
+    int wd = -1;
+    bool failed = false;  // inotify_add_watch 失败（算在 unwatched_ 里）
+    bool has_ignore = false;
+    std::shared_ptr<const IgnoreNode> ignore;  // 懒加载：到这个目录为止的规则链
+  };
+
+  const std::string root_;
+  int fd_ = -1;
+  int wake_fd_ = -1;  // eventfd：析构时叫醒后台线程
+  std::mutex mu_;
+  std::set<std::string> files_;
+  std::map<std::string, DirWatch> dirs_;  // 有序：摘掉整棵子树时按前缀取一段
+  std::unordered_map<int, std::string> wd_to_dir_;
+  std::vector<Listener> listeners_;
+  WatchStats stats_;
+  std::size_t unwatched_ = 0;  // failed 的目录数
+  bool walk_failed_ = false;   // 遍历时有目录读不了（WalkResult::error），files_ 缺了一块
+
+  // 攒着还没处理的事件
+  bool pending_rescan_ = false;
+  std::vector<std::string> pending_files_;
+  std::vector<std::string> pending_new_dirs_;
+  std::vector<std::string> pending_gone_dirs_;
+  std::int64_t first_pending_ms_ = 0;
+  std::int64_t last_event_ms_ = 0;
+
+  std::thread thread_;
+};
+
+// serve --watch 登记的 watcher；root 按真实路径比较，没有就返回空
+void register_watcher(std::shared_ptr<Watcher> watcher);
+void unregister_watcher(const std::string& root);
+std::shared_ptr<Watcher> find_watcher(const std::filesystem::path& root);
+std::vector<std::shared_ptr<Watcher>> registered_watchers();
+
+}  // namespace engine